@@ -0,0 +1,69 @@
+#ifndef LFV_BENCH
+
+#define LFV_BENCH
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs fn repetitions times and returns the best wall time in seconds
+template <typename Fn> double measure_seconds(Fn&& fn, int repetitions = 5) {
+  double best = 1e30;
+  for (int i = 0; i < repetitions; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+
+  return best;
+}
+
+// Results are printed as they come, and kept to be written out as JSON at the end
+void report_throughput(const std::string& name, uint64_t bytes, double seconds);
+
+// Time per step of something done steps times
+void report_latency(const std::string& name, uint64_t steps, double seconds);
+
+// Highest resident set size of the process so far, or 0 where it is not known
+uint64_t get_peak_rss_bytes();
+
+// Keeps the optimiser from discarding a result
+void do_not_optimise(const void* ptr);
+
+// Writes content to a file in the temporary directory and returns its path
+std::string write_temp_file(const std::string& name, const std::string& content);
+
+// Kinds of synthetic files. The same kind and size always give the same bytes.
+enum class Dataset {
+  // Words, 40 to 100 bytes per line
+  SHORT_LINES,
+  // Words, 1 to 16 MiB per line
+  GIANT_LINES,
+  // Words, 0 to 200 bytes per line, ending with \r\n
+  CRLF,
+  // Uniformly random bytes
+  BINARY_NOISE,
+};
+
+const char* get_dataset_name(Dataset dataset);
+
+// Writes size bytes of the dataset to a file in the temporary directory and returns its path. The
+// file is written a chunk at a time, so sizes of tens of GB need only the disk space.
+std::string write_dataset(Dataset dataset, uint64_t size);
+
+// 1K, 64M, 16G and so on, in powers of 1024
+std::string format_size(uint64_t size);
+
+void run_byte_scan_bench();
+
+void run_search_bench();
+
+void run_scroll_bench();
+
+// Scans, slices, searches and scrolling over each dataset at each size
+void run_files_bench(const std::vector<uint64_t>& sizes);
+
+#endif
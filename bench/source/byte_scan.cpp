@@ -0,0 +1,81 @@
+#include <LFV/byte_scan.hpp>
+#include <LFV/file_extractor.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "bench.hpp"
+
+namespace {
+  // The per-byte stream scan FileExtractor used before it had block sources
+  std::streampos legacy_find_first_of(std::ifstream& in, std::streampos end, char target,
+                                      std::streampos pos) {
+    in.clear();
+    in.seekg(pos);
+
+    while (in.tellg() < end && in.peek() != target) {
+      in.seekg(1, std::ios_base::cur);
+    }
+
+    if (in.peek() == target) {
+      return in.tellg();
+    }
+
+    return -1;
+  }
+
+  // A single line with no newline, which is the worst case for line boundary lookups
+  std::string make_long_line(size_t size) {
+    std::mt19937 rng(1);
+    std::string line(size, ' ');
+    for (char& c : line) {
+      c = static_cast<char>('!' + rng() % 90);
+    }
+
+    return line;
+  }
+}  // namespace
+
+void run_byte_scan_bench() {
+  constexpr size_t KERNEL_BYTES = 64 << 20;
+  constexpr size_t LEGACY_BYTES = 1 << 20;
+
+  const std::string line = make_long_line(KERNEL_BYTES);
+  const char* first = line.data();
+  const char* last = line.data() + line.size();
+
+  for (const ByteScanKernel& kernel : available_byte_scan_kernels()) {
+    double forward
+        = measure_seconds([&] { do_not_optimise(kernel.find_first(first, last, '\n')); });
+    report_throughput(std::string("find_first/") + kernel.name, KERNEL_BYTES, forward);
+
+    double backward
+        = measure_seconds([&] { do_not_optimise(kernel.find_last(first, last, '\n')); });
+    report_throughput(std::string("find_last/") + kernel.name, KERNEL_BYTES, backward);
+  }
+
+  const std::string fpath = write_temp_file("lfv_bench_byte_scan.txt", line);
+
+  FileSourceOptions paged_options;
+  paged_options.use_mmap = false;
+
+  FileExtractor mapped(fpath);
+  FileExtractor paged(fpath, paged_options);
+
+  for (auto [name, extractor] : {std::pair{"mapped", &mapped}, std::pair{"paged", &paged}}) {
+    double forward = measure_seconds([&] { extractor->find_first_of('\n', 0); });
+    report_throughput(std::string("FileExtractor::find_first_of/") + name, KERNEL_BYTES, forward);
+
+    double backward
+        = measure_seconds([&] { extractor->find_last_of('\n', extractor->get_end()); });
+    report_throughput(std::string("FileExtractor::find_last_of/") + name, KERNEL_BYTES, backward);
+  }
+
+  std::ifstream in(fpath, std::ios_base::binary);
+  auto legacy_end = static_cast<std::streampos>(LEGACY_BYTES);
+  double legacy = measure_seconds([&] { legacy_find_first_of(in, legacy_end, '\n', 0); }, 1);
+  report_throughput("legacy seekg/peek scan", LEGACY_BYTES, legacy);
+
+  std::filesystem::remove(fpath);
+}
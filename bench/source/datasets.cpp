@@ -0,0 +1,108 @@
+#include <LFV/lfv_exception.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "bench.hpp"
+
+namespace {
+  constexpr size_t CHUNK_BYTES = 1 << 20;
+
+  // Produces the bytes of a dataset one after another, lines carrying over between chunks
+  class DatasetGenerator {
+  public:
+    explicit DatasetGenerator(Dataset dataset)
+        : m_dataset(dataset), m_rng(static_cast<uint64_t>(dataset) + 1) {
+      m_line_left = next_line_length();
+    }
+
+    void fill(char* first, char* last) {
+      if (m_dataset == Dataset::BINARY_NOISE) {
+        for (; first < last; first++) {
+          *first = static_cast<char>(m_rng());
+        }
+        return;
+      }
+
+      for (; first < last; first++) {
+        if (m_pending_lf) {
+          *first = '\n';
+          m_pending_lf = false;
+        } else if (m_line_left == 0) {
+          *first = m_dataset == Dataset::CRLF ? '\r' : '\n';
+          m_pending_lf = m_dataset == Dataset::CRLF;
+          m_line_left = next_line_length();
+        } else {
+          uint64_t roll = m_rng();
+          *first = roll % 6 == 0 ? ' ' : static_cast<char>('a' + (roll >> 8) % 26);
+          m_line_left--;
+        }
+      }
+    }
+
+  private:
+    Dataset m_dataset;
+    std::mt19937_64 m_rng;
+    uint64_t m_line_left = 0;
+    bool m_pending_lf = false;
+
+    uint64_t next_line_length() {
+      switch (m_dataset) {
+        case Dataset::SHORT_LINES:
+          return 40 + m_rng() % 61;
+        case Dataset::GIANT_LINES:
+          return (1 << 20) + m_rng() % (15 << 20);
+        default:
+          return m_rng() % 201;
+      }
+    }
+  };
+}  // namespace
+
+const char* get_dataset_name(Dataset dataset) {
+  switch (dataset) {
+    case Dataset::SHORT_LINES:
+      return "short_lines";
+    case Dataset::GIANT_LINES:
+      return "giant_lines";
+    case Dataset::CRLF:
+      return "crlf";
+    default:
+      return "binary_noise";
+  }
+}
+
+std::string write_dataset(Dataset dataset, uint64_t size) {
+  const std::string fpath = std::filesystem::temp_directory_path()
+                            / ("lfv_bench_" + std::string(get_dataset_name(dataset)) + "_"
+                               + format_size(size) + ".txt");
+  std::ofstream out(fpath, std::ios_base::binary);
+
+  DatasetGenerator generator(dataset);
+  std::string chunk(CHUNK_BYTES, ' ');
+  for (uint64_t written = 0; written < size;) {
+    const auto length = static_cast<size_t>(std::min<uint64_t>(CHUNK_BYTES, size - written));
+    generator.fill(chunk.data(), chunk.data() + length);
+    out.write(chunk.data(), static_cast<std::streamsize>(length));
+    written += length;
+  }
+
+  if (!out.flush()) {
+    throw LFVException("Cannot write " + fpath);
+  }
+
+  return fpath;
+}
+
+std::string format_size(uint64_t size) {
+  const char* units = "KMGT";
+  std::string suffix;
+  for (const char* unit = units; *unit != '\0' && size >= 1024 && size % 1024 == 0; unit++) {
+    size /= 1024;
+    suffix = *unit;
+  }
+
+  return std::to_string(size) + suffix;
+}
@@ -0,0 +1,142 @@
+#include <LFV/file_extractor.hpp>
+#include <LFV/search_stream.hpp>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+namespace {
+  constexpr int64_t MATCH_LIMIT = 5'000'000;
+  constexpr size_t SLICES = 10'000;
+  constexpr std::streamoff SLICE_BYTES = 4096;
+  constexpr size_t SCROLL_STEPS = 20'000;
+  constexpr size_t JUMPS = 200;
+  constexpr int WIDTH = 80;
+  constexpr int HEIGHT = 50;
+
+  // Whole-file passes over files this large are timed once
+  constexpr uint64_t LARGE_FILE_BYTES = 1ULL << 30;
+
+  // Lowercase letters, which seldom match so that the time is the scan itself
+  std::string make_pattern(size_t length) {
+    std::mt19937 rng(7);
+    std::string pattern;
+    for (size_t i = 0; i < length; i++) {
+      pattern += static_cast<char>('a' + rng() % 26);
+    }
+
+    return pattern;
+  }
+
+  std::vector<std::streamoff> make_positions(size_t count, std::streamoff end) {
+    std::mt19937_64 rng(5);
+    std::vector<std::streamoff> positions;
+    for (size_t i = 0; i < count; i++) {
+      positions.push_back(static_cast<std::streamoff>(rng() % static_cast<uint64_t>(end)));
+    }
+
+    return positions;
+  }
+
+  void bench_extractor(const std::string& prefix, const std::string& fpath, int repetitions) {
+    FileExtractor extractor(fpath);
+    const std::streamoff end = extractor.get_end();
+
+    double scan = measure_seconds(
+        [&] {
+          std::streamoff lines = extractor.count('\n', 0, end);
+          do_not_optimise(&lines);
+        },
+        repetitions);
+    report_throughput(prefix + "FileExtractor::count", static_cast<uint64_t>(end), scan);
+
+    const std::vector<std::streamoff> positions = make_positions(SLICES, end);
+    double slices = measure_seconds([&] {
+      for (std::streamoff pos : positions) {
+        std::string slice = extractor.slice(pos, pos + SLICE_BYTES);
+        do_not_optimise(slice.data());
+      }
+    });
+    report_latency(prefix + "FileExtractor::slice/" + std::to_string(SLICE_BYTES), SLICES,
+                   slices);
+  }
+
+  void bench_search(const std::string& prefix, const std::string& fpath, std::streamoff end,
+                    int repetitions) {
+    for (size_t length : {4, 16, 64}) {
+      const std::string pattern = make_pattern(length);
+      double seconds = measure_seconds(
+          [&] {
+            search_in_stream(std::ifstream(fpath), pattern, 0, end, MATCH_LIMIT,
+                             std::make_shared<SearchResult>(),
+                             std::make_shared<std::atomic<bool>>(false));
+          },
+          repetitions);
+      report_throughput(prefix + "search_in_stream/" + std::to_string(length),
+                        static_cast<uint64_t>(end), seconds);
+    }
+  }
+
+  void bench_window(const std::string& prefix, const std::string& fpath) {
+    EditWindowExtractor window(fpath);
+    window.set_size(WIDTH, HEIGHT);
+
+    // A short file ends before SCROLL_STEPS, so the steps taken are counted
+    size_t steps = 0;
+    double scroll = measure_seconds(
+        [&] {
+          window.move_to(0);
+          for (steps = 0; steps < SCROLL_STEPS && window.can_move_down(); steps++) {
+            window.move_down();
+          }
+        },
+        3);
+    report_latency(prefix + "EditWindowExtractor::move_down", std::max<size_t>(steps, 1), scroll);
+
+    // A jump lands in the middle of a line, which has to be found from there
+    const std::vector<std::streamoff> positions = make_positions(JUMPS, window.get_end());
+    double jumps = measure_seconds(
+        [&] {
+          for (std::streamoff pos : positions) {
+            window.move_to(pos);
+          }
+        },
+        3);
+    report_latency(prefix + "EditWindowExtractor::move_to", JUMPS, jumps);
+
+    double ends = measure_seconds(
+        [&] {
+          for (size_t i = 0; i < JUMPS; i++) {
+            window.move_to(0);
+            window.move_to_end();
+          }
+        },
+        3);
+    report_latency(prefix + "EditWindowExtractor::move_to+move_to_end", JUMPS, ends);
+  }
+}  // namespace
+
+void run_files_bench(const std::vector<uint64_t>& sizes) {
+  for (uint64_t size : sizes) {
+    const int repetitions = size >= LARGE_FILE_BYTES ? 1 : 3;
+
+    for (Dataset dataset :
+         {Dataset::SHORT_LINES, Dataset::GIANT_LINES, Dataset::CRLF, Dataset::BINARY_NOISE}) {
+      const std::string prefix
+          = std::string(get_dataset_name(dataset)) + "/" + format_size(size) + "/";
+      const std::string fpath = write_dataset(dataset, size);
+
+      bench_extractor(prefix, fpath, repetitions);
+      bench_search(prefix, fpath, static_cast<std::streamoff>(size), repetitions);
+      bench_window(prefix, fpath);
+
+      std::filesystem::remove(fpath);
+    }
+  }
+}
@@ -0,0 +1,185 @@
+#include "bench.hpp"
+
+#include <LFV/json.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/resource.h>
+#endif
+
+namespace {
+  struct BenchRecord {
+    std::string bench;
+    std::string name;
+    double seconds;
+    double value;
+    const char* unit;
+  };
+
+  std::string g_current_bench;
+  std::vector<BenchRecord> g_records;
+
+  // One object per result, and the peak RSS after each bench, which only grows
+  void write_json(std::FILE* out,
+                  const std::vector<std::pair<std::string, uint64_t>>& bench_peak_rss) {
+    std::fprintf(out, "{\n  \"results\": [");
+    for (size_t i = 0; i < g_records.size(); i++) {
+      const BenchRecord& record = g_records[i];
+      std::fprintf(out, "%s\n    {\"bench\": ", i == 0 ? "" : ",");
+      print_json_string(out, record.bench);
+      std::fprintf(out, ", \"name\": ");
+      print_json_string(out, record.name);
+      std::fprintf(out, ", \"seconds\": %.9g, \"value\": %.9g, \"unit\": \"%s\"}", record.seconds,
+                   record.value, record.unit);
+    }
+
+    std::fprintf(out, "\n  ],\n  \"peak_rss_bytes\": {");
+    for (size_t i = 0; i < bench_peak_rss.size(); i++) {
+      std::fprintf(out, "%s\n    ", i == 0 ? "" : ",");
+      print_json_string(out, bench_peak_rss[i].first);
+      std::fprintf(out, ": %llu", static_cast<unsigned long long>(bench_peak_rss[i].second));
+    }
+    std::fprintf(out, "\n  }\n}\n");
+  }
+
+  // A number of bytes, with an optional K, M, G or T suffix in powers of 1024
+  bool parse_size(const std::string& text, uint64_t& size) {
+    size_t end = 0;
+    try {
+      size = std::stoull(text, &end);
+    } catch (const std::exception&) {
+      return false;
+    }
+
+    const std::string units = "KMGT";
+    if (end + 1 == text.size() && units.find(text[end]) != std::string::npos) {
+      const size_t shift = 10 * (units.find(text[end]) + 1);
+      // Bits shifted out would wrap the size around
+      if (size > (std::numeric_limits<uint64_t>::max() >> shift)) {
+        return false;
+      }
+      size <<= shift;
+      end++;
+    }
+
+    return end == text.size() && size > 0;
+  }
+
+  bool parse_sizes(const std::string& text, std::vector<uint64_t>& sizes) {
+    sizes.clear();
+    for (size_t begin = 0; begin <= text.size();) {
+      size_t end = std::min(text.find(',', begin), text.size());
+      uint64_t size = 0;
+      if (!parse_size(text.substr(begin, end - begin), size)) {
+        return false;
+      }
+      sizes.push_back(size);
+      begin = end + 1;
+    }
+
+    return true;
+  }
+}  // namespace
+
+void report_throughput(const std::string& name, uint64_t bytes, double seconds) {
+  const double gb_per_second = static_cast<double>(bytes) / seconds / 1e9;
+  std::printf("%-56s %10.3f ms %10.3f GB/s\n", name.c_str(), seconds * 1e3, gb_per_second);
+  g_records.push_back({g_current_bench, name, seconds, gb_per_second, "GB/s"});
+}
+
+void report_latency(const std::string& name, uint64_t steps, double seconds) {
+  const double ns_per_step = seconds * 1e9 / static_cast<double>(steps);
+  std::printf("%-56s %10.3f ms %10.1f ns/step\n", name.c_str(), seconds * 1e3, ns_per_step);
+  g_records.push_back({g_current_bench, name, seconds, ns_per_step, "ns/step"});
+}
+
+uint64_t get_peak_rss_bytes() {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#  ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#  else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#  endif
+#else
+  return 0;
+#endif
+}
+
+const void* volatile g_sink = nullptr;
+
+void do_not_optimise(const void* ptr) { g_sink = ptr; }
+
+std::string write_temp_file(const std::string& name, const std::string& content) {
+  const std::string fpath = std::filesystem::temp_directory_path() / name;
+  std::ofstream out(fpath, std::ios_base::binary);
+  out << content;
+  return fpath;
+}
+
+// LFVBench [filter] [--sizes 1M,64M,...] [--json results.json]
+int main(int argc, char** argv) {
+  std::string filter;
+  std::string json_path;
+  std::vector<uint64_t> sizes{1 << 20, 64 << 20};
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--json" && i + 1 < argc) {
+      json_path = argv[++i];
+    } else if (arg == "--sizes" && i + 1 < argc) {
+      if (!parse_sizes(argv[++i], sizes)) {
+        std::fprintf(stderr, "Invalid sizes: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (filter.empty() && arg.rfind("--", 0) != 0) {
+      // Selects the benches whose name contains it
+      filter = arg;
+    } else {
+      std::fprintf(stderr, "Usage: %s [filter] [--sizes 1M,64M,...] [--json results.json]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+
+  const std::vector<std::pair<std::string, std::function<void()>>> benches{
+      {"byte_scan", run_byte_scan_bench},
+      {"search", run_search_bench},
+      {"scroll", run_scroll_bench},
+      {"files", [&] { run_files_bench(sizes); }},
+  };
+
+  std::vector<std::pair<std::string, uint64_t>> bench_peak_rss;
+  for (const auto& [name, run] : benches) {
+    if (name.find(filter) != std::string::npos) {
+      std::printf("== %s\n", name.c_str());
+      g_current_bench = name;
+      run();
+      bench_peak_rss.emplace_back(name, get_peak_rss_bytes());
+      std::printf("%-56s %10.1f MiB\n", "peak RSS",
+                  static_cast<double>(bench_peak_rss.back().second) / (1 << 20));
+    }
+  }
+
+  if (!json_path.empty()) {
+    std::FILE* out = std::fopen(json_path.c_str(), "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "Cannot write %s\n", json_path.c_str());
+      return 1;
+    }
+    write_json(out, bench_peak_rss);
+    std::fclose(out);
+  }
+
+  return 0;
+}
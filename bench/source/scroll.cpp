@@ -0,0 +1,75 @@
+#include <LFV/file_extractor.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "bench.hpp"
+
+namespace {
+  // Lines of words, with some long enough to wrap over several rows
+  std::string make_text(size_t num_lines) {
+    std::mt19937 rng(2);
+    std::string text;
+    for (size_t line = 0; line < num_lines; line++) {
+      size_t length = rng() % 8 == 0 ? 200 + rng() % 2000 : rng() % 120;
+      for (size_t i = 0; i < length; i++) {
+        text += rng() % 6 == 0 ? ' ' : static_cast<char>('a' + rng() % 26);
+      }
+      text += '\n';
+    }
+
+    return text;
+  }
+}  // namespace
+
+void run_scroll_bench() {
+  constexpr int WIDTH = 80;
+  constexpr int HEIGHT = 2000;
+  constexpr size_t STEPS = 200'000;
+
+  const std::string fpath = write_temp_file("lfv_bench_scroll.txt", make_text(100'000));
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(WIDTH, HEIGHT);
+
+  // The file may end before STEPS, so the steps taken are counted
+  size_t steps = 0;
+  double down = measure_seconds(
+      [&] {
+        extractor.move_to(0);
+        for (steps = 0; steps < STEPS && extractor.can_move_down(); steps++) {
+          extractor.move_down();
+        }
+      },
+      3);
+  report_latency("EditWindowExtractor::move_down", std::max<size_t>(steps, 1), down);
+
+  double up = measure_seconds(
+      [&] {
+        steps = 0;
+        for (size_t i = 0; i < STEPS && extractor.can_move_up(); i++, steps++) {
+          extractor.move_up();
+        }
+        for (size_t i = 0; i < STEPS && extractor.can_move_down(); i++, steps++) {
+          extractor.move_down();
+        }
+      },
+      3);
+  report_latency("EditWindowExtractor::move_up+move_down", std::max<size_t>(steps, 1), up);
+
+  // What a render reads: every visible row
+  constexpr size_t RENDERS = 1000;
+  double render = measure_seconds([&] {
+    for (size_t i = 0; i < RENDERS; i++) {
+      size_t bytes = 0;
+      for (std::string_view row : extractor.get_lines()) {
+        bytes += row.size();
+      }
+      do_not_optimise(&bytes);
+    }
+  });
+  report_latency("EditWindowExtractor::get_lines", RENDERS, render);
+
+  std::filesystem::remove(fpath);
+}
@@ -0,0 +1,97 @@
+#include <LFV/parallel_search.hpp>
+#include <LFV/search_stream.hpp>
+#include <LFV/substring_search.hpp>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+
+namespace {
+  constexpr int64_t MATCH_LIMIT = 5'000'000;
+
+  // Lowercase words separated by spaces, about 80 bytes per line
+  std::string make_text(size_t size) {
+    std::mt19937 rng(2);
+    std::string text(size, ' ');
+    for (size_t i = 0; i < size; i++) {
+      unsigned roll = rng() % 100;
+      text[i] = i % 80 == 79 ? '\n' : roll < 15 ? ' ' : static_cast<char>('a' + roll % 26);
+    }
+
+    return text;
+  }
+
+  template <typename Search> double time_search(Search&& search) {
+    return measure_seconds(
+        [&] {
+          auto result = std::make_shared<SearchResult>();
+          search(result, std::make_shared<std::atomic<bool>>(false));
+        },
+        3);
+  }
+}  // namespace
+
+void run_search_bench() {
+  constexpr size_t TEXT_BYTES = 64 << 20;
+  constexpr size_t BMH_BYTES = 8 << 20;
+
+  const std::string text = make_text(TEXT_BYTES);
+  const std::string fpath = write_temp_file("lfv_bench_search.txt", text);
+  const unsigned cores = std::max(1U, std::thread::hardware_concurrency());
+
+  const std::vector<std::pair<std::string, std::string>> patterns{
+      {"short", "zqx"},
+      {"medium", "needle in"},
+      {"long", "the quick brown fox jumps over the lazy dog"},
+  };
+
+  for (const auto& [length_name, pattern] : patterns) {
+    for (const SubstringKernel& kernel : available_substring_kernels()) {
+      SubstringSearcher searcher(pattern, kernel);
+      double seconds = measure_seconds([&] {
+        searcher.find_all(text, [](size_t offset) {
+          do_not_optimise(&offset);
+          return true;
+        });
+      });
+      report_throughput("kernel/" + length_name + "/" + kernel.name, TEXT_BYTES, seconds);
+    }
+
+    double stream = time_search([&](auto result, auto aborted) {
+      search_in_stream(std::ifstream(fpath), pattern, 0, TEXT_BYTES, MATCH_LIMIT, result, aborted);
+    });
+    report_throughput("search_in_stream/" + length_name, TEXT_BYTES, stream);
+
+    double bmh = time_search([&](auto result, auto aborted) {
+      search_in_stream_bmh(std::ifstream(fpath), pattern, 0, BMH_BYTES, MATCH_LIMIT, result,
+                           aborted);
+    });
+    report_throughput("search_in_stream_bmh/" + length_name, BMH_BYTES, bmh);
+
+    double parallel = time_search([&](auto result, auto aborted) {
+      search_in_file_parallel(fpath, pattern, 0, TEXT_BYTES, MATCH_LIMIT, result, aborted, cores);
+    });
+    report_throughput("search_in_file_parallel/" + length_name + "/" + std::to_string(cores),
+                      TEXT_BYTES, parallel);
+  }
+
+  // Regexes with and without a literal prefix to skip ahead with
+  const std::vector<std::pair<std::string, std::string>> regexes{
+      {"prefix", "needle [a-z]+"},
+      {"class", "[xz][a-z]*q[0-9]"},
+      {"anchored", "^qu[a-z]+ "},
+  };
+
+  for (const auto& [regex_name, pattern] : regexes) {
+    const Regex regex(pattern);
+    double seconds = time_search([&](auto result, auto aborted) {
+      search_regex_in_file(fpath, regex, 0, TEXT_BYTES, MATCH_LIMIT, result, aborted);
+    });
+    report_throughput("search_regex_in_file/" + regex_name, TEXT_BYTES, seconds);
+  }
+
+  std::filesystem::remove(fpath);
+}
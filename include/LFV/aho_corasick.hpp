@@ -0,0 +1,72 @@
+#ifndef LFV_AHO_CORASICK
+
+#define LFV_AHO_CORASICK
+
+#include <array>
+#include <cstdint>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Aho-Corasick automaton for finding many patterns in one pass.
+//
+// The automaton is a complete DFA stored as one flat transition table. Bytes that appear in no
+// pattern all share one column, so a row is only as wide as the number of distinct pattern bytes
+// plus one and the table stays small enough to live in cache for dozens of patterns.
+class AhoCorasick {
+public:
+  using State = int32_t;
+
+  static constexpr State INITIAL_STATE = 0;
+
+  AhoCorasick(const std::vector<std::string>& patterns);
+
+  size_t get_num_patterns() const { return m_pattern_lengths.size(); }
+
+  size_t get_pattern_length(size_t pattern) const { return m_pattern_lengths[pattern]; }
+
+  size_t get_max_pattern_length() const { return m_max_pattern_length; }
+
+  size_t get_num_states() const { return m_output_offsets.size() - 1; }
+
+  // Runs the automaton over data, whose first byte is at offset base in the file. Calls
+  // on_match(end, pattern) for every match, where end is the offset just past the match.
+  // Returns the state to continue from with the next block.
+  template <typename OnMatch>
+  State feed(State state, std::string_view data, std::streamoff base, OnMatch&& on_match) const {
+    const auto num_classes = static_cast<size_t>(m_num_classes);
+
+    for (size_t i = 0; i < data.size(); i++) {
+      auto byte_class = m_byte_classes[static_cast<unsigned char>(data[i])];
+      state = m_transitions[static_cast<size_t>(state) * num_classes + byte_class];
+
+      int32_t output = m_output_offsets[static_cast<size_t>(state)];
+      int32_t output_end = m_output_offsets[static_cast<size_t>(state) + 1];
+      for (; output < output_end; output++) {
+        on_match(base + static_cast<std::streamoff>(i) + 1,
+                 m_outputs[static_cast<size_t>(output)]);
+      }
+    }
+
+    return state;
+  }
+
+private:
+  // Up to 257 classes when patterns use every byte value, so a byte does not hold one
+  std::array<uint16_t, 256> m_byte_classes{};
+  int32_t m_num_classes = 1;
+
+  // m_transitions[state * m_num_classes + byte class] is the next state
+  std::vector<State> m_transitions;
+
+  // The patterns ending at a state are listed in m_outputs, from m_output_offsets[state] up to
+  // m_output_offsets[state + 1]
+  std::vector<int32_t> m_output_offsets;
+  std::vector<int32_t> m_outputs;
+
+  std::vector<size_t> m_pattern_lengths;
+  size_t m_max_pattern_length = 0;
+};
+
+#endif
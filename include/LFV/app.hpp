@@ -1,6 +1,16 @@
+#include <LFV/change_notifier.hpp>
+#include <LFV/file_source.hpp>
 #include <ftxui/component/component.hpp>
 #include <ftxui/dom/elements.hpp>
+#include <string>
 
 enum class Mode { VIEW, COMMAND };
 
-void run_app(std::string fpath);
\ No newline at end of file
+// Redraws for background progress happen at most max_redraw_rate times per second. With follow,
+// the view starts at the end of the file and follows it as it grows; a compressed file cannot be
+// followed, which throws before the viewer starts. With use_index_cache, the line index and
+// recent searches are saved on exit and picked up by the next session. With a trace_fpath, the
+// work of every thread is traced and written there on exit as a Chrome trace.
+void run_app(std::string fpath, const FileSourceOptions& source_options = {},
+             int32_t max_redraw_rate = ChangeNotifier::DEFAULT_MAX_RATE, bool follow = false,
+             bool use_index_cache = true, const std::string& trace_fpath = "");
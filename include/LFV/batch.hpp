@@ -0,0 +1,48 @@
+#ifndef LFV_BATCH
+
+#define LFV_BATCH
+
+#include <LFV/file_source.hpp>
+#include <LFV/index_cache.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <ios>
+#include <optional>
+#include <string>
+
+// Commands run without the viewer, for scripts. They read through the same extractors and search
+// kernels as the viewer, and write to out in large buffered writes. Ranges of a mapped file are
+// written straight from the mapping. A gzip file is indexed for searches, and otherwise
+// decompressed in order up to the end of the range. They throw LFVException on errors,
+// including when out cannot be written.
+
+struct BatchSearch {
+  std::string pattern;
+  bool regex = false;
+  std::streamoff from = 0;
+  // The end of the file if not set
+  std::optional<std::streamoff> to;
+  // Only prints the number of matches
+  bool count_only = false;
+  // Threads for a plain pattern. A regex is searched on one.
+  unsigned jobs = 1;
+};
+
+// Prints the position of each match as it is found, one per line, or only their number. Returns
+// the number of matches.
+int64_t run_batch_search(const std::string& fpath, const FileSourceOptions& source_options,
+                         const BatchSearch& search, std::FILE* out);
+
+// Prints the lines from first_line to last_line, counting from 1 and both included, or to the end
+// of the file if last_line is not set. The line index the viewer saved in index_cache_dir, if it
+// covers the first line, saves counting lines up to it. An empty index_cache_dir counts them all.
+void run_batch_lines(const std::string& fpath, const FileSourceOptions& source_options,
+                     std::streamoff first_line, std::optional<std::streamoff> last_line,
+                     std::FILE* out,
+                     const std::string& index_cache_dir = get_default_index_cache_dir());
+
+// Prints the length bytes from offset on, or fewer at the end of the file
+void run_batch_slice(const std::string& fpath, const FileSourceOptions& source_options,
+                     std::streamoff offset, std::streamoff length, std::FILE* out);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef LFV_BYTE_SCAN
+
+#define LFV_BYTE_SCAN
+
+#include <cstddef>
+#include <vector>
+
+// Byte search over in-memory blocks. Every kernel computes the same thing; they only differ in the
+// instruction set used.
+struct ByteScanKernel {
+  const char* name;
+
+  // Returns the first occurrence of target in [first, last), or nullptr if there is none
+  const char* (*find_first)(const char* first, const char* last, char target);
+
+  // Returns the last occurrence of target in [first, last), or nullptr if there is none
+  const char* (*find_last)(const char* first, const char* last, char target);
+
+  // Returns the number of occurrences of target in [first, last)
+  size_t (*count)(const char* first, const char* last, char target);
+};
+
+// Kernels supported by the running CPU, from the slowest to the fastest
+const std::vector<ByteScanKernel>& available_byte_scan_kernels();
+
+// The fastest supported kernel, picked once at runtime
+const ByteScanKernel& byte_scan_kernel();
+
+inline const char* find_byte(const char* first, const char* last, char target) {
+  return byte_scan_kernel().find_first(first, last, target);
+}
+
+inline const char* rfind_byte(const char* first, const char* last, char target) {
+  return byte_scan_kernel().find_last(first, last, target);
+}
+
+inline size_t count_byte(const char* first, const char* last, char target) {
+  return byte_scan_kernel().count(first, last, target);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef LFV_CHANGE_NOTIFIER
+
+#define LFV_CHANGE_NOTIFIER
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Wakes a consumer thread when background state changes, at most max_rate times per second.
+//
+// Producers call notify() as often as they like: it is a single load once a change is pending,
+// and notifications arriving before the consumer is done waiting are merged into one. The
+// consumer sleeps while nothing changes.
+class ChangeNotifier {
+public:
+  static constexpr int32_t DEFAULT_MAX_RATE = 30;
+
+  ChangeNotifier(int32_t max_rate = DEFAULT_MAX_RATE);
+
+  void notify();
+
+  // Calls on_change once per batch of notifications until stopped
+  void run(const std::function<void()>& on_change);
+
+  // Makes run() return, without calling on_change for pending notifications
+  void stop();
+
+  // Notifications delivered to run() so far
+  int64_t get_num_deliveries() const { return m_num_deliveries.load(); }
+
+private:
+  std::chrono::steady_clock::duration m_min_interval;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::atomic<bool> m_pending = false;
+  bool m_stopped = false;
+  std::atomic<int64_t> m_num_deliveries = 0;
+};
+
+#endif
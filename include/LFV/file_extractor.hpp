@@ -1,102 +1,249 @@
+#include <LFV/byte_scan.hpp>
+#include <LFV/file_source.hpp>
 #include <LFV/lfv_exception.hpp>
-#include <deque>
-#include <filesystem>
-#include <fstream>
-#include <iostream>
+#include <LFV/line_index.hpp>
+#include <LFV/line_prefetcher.hpp>
+#include <LFV/perf_stats.hpp>
+#include <LFV/ring_buffer.hpp>
+#include <LFV/search_result.hpp>
+#include <LFV/tracer.hpp>
+#include <algorithm>
 #include <limits>
-#include <set>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class FileExtractor {
 public:
-  FileExtractor(std::string fpath) {
-    // Open with exception thrown if fail
-    m_in.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    m_in.open(fpath);
+  FileExtractor(const std::string& fpath, const FileSourceOptions& options = {})
+      : FileExtractor(open_file_source(fpath, options)) {}
 
-    m_in.seekg(0, std::ios_base::end);
-    m_end = m_in.tellg();
-    m_in.seekg(0, std::ios_base::beg);
-    m_in.clear();
-  }
+  FileExtractor(std::unique_ptr<FileSource> source)
+      : m_source(std::move(source)), m_end(m_source->get_end()) {}
 
   std::streampos get_end() const { return m_end; }
 
+  // Extends the end over bytes appended since the file was opened, and returns it. Views taken
+  // before are invalidated.
+  std::streampos refresh() {
+    m_end = m_source->refresh();
+    return m_end;
+  }
+
+  // Whether slices are served straight from mapped pages
+  bool is_mapped() const { return m_source->data() != nullptr; }
+
+  CacheStats get_cache_stats() const { return m_source->get_cache_stats(); }
+
   int getc(std::streampos pos) {
-    m_in.clear();
-    m_in.seekg(pos);
-    return m_in.get();
+    if (pos < 0 || pos >= m_end) {
+      return std::char_traits<char>::eof();
+    }
+
+    FileBlock block = m_source->fetch(pos);
+    if (!holds(block, pos)) {
+      return std::char_traits<char>::eof();
+    }
+
+    return static_cast<unsigned char>(block.data[static_cast<size_t>(pos - block.begin)]);
   }
 
   std::streampos find_first_of(char target, std::streampos pos) {
-    m_in.clear();
-    m_in.seekg(pos);
+    return find_first_of(target, pos, m_end);
+  }
 
-    while (m_in.tellg() < m_end && m_in.peek() != target) {
-      m_in.seekg(1, std::ios_base::cur);
-    }
+  // Only looks in [pos, limit)
+  std::streampos find_first_of(char target, std::streampos pos, std::streampos limit) {
+    std::streamoff cur = std::max<std::streamoff>(pos, 0);
+    std::streamoff end = std::min<std::streamoff>(limit, m_end);
 
-    if (m_in.peek() == target) {
-      return m_in.tellg();
+    while (cur < end) {
+      FileBlock block = m_source->fetch(cur);
+      if (!holds(block, cur)) {
+        break;
+      }
+
+      std::streamoff block_end
+          = std::min(block.begin + static_cast<std::streamoff>(block.data.size()), end);
+      const char* first = block.data.data() + (cur - block.begin);
+      const char* last = block.data.data() + (block_end - block.begin);
+      const char* found = find_byte(first, last, target);
+
+      if (found != nullptr) {
+        return block.begin + (found - block.data.data());
+      }
+
+      cur = block.begin + static_cast<std::streamoff>(block.data.size());
     }
 
     return -1;
   }
 
   std::streampos find_last_of(char target, std::streampos pos) {
-    std::cerr << " starting find at " << pos << std::endl;
+    return find_last_of(target, pos, 0);
+  }
 
-    m_in.clear();
-    m_in.seekg(pos);
+  // Only looks in [limit, pos]
+  std::streampos find_last_of(char target, std::streampos pos, std::streampos limit) {
+    std::streamoff cur = std::min<std::streamoff>(pos, m_end - 1);
+    std::streamoff begin = std::max<std::streamoff>(limit, 0);
+
+    while (cur >= begin) {
+      FileBlock block = m_source->fetch(cur);
+      if (!holds(block, cur)) {
+        break;
+      }
+
+      std::streamoff block_begin = std::max(block.begin, begin);
+      const char* base = block.data.data();
+      const char* found
+          = rfind_byte(base + (block_begin - block.begin), base + (cur - block.begin) + 1, target);
+
+      if (found != nullptr) {
+        return block.begin + (found - base);
+      }
 
-    while (m_in.tellg() > 0 && m_in.peek() != target) {
-      // Some buffers do not support unget
-      m_in.seekg(-1, std::ios_base::cur);
+      cur = block.begin - 1;
     }
 
-    if (m_in.peek() == target) {
-      std::cerr << " find ended " << std::endl;
-      return m_in.tellg();
+    return -1;
+  }
+
+  // Counts the occurrences of target in [begin, end)
+  std::streamoff count(char target, std::streampos begin, std::streampos end) {
+    std::streamoff cur = std::max<std::streamoff>(begin, 0);
+    std::streamoff last = std::min<std::streamoff>(end, m_end);
+    std::streamoff total = 0;
+
+    while (cur < last) {
+      FileBlock block = m_source->fetch(cur);
+      if (!holds(block, cur)) {
+        break;
+      }
+
+      const char* base = block.data.data();
+      std::streamoff block_end
+          = std::min(block.begin + static_cast<std::streamoff>(block.data.size()), last);
+      total += static_cast<std::streamoff>(
+          count_byte(base + (cur - block.begin), base + (block_end - block.begin), target));
+
+      cur = block_end;
     }
 
-    std::cerr << " find ended " << std::endl;
+    return total;
+  }
+
+  // Returns the position of the n-th occurrence of target at or after pos, counting from 1,
+  // or -1 if there are fewer than n
+  std::streampos find_nth(char target, std::streampos pos, std::streamoff n) {
+    std::streamoff cur = std::max<std::streamoff>(pos, 0);
+
+    while (cur < m_end && n > 0) {
+      FileBlock block = m_source->fetch(cur);
+      if (!holds(block, cur)) {
+        break;
+      }
+
+      const char* base = block.data.data();
+      const char* first = base + (cur - block.begin);
+      const char* last = base + block.data.size();
+
+      while (first < last) {
+        const char* found = find_byte(first, last, target);
+        if (found == nullptr) {
+          break;
+        }
+
+        n--;
+        if (n == 0) {
+          return block.begin + (found - base);
+        }
+
+        first = found + 1;
+      }
+
+      cur = block.begin + static_cast<std::streamoff>(block.data.size());
+    }
 
     return -1;
   }
 
   std::string slice(std::streampos begin, std::streampos end) {
-    m_in.clear();
-    m_in.seekg(begin);
+    return std::string(view(begin, end));
+  }
 
-    std::string ret;
-    while (m_in.tellg() < end) {
-      ret.push_back(m_in.peek());
-      m_in.seekg(1, std::ios_base::cur);
+  // Returns the bytes in [begin, end) without copying when the file is mapped. Otherwise the bytes
+  // are gathered into a scratch buffer, and the view is valid until the next call to view.
+  std::string_view view(std::streampos begin, std::streampos end) {
+    std::streamoff first = std::max<std::streamoff>(begin, 0);
+    std::streamoff last = std::min<std::streamoff>(end, m_end);
+
+    if (first >= last) {
+      return {};
+    }
+
+    if (const char* data = m_source->data(); data != nullptr) {
+      return {data + first, static_cast<size_t>(last - first)};
+    }
+
+    m_scratch.clear();
+    for (std::streamoff cur = first; cur < last;) {
+      FileBlock block = m_source->fetch(cur);
+      if (!holds(block, cur)) {
+        break;
+      }
+
+      std::streamoff block_end = block.begin + static_cast<std::streamoff>(block.data.size());
+      std::streamoff piece_end = std::min(block_end, last);
+      m_scratch.append(block.data.substr(static_cast<size_t>(cur - block.begin),
+                                         static_cast<size_t>(piece_end - cur)));
+      cur = piece_end;
     }
 
-    return ret;
+    return m_scratch;
   }
 
 private:
-  std::streampos m_end;
-  std::ifstream m_in;
+  std::unique_ptr<FileSource> m_source;
+  std::streamoff m_end;
+
+  std::string m_scratch;
+
+  // A block read short from a file truncated under us ends before the bytes asked for, which are
+  // then taken as the end of the data
+  static bool holds(const FileBlock& block, std::streamoff pos) {
+    return pos >= block.begin && pos - block.begin < static_cast<std::streamoff>(block.data.size());
+  }
 };
 
 struct FileSegment {
   std::streampos begin_pos;
   std::streampos end_pos;
-  std::string content;
+  // Borrowed from the extractor. Only valid until the extractor is used again.
+  std::string_view content;
 };
 
 class FileLineExtractor {
 public:
   static const char EOF_CHAR = 26;
 
-  FileLineExtractor(std::string fpath) : m_file_extractor(fpath) {}
+  // Lines longer than this are cut where they cross a multiple of it in the file, so that a
+  // gigantic line is never read whole
+  static constexpr std::streamoff MAX_SEGMENT_BYTES = 1 << 16;
+
+  FileLineExtractor(const std::string& fpath, const FileSourceOptions& options = {})
+      : m_file_extractor(fpath, options) {}
 
   std::streampos get_end() const { return m_file_extractor.get_end(); }
 
+  std::streampos refresh() { return m_file_extractor.refresh(); }
+
+  CacheStats get_cache_stats() const { return m_file_extractor.get_cache_stats(); }
+
+  FileExtractor& get_file_extractor() { return m_file_extractor; }
+
   std::streampos get_line_begin(std::streampos pos) {
     if (pos == 0) {
       // If pos is at the beginning of the file
@@ -128,12 +275,74 @@ public:
     auto line_begin = get_line_begin(pos);
     auto line_end = get_line_end(pos);
 
-    return {line_begin, line_end, m_file_extractor.slice(line_begin, line_end)};
+    return {line_begin, line_end, m_file_extractor.view(line_begin, line_end)};
   }
 
   FileSegment get_line_from(std::streampos line_begin) {
     auto line_end = get_line_end(line_begin);
-    return {line_begin, line_end, m_file_extractor.slice(line_begin, line_end)};
+    return {line_begin, line_end, m_file_extractor.view(line_begin, line_end)};
+  }
+
+  // The line containing pos if it takes at most MAX_SEGMENT_BYTES. Otherwise the part of the
+  // line in the same aligned block of MAX_SEGMENT_BYTES as pos. Only reads around pos, and the
+  // segments of a line are the same from whichever position they are found.
+  FileSegment get_segment_containing(std::streampos pos) {
+    const std::streamoff end = get_end();
+    const std::streamoff block_begin = pos / MAX_SEGMENT_BYTES * MAX_SEGMENT_BYTES;
+    const std::streamoff block_end = std::min(block_begin + MAX_SEGMENT_BYTES, end);
+
+    // A line short enough to be whole has both ends within reach. An end that is out of reach
+    // is also outside the block.
+    constexpr std::streamoff UNKNOWN = -1;
+    std::streamoff lower = std::max<std::streamoff>(pos - MAX_SEGMENT_BYTES, 0);
+    std::streamoff line_begin = lower == 0 ? 0 : UNKNOWN;
+    if (pos > 0) {
+      if (auto newline = m_file_extractor.find_last_of('\n', pos - (std::streamoff)1, lower);
+          newline != -1) {
+        line_begin = newline + (std::streamoff)1;
+      }
+    }
+
+    std::streamoff upper = std::min<std::streamoff>(pos + MAX_SEGMENT_BYTES, end);
+    std::streamoff line_end = upper == end ? end : UNKNOWN;
+    if (auto newline = m_file_extractor.find_first_of('\n', pos, upper); newline != -1) {
+      line_end = newline + (std::streamoff)1;
+    }
+
+    if (line_begin == UNKNOWN || line_end == UNKNOWN
+        || line_end - line_begin > MAX_SEGMENT_BYTES) {
+      line_begin = std::max(line_begin, block_begin);
+      line_end = line_end == UNKNOWN ? block_end : std::min(line_end, block_end);
+    }
+
+    return {line_begin, line_end, m_file_extractor.view(line_begin, line_end)};
+  }
+
+  // Up to num_bytes of the line containing pos, from first_byte into the line. The line begin is
+  // found once, the line end is looked for from pos on, and only the returned bytes are read into
+  // memory.
+  FileSegment get_line_slice(std::streampos pos, std::streamoff first_byte,
+                             std::streamoff num_bytes) {
+    const std::streamoff end = get_end();
+    const std::streamoff line_begin = get_line_begin(pos);
+    std::streamoff slice_begin = std::min<std::streamoff>(line_begin + first_byte, end);
+    std::streamoff slice_end = std::min<std::streamoff>(slice_begin + num_bytes, end);
+
+    // Bytes before pos are on the line, so a newline at or after it ends the line. Up to the
+    // slice's end the line end is looked for within the slice, and only past it otherwise.
+    std::streamoff line_end = -1;
+    if (pos < slice_end) {
+      if (auto newline = m_file_extractor.find_first_of('\n', pos, slice_end); newline != -1) {
+        line_end = newline + (std::streamoff)1;
+      }
+    }
+    if (line_end == -1) {
+      line_end = get_line_end(std::max<std::streamoff>(pos, slice_end));
+    }
+
+    slice_begin = std::min(slice_begin, line_end);
+    slice_end = std::min(slice_end, line_end);
+    return {line_begin, line_end, m_file_extractor.view(slice_begin, slice_end)};
   }
 
 private:
@@ -142,39 +351,130 @@ private:
 
 class EditWindowExtractor {
 public:
-  EditWindowExtractor(std::string fpath)
+  EditWindowExtractor(std::string fpath, const FileSourceOptions& options = {})
       : m_fpath(fpath),
-        m_file_line_extractor(fpath),
-        m_size(std::filesystem::file_size(std::filesystem::path(fpath))) {
+        m_options(options),
+        m_file_line_extractor(fpath, options),
+        m_size(static_cast<std::uintmax_t>(std::streamoff(m_file_line_extractor.get_end()))) {
     load_initial_file_content();
   }
 
   void set_size(int width, int height) {
+    // A window showing the end of the file keeps showing it
+    const bool at_end = !can_move_down() && can_move_up();
+
     m_width = width;
     m_height = height;
+    if (at_end) {
+      move_to_end();
+      return;
+    }
+
     m_anchor = get_window_begin();
 
     reset();
 
     load_initial_file_content();
+    prefetch(0);
   }
 
   std::string get_fpath() { return m_fpath; }
 
+  const FileSourceOptions& get_source_options() const { return m_options; }
+
   void move_to(std::streampos pos) {
     m_anchor = pos;
 
     reset();
 
+    // Filtered lines are found from where they begin, so that the line holding pos is shown
+    if (m_filter != nullptr && pos > 0 && pos < get_end()) {
+      m_anchor = extract_raw_line_containing(pos).begin_pos;
+    }
+
     load_initial_file_content();
+    prefetch(0);
+  }
+
+  // Without wrapping, each line takes one row showing the columns from get_column() on. Only
+  // these columns are read, however long the line.
+  void set_wrap(bool wrap) {
+    m_wrap = wrap;
+    m_column = 0;
+    move_to(get_window_begin());
+  }
+
+  bool is_wrapping() const { return m_wrap; }
+
+  std::streamoff get_column() const { return m_column; }
+
+  // Scrolls sideways, when not wrapping. The loaded lines keep their bounds, so that only the
+  // columns now visible are read.
+  void move_columns(std::streamoff columns) {
+    m_column = std::max<std::streamoff>(m_column + columns, 0);
+    if (m_wrap) {
+      return;
+    }
+
+    // Each line takes one row
+    FileExtractor& file_extractor = m_file_line_extractor.get_file_extractor();
+    for (size_t i = 0; i < m_raw_lines.size(); i++) {
+      RawLine& raw_line = m_raw_lines[i];
+      const std::streamoff begin
+          = std::min<std::streamoff>(raw_line.begin_pos + m_column, raw_line.end_pos);
+      const std::streamoff end = std::min<std::streamoff>(begin + m_width, raw_line.end_pos);
+      raw_line.content->assign(file_extractor.view(begin, end));
+      m_rows[i] = *raw_line.content;
+    }
+  }
+
+  // Shows only the raw lines holding matches of filter, or every line if it is null. The lines are
+  // found from the matches as the window moves, a line with several matches once, so that only
+  // the lines in the window are read.
+  void set_filter(std::shared_ptr<const SearchResult> filter) {
+    if (filter == m_filter) {
+      return;
+    }
+
+    m_filter = std::move(filter);
+    move_to(get_window_begin());
+  }
+
+  bool is_filtering() const { return m_filter != nullptr; }
+
+  // Fills a window that the filter left short with the lines of matches found since. A window
+  // left empty shows the last lines before it instead.
+  void refresh_filter() {
+    while (static_cast<int>(m_rows.size()) < m_line_offset + m_height
+           && can_extract_next_raw_line()) {
+      add_next_raw_line();
+    }
+
+    if (m_rows.empty()) {
+      while (static_cast<int>(m_rows.size()) < m_height && can_extract_prev_raw_line()) {
+        add_prev_raw_line();
+      }
+
+      m_line_offset = std::max(0, static_cast<int>(m_rows.size()) - m_height);
+      cut_redundant_front_lines();
+    }
   }
 
   std::uintmax_t get_size() const { return m_size; }
 
   std::streampos get_end() const { return m_file_line_extractor.get_end(); }
 
+  // Start of the line holding pos, or limit if that line starts before it
+  std::streampos get_line_begin(std::streampos pos, std::streampos limit) {
+    auto newline = m_file_line_extractor.get_file_extractor().find_last_of(
+        '\n', pos - (std::streamoff)1, limit);
+    return newline == -1 ? limit : newline + (std::streamoff)1;
+  }
+
+  CacheStats get_cache_stats() const { return m_file_line_extractor.get_cache_stats(); }
+
   bool can_move_down() {
-    if (m_line_offset + m_height < static_cast<int>(m_splitted_lines.size())) {
+    if (m_line_offset + m_height < static_cast<int>(m_rows.size())) {
       return true;
     }
 
@@ -190,13 +490,14 @@ public:
   }
 
   void move_down() {
-    if (m_line_offset + m_height >= static_cast<int>(m_splitted_lines.size())) {
+    if (m_line_offset + m_height >= static_cast<int>(m_rows.size())) {
       add_next_raw_line();
     }
 
     m_line_offset++;
 
     cut_redundant_front_lines();
+    prefetch(1);
   }
 
   void move_up() {
@@ -206,27 +507,174 @@ public:
 
     m_line_offset--;
     cut_redundant_back_lines();
+    prefetch(-1);
   }
 
-  std::vector<std::string> get_lines() {
-    auto end_line_offset = std::min(static_cast<int>(m_line_offset + m_height),
-                                    static_cast<int>(m_splitted_lines.size()));
+  // The paging moves below load at most the screen they move to, however far they go
+
+  // Moves down a screen, or to the last full screen
+  void page_down() {
+    int target = m_line_offset + m_height;
+    while (static_cast<int>(m_rows.size()) < target + m_height && can_extract_next_raw_line()) {
+      add_next_raw_line();
+    }
+
+    int last_offset = std::max(m_line_offset, static_cast<int>(m_rows.size()) - m_height);
+    m_line_offset = std::min(target, last_offset);
 
-    return std::vector<std::string>{begin(m_splitted_lines) + m_line_offset,
-                                    begin(m_splitted_lines) + end_line_offset};
+    cut_redundant_front_lines();
+    prefetch(1);
+  }
+
+  // Moves up a screen, or to the start of the file
+  void page_up() {
+    while (m_line_offset < m_height && can_extract_prev_raw_line()) {
+      add_prev_raw_line();
+    }
+
+    m_line_offset = std::max(0, m_line_offset - m_height);
+
+    cut_redundant_back_lines();
+    prefetch(-1);
+  }
+
+  // Shows the last screen of the file
+  void move_to_end() {
+    m_anchor = get_end();
+
+    reset();
+
+    while (static_cast<int>(m_rows.size()) < m_height && can_extract_prev_raw_line()) {
+      add_prev_raw_line();
+    }
+
+    m_line_offset = std::max(0, static_cast<int>(m_rows.size()) - m_height);
+
+    cut_redundant_front_lines();
+    prefetch(0);
+  }
+
+  // Picks up bytes appended to the file, and returns whether it grew. With follow_end, a window
+  // showing the end of the file keeps showing it, so that it follows the file as it grows.
+  bool refresh(bool follow_end = true) {
+    const std::streampos old_end = get_end();
+    const bool at_end = follow_end && !can_move_down();
+
+    if (m_file_line_extractor.refresh() <= old_end) {
+      return false;
+    }
+
+    m_size = static_cast<std::uintmax_t>(std::streamoff(get_end()));
+    if (m_prefetcher != nullptr) {
+      m_prefetcher->refresh();
+    }
+
+    if (at_end) {
+      move_to_end();
+    } else if (get_window_end() == old_end) {
+      // The last loaded line may have been cut short at the old end
+      reload();
+    } else {
+      prefetch(0);
+    }
+
+    return true;
+  }
+
+  // Opens the file again after it was truncated or replaced, and shows its start
+  void reopen() {
+    m_file_line_extractor = FileLineExtractor(m_fpath, m_options);
+    m_size = static_cast<std::uintmax_t>(std::streamoff(get_end()));
+    m_cached_line_number.reset();
+    if (m_prefetcher != nullptr) {
+      m_prefetcher->reopen();
+    }
+
+    move_to(0);
+  }
+
+  // Reads the file through other sources from now on, keeping the window where it is
+  void set_source_options(const FileSourceOptions& options) {
+    m_options = options;
+    m_file_line_extractor = FileLineExtractor(m_fpath, m_options);
+    m_size = static_cast<std::uintmax_t>(std::streamoff(get_end()));
+    if (m_prefetcher != nullptr) {
+      m_prefetcher->set_source_options(m_options);
+    }
+
+    reload();
+  }
+
+  // Rows of the window, valid until the window is next changed
+  RingBuffer<std::string_view>::Range get_lines() const {
+    auto end_line_offset = std::min(static_cast<size_t>(m_line_offset + m_height), m_rows.size());
+
+    return m_rows.range(static_cast<size_t>(m_line_offset), end_line_offset);
   }
 
   std::streampos get_streampos() { return get_window_begin(); }
 
+  void set_line_index(std::shared_ptr<const LineIndex> line_index) {
+    m_line_index = std::move(line_index);
+    m_cached_line_number.reset();
+  }
+
+  std::shared_ptr<const LineIndex> get_line_index() const { return m_line_index; }
+
+  // Lines around the window are then read ahead in the background
+  void set_prefetcher(std::shared_ptr<LinePrefetcher> prefetcher) {
+    m_prefetcher = std::move(prefetcher);
+    prefetch(0);
+  }
+
+  // Number of the line at the top of the window, if the line index covers it
+  std::optional<std::streamoff> get_line_number() {
+    if (m_line_index == nullptr) {
+      return std::nullopt;
+    }
+
+    // Rendering asks for this on every frame, so keep the last answer for the same position
+    std::streampos pos = get_window_begin();
+    if (!m_cached_line_number || m_cached_line_pos != pos) {
+      m_cached_line_number
+          = m_line_index->get_line_number(m_file_line_extractor.get_file_extractor(), pos);
+      m_cached_line_pos = pos;
+    }
+
+    return m_cached_line_number;
+  }
+
+  // Returns false if the line index does not cover the line yet
+  bool move_to_line(std::streamoff line) {
+    if (m_line_index == nullptr) {
+      return false;
+    }
+
+    auto line_begin
+        = m_line_index->get_line_begin(m_file_line_extractor.get_file_extractor(), line);
+    if (!line_begin || *line_begin >= get_end()) {
+      return false;
+    }
+
+    move_to(*line_begin);
+    return true;
+  }
+
 private:
-  // Should be no more than 80
   struct RawLine {
-    FileSegment line;
-    int begin_offset;
-    int end_offset;
+    std::streampos begin_pos;
+    std::streampos end_pos;
+    // Owned by the raw line so that the rows can point into it
+    std::unique_ptr<std::string> content;
+    int num_rows;
   };
 
+  // Strings kept for reuse are dropped above this capacity, so that one long line does not hold
+  // its memory for the rest of the session
+  static constexpr size_t MAX_SPARE_CAPACITY = 1 << 20;
+
   std::string m_fpath;
+  FileSourceOptions m_options;
 
   FileLineExtractor m_file_line_extractor;
   std::uintmax_t m_size;
@@ -234,138 +682,285 @@ private:
   int m_width = 1;
   int m_height = 1;
 
+  bool m_wrap = true;
+  // First column shown when not wrapping
+  std::streamoff m_column = 0;
+
   // The stream position that the loaded content is anchored around
   std::streampos m_anchor = 0;
 
+  std::shared_ptr<const LineIndex> m_line_index;
+  std::shared_ptr<LinePrefetcher> m_prefetcher;
+  std::shared_ptr<const SearchResult> m_filter;
+  std::optional<std::streamoff> m_cached_line_number;
+  std::streampos m_cached_line_pos = 0;
+
   // INTERNAL DATA STRUCTURES
 
-  // m_splitted_lines and m_raw_lines need to be kept sync
-  std::vector<std::string> m_splitted_lines;
+  // Wrapped rows of the loaded raw lines, in order. Each raw line owns the text its rows point
+  // into, so scrolling only pushes and pops at the ends.
+  RingBuffer<std::string_view> m_rows;
 
   // After construction, m_raw_lines should not be empty except for the case
   // when the file is empty
-  std::deque<RawLine> m_raw_lines;
+  RingBuffer<RawLine> m_raw_lines;
+
+  // Contents of dropped raw lines, reused for the next ones
+  std::vector<std::unique_ptr<std::string>> m_spare_contents;
+
+  // Wrapping of a line being prepended, before its rows go to the front
+  std::vector<std::string_view> m_scratch_rows;
 
   int m_line_offset = 0;
 
   void reset() {
     // Reset all internal data structures
-    m_splitted_lines.clear();
-    m_raw_lines.clear();
+    m_rows.clear();
+    while (!m_raw_lines.empty()) {
+      release_content(m_raw_lines.pop_back().content);
+    }
     m_line_offset = 0;
   }
 
   void load_initial_file_content() {
-    while (can_extract_next_raw_line() && static_cast<int>(m_splitted_lines.size()) < m_height) {
+    while (can_extract_next_raw_line() && static_cast<int>(m_rows.size()) < m_height) {
       add_next_raw_line();
     }
   }
 
-  void cut_redundant_front_lines() {
-    while (!m_raw_lines.empty() && m_raw_lines.front().end_offset <= m_line_offset) {
-      int begin_offset = m_raw_lines.front().begin_offset;
-      int end_offset = m_raw_lines.front().end_offset;
+  // Reads the window again from its first line, keeping the rows scrolled past in it
+  void reload() {
+    int line_offset = m_line_offset;
+    m_anchor = get_window_begin();
 
-      int to_be_removed_num = end_offset - begin_offset;
+    reset();
 
-      for (auto& raw_line : m_raw_lines) {
-        raw_line.begin_offset -= to_be_removed_num;
-        raw_line.end_offset -= to_be_removed_num;
-      }
+    while (can_extract_next_raw_line()
+           && static_cast<int>(m_rows.size()) < line_offset + m_height) {
+      add_next_raw_line();
+    }
 
-      m_raw_lines.pop_front();
+    m_line_offset = std::min(line_offset, std::max(0, static_cast<int>(m_rows.size()) - m_height));
+    prefetch(0);
+  }
 
-      m_splitted_lines.erase(begin(m_splitted_lines) + begin_offset,
-                             begin(m_splitted_lines) + end_offset);
+  void cut_redundant_front_lines() {
+    while (!m_raw_lines.empty() && m_raw_lines.front().num_rows <= m_line_offset) {
+      RawLine raw_line = m_raw_lines.pop_front();
+      for (int i = 0; i < raw_line.num_rows; i++) {
+        m_rows.pop_front();
+      }
 
-      m_line_offset -= to_be_removed_num;
+      m_line_offset -= raw_line.num_rows;
+      release_content(std::move(raw_line.content));
     }
   }
 
   void cut_redundant_back_lines() {
-    while (!m_raw_lines.empty() && m_raw_lines.back().begin_offset >= m_line_offset + m_height) {
-      int begin_offset = m_raw_lines.back().begin_offset;
-      int end_offset = m_raw_lines.back().end_offset;
-
-      m_raw_lines.pop_back();
+    while (!m_raw_lines.empty()
+           && static_cast<int>(m_rows.size()) - m_raw_lines.back().num_rows
+                  >= m_line_offset + m_height) {
+      RawLine raw_line = m_raw_lines.pop_back();
+      for (int i = 0; i < raw_line.num_rows; i++) {
+        m_rows.pop_back();
+      }
 
-      m_splitted_lines.erase(begin(m_splitted_lines) + begin_offset,
-                             begin(m_splitted_lines) + end_offset);
+      release_content(std::move(raw_line.content));
     }
   }
 
   void add_next_raw_line() {
-    auto next_raw_line = extract_next_raw_line();
-
-    auto next_line_splitted = split_line(next_raw_line.content);
-
-    int begin_offset = m_splitted_lines.size();
-    int end_offset = m_splitted_lines.size() + next_line_splitted.size();
+    auto content = acquire_content();
+    std::streampos begin_pos = get_window_end();
+    std::streampos end_pos;
+
+    // The prefetcher reads wrapped segments
+    std::optional<std::streampos> prefetched_end;
+    if (is_prefetching()) {
+      prefetched_end = m_prefetcher->read_line_from(begin_pos, *content);
+    }
 
-    // Update all internal data structures
+    if (prefetched_end) {
+      end_pos = *prefetched_end;
+    } else {
+      auto next_raw_line = extract_next_raw_line();
+      begin_pos = next_raw_line.begin_pos;
+      end_pos = next_raw_line.end_pos;
+      content->assign(next_raw_line.content);
+    }
 
-    // Insert to the end of splitted lines
-    m_splitted_lines.insert(end(m_splitted_lines), begin(next_line_splitted),
-                            end(next_line_splitted));
+    size_t num_rows = make_rows(*content, [this](std::string_view row) { m_rows.push_back(row); });
 
-    // Insert to the end of raw lines
-    m_raw_lines.push_back({next_raw_line, begin_offset, end_offset});
+    m_raw_lines.push_back({begin_pos, end_pos, std::move(content), checked_num_rows(num_rows)});
   }
 
   void add_prev_raw_line() {
-    auto prev_raw_line = extract_prev_raw_line();
+    auto content = acquire_content();
+    std::streampos begin_pos;
+    std::streampos end_pos = get_window_begin();
+
+    std::optional<std::streampos> prefetched_begin;
+    if (is_prefetching()) {
+      prefetched_begin = m_prefetcher->read_line_before(end_pos, *content);
+    }
 
-    auto prev_line_splitted = split_line(prev_raw_line.content);
+    if (prefetched_begin) {
+      begin_pos = *prefetched_begin;
+    } else {
+      auto prev_raw_line = extract_prev_raw_line();
+      begin_pos = prev_raw_line.begin_pos;
+      end_pos = prev_raw_line.end_pos;
+      content->assign(prev_raw_line.content);
+    }
+
+    m_scratch_rows.clear();
+    size_t num_rows
+        = make_rows(*content, [this](std::string_view row) { m_scratch_rows.push_back(row); });
+    int prepended_line_offset = checked_num_rows(num_rows);
+
+    for (auto it = m_scratch_rows.rbegin(); it != m_scratch_rows.rend(); ++it) {
+      m_rows.push_front(*it);
+    }
+
+    m_raw_lines.push_front({begin_pos, end_pos, std::move(content), prepended_line_offset});
+
+    // Push the offset back
+    m_line_offset += prepended_line_offset;
+  }
 
-    size_t new_line_num = prev_line_splitted.size();
-    if (new_line_num > std::numeric_limits<int>::max()) {
+  static int checked_num_rows(size_t num_rows) {
+    if (num_rows > static_cast<size_t>(std::numeric_limits<int>::max())) {
       throw LFVException("Line length exceeded limit");
     }
 
-    auto prepended_line_offset = static_cast<int>(new_line_num);
+    return static_cast<int>(num_rows);
+  }
 
-    for (auto& raw_line : m_raw_lines) {
-      raw_line.begin_offset += prepended_line_offset;
-      raw_line.end_offset += prepended_line_offset;
+  std::unique_ptr<std::string> acquire_content() {
+    std::unique_ptr<std::string> content;
+    if (m_spare_contents.empty()) {
+      content = std::make_unique<std::string>();
+    } else {
+      content = std::move(m_spare_contents.back());
+      m_spare_contents.pop_back();
     }
 
-    // Update all internal data structures
+    return content;
+  }
 
-    // Insert into the beginning of splitted lines
-    m_splitted_lines.insert(begin(m_splitted_lines), begin(prev_line_splitted),
-                            end(prev_line_splitted));
+  void release_content(std::unique_ptr<std::string> content) {
+    if (content != nullptr && content->capacity() <= MAX_SPARE_CAPACITY) {
+      m_spare_contents.push_back(std::move(content));
+    }
+  }
 
-    // Insert into the beginning of raw lines
-    m_raw_lines.push_front({prev_raw_line, 0, prepended_line_offset});
+  // The prefetcher reads the lines next to the window, which a filter skips
+  bool is_prefetching() const { return m_prefetcher != nullptr && m_wrap && m_filter == nullptr; }
 
-    // Push the offset back
-    m_line_offset += new_line_num;
+  void prefetch(int direction) {
+    if (is_prefetching()) {
+      m_prefetcher->on_scroll(direction, get_window_begin(), get_window_end(), m_height);
+    }
+  }
+
+  // Raw lines are the segments of lines when wrapping, so that a gigantic line is only read and
+  // wrapped around the window. Otherwise they are whole lines, of which only the visible columns
+  // are read.
+  FileSegment extract_raw_line_containing(std::streampos pos) {
+    SampledTimer timer(get_perf_stats().line_reads);
+    TraceSpan span("line read");
+    if (!m_wrap) {
+      return m_file_line_extractor.get_line_slice(pos, m_column, m_width);
+    }
+
+    return m_file_line_extractor.get_segment_containing(pos);
   }
 
   FileSegment extract_prev_raw_line() {
-    return m_file_line_extractor.get_line_containing(get_window_begin() - (std::streamoff)1);
+    if (m_filter != nullptr) {
+      return extract_raw_line_containing(*find_match_before(get_window_begin()));
+    }
+
+    return extract_raw_line_containing(get_window_begin() - (std::streamoff)1);
   }
 
   FileSegment extract_next_raw_line() {
-    return m_file_line_extractor.get_line_containing(get_window_end());
+    if (m_filter != nullptr) {
+      return extract_raw_line_containing(*find_match_from(get_window_end()));
+    }
+
+    return extract_raw_line_containing(get_window_end());
+  }
+
+  bool can_extract_next_raw_line() {
+    if (m_filter != nullptr) {
+      return find_match_from(get_window_end()).has_value();
+    }
+
+    return get_window_end() < m_file_line_extractor.get_end();
+  }
+
+  bool can_extract_prev_raw_line() {
+    if (m_filter != nullptr) {
+      return find_match_before(get_window_begin()).has_value();
+    }
+
+    return get_window_begin() > 0;
+  }
+
+  // The first match of the filter at or after pos. The window's ends are where raw lines begin,
+  // so the match is on a raw line after the window. Matches are only ever appended, so a match
+  // found once is found again.
+  std::optional<std::streampos> find_match_from(std::streampos pos) {
+    int64_t index = m_filter->find_match(pos);
+    if (index >= m_filter->get_num_matches()) {
+      return std::nullopt;
+    }
+
+    // A match added since the lookup may come before pos
+    std::streampos match = m_filter->get_match(index);
+    if (match < pos || match >= get_end()) {
+      return std::nullopt;
+    }
+
+    return match;
   }
 
-  bool can_extract_next_raw_line() { return get_window_end() < m_file_line_extractor.get_end(); }
+  // The last match of the filter before pos
+  std::optional<std::streampos> find_match_before(std::streampos pos) {
+    int64_t index = m_filter->find_match(pos);
+    if (index == 0) {
+      return std::nullopt;
+    }
+
+    return m_filter->get_match(index - 1);
+  }
 
-  bool can_extract_prev_raw_line() { return get_window_begin() > 0; }
+  // Calls emit with the rows of a raw line, and returns the number of rows
+  template <typename Emit> size_t make_rows(std::string_view line, Emit&& emit) const {
+    if (!m_wrap) {
+      emit(line);
+      return 1;
+    }
+
+    SampledTimer timer(get_perf_stats().split_line);
+    return split_line(line, emit);
+  }
 
-  std::vector<std::string> split_line(const std::string& line, const char sep = ' ') const {
-    std::vector<std::string> ret;
+  // Calls emit with each row the line wraps into, and returns the number of rows
+  template <typename Emit> size_t split_line(std::string_view line, Emit&& emit) const {
+    const char sep = ' ';
+    size_t num_rows = 0;
 
     for (size_t i = 0; i < line.size();) {
       // Take the rest of the line if possible
-      uint32_t width = line.size() - i;
+      size_t width = line.size() - i;
 
       if (i + m_width < line.size()) {
         // Otherwise, take until the last separator if there is one
-        int next_space = line.find_last_of(sep, i + m_width - 1);
+        size_t next_space = line.find_last_of(sep, i + m_width - 1);
 
-        if (next_space == -1 || (next_space >= 0 && (unsigned)next_space < i)) {
+        if (next_space == std::string_view::npos || next_space < i) {
           // No space before next cut
           // We just simply cut at that point.
           // In extreme cases a word will be seperated
@@ -376,12 +971,13 @@ private:
         }
       }
 
-      ret.push_back(line.substr(i, width));
+      emit(line.substr(i, width));
+      num_rows++;
 
       i += width;
     }
 
-    return ret;
+    return num_rows;
   }
 
   std::streampos get_window_begin() {
@@ -389,7 +985,7 @@ private:
       return m_anchor;
     }
 
-    return m_raw_lines.front().line.begin_pos;
+    return m_raw_lines.front().begin_pos;
   }
 
   std::streampos get_window_end() {
@@ -397,6 +993,6 @@ private:
       return m_anchor;
     }
 
-    return m_raw_lines.back().line.end_pos;
+    return m_raw_lines.back().end_pos;
   }
 };
\ No newline at end of file
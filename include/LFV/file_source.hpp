@@ -0,0 +1,195 @@
+#ifndef LFV_FILE_SOURCE
+
+#define LFV_FILE_SOURCE
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// A run of contiguous file bytes starting at begin
+struct FileBlock {
+  std::streamoff begin;
+  std::string_view data;
+};
+
+class GzipIndex;
+
+struct FileSourceOptions {
+  // Try to map the file before falling back to the page cache
+  bool use_mmap = true;
+  // Block size and capacity of the page cache. Memory stays under page_size * cache_pages.
+  size_t page_size = 1 << 16;
+  size_t cache_pages = 64;
+  // Checkpoints of a gzip file, which is then read decompressed
+  std::shared_ptr<const GzipIndex> gzip_index;
+};
+
+struct CacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// Pages of a file by where they begin, in least recently used order. Evicted pages are recycled
+// with their buffers, so a full cache no longer allocates.
+class PageCache {
+public:
+  PageCache(size_t capacity);
+
+  // The page beginning at begin, if cached, which becomes the most recently used
+  const std::string* find(std::streamoff begin);
+
+  // Buffer for the page beginning at begin, to be filled by the caller. Evicts the least
+  // recently used page when full.
+  std::string& insert(std::streamoff begin);
+
+  void erase(std::streamoff begin);
+
+  CacheStats get_stats() const {
+    return {m_hits.load(std::memory_order_relaxed), m_misses.load(std::memory_order_relaxed)};
+  }
+
+private:
+  struct Page {
+    std::streamoff begin;
+    std::string data;
+  };
+
+  size_t m_capacity;
+
+  // Most recently used page first
+  std::list<Page> m_pages;
+  std::unordered_map<std::streamoff, std::list<Page>::iterator> m_page_index;
+
+  std::atomic<uint64_t> m_hits = 0;
+  std::atomic<uint64_t> m_misses = 0;
+};
+
+// Random access to the bytes of a file. FileExtractor is built on top of this so that the
+// storage strategy (memory mapping, buffered reads, ...) can change without touching the
+// line and window logic.
+class FileSource {
+public:
+  FileSource() = default;
+  FileSource(FileSource&&) = delete;
+  FileSource(const FileSource&) = delete;
+
+  FileSource& operator=(FileSource&&) = delete;
+  FileSource& operator=(const FileSource&) = delete;
+
+  virtual ~FileSource() = default;
+
+  virtual std::streamoff get_end() const = 0;
+
+  // Extends the end over bytes appended to the file since it was opened, and returns the new end.
+  // Blocks and data() obtained before are invalidated. A file that shrank keeps its old end:
+  // callers detect truncation themselves and open it again.
+  virtual std::streamoff refresh() { return get_end(); }
+
+  // Returns a block containing pos, which must be in [0, get_end()). Reads of a file truncated
+  // since it was opened come up short: the block then ends before pos, and may be empty.
+  // The view is only valid until the next call to fetch.
+  virtual FileBlock fetch(std::streamoff pos) = 0;
+
+  // Returns the whole file as one contiguous buffer, or nullptr if the source can't provide it.
+  // The buffer lives as long as the source.
+  virtual const char* data() const { return nullptr; }
+
+  // Sources without a cache report no hits or misses
+  virtual CacheStats get_cache_stats() const { return {}; }
+};
+
+// Maps the whole file into the address space. Throws LFVException if the file cannot be mapped.
+class MappedFileSource final : public FileSource {
+public:
+  MappedFileSource(const std::string& fpath);
+  MappedFileSource(MappedFileSource&&) = delete;
+  MappedFileSource(const MappedFileSource&) = delete;
+
+  MappedFileSource& operator=(MappedFileSource&&) = delete;
+  MappedFileSource& operator=(const MappedFileSource&) = delete;
+
+  ~MappedFileSource() override;
+
+  std::streamoff get_end() const override { return m_size; }
+
+  FileBlock fetch([[maybe_unused]] std::streamoff pos) override {
+    return {0, std::string_view(m_data, static_cast<size_t>(m_size))};
+  }
+
+  const char* data() const override { return m_data; }
+
+  // Maps the file again when it grew
+  std::streamoff refresh() override;
+
+private:
+  int m_fd = -1;
+  const char* m_data = nullptr;
+  std::streamoff m_size = 0;
+};
+
+// Fallback for files that cannot be mapped: reads aligned blocks through an ifstream.
+class StreamFileSource final : public FileSource {
+public:
+  static constexpr std::streamoff BLOCK_SIZE = 1 << 16;
+
+  StreamFileSource(const std::string& fpath);
+
+  std::streamoff get_end() const override { return m_end; }
+
+  FileBlock fetch(std::streamoff pos) override;
+
+  std::streamoff refresh() override;
+
+private:
+  std::ifstream m_in;
+  std::streamoff m_end = 0;
+
+  std::string m_block;
+  std::streamoff m_block_begin = -1;
+};
+
+// Reads fixed-size blocks with pread into a bounded LRU page cache. Throws LFVException if the
+// file cannot be opened.
+class PagedFileSource final : public FileSource {
+public:
+  PagedFileSource(const std::string& fpath, size_t page_size, size_t cache_pages);
+  PagedFileSource(PagedFileSource&&) = delete;
+  PagedFileSource(const PagedFileSource&) = delete;
+
+  PagedFileSource& operator=(PagedFileSource&&) = delete;
+  PagedFileSource& operator=(const PagedFileSource&) = delete;
+
+  ~PagedFileSource() override;
+
+  std::streamoff get_end() const override { return m_end; }
+
+  FileBlock fetch(std::streamoff pos) override;
+
+  // Drops the page holding the old end, which was read short
+  std::streamoff refresh() override;
+
+  CacheStats get_cache_stats() const override { return m_cache.get_stats(); }
+
+private:
+  int m_fd = -1;
+  std::streamoff m_end = 0;
+  std::streamoff m_page_size;
+  PageCache m_cache;
+  // A page read short, which is not cached so that it is read again
+  std::string m_short_page;
+
+  void load_page(std::string& data, std::streamoff begin);
+};
+
+// Reads gzip files through their index. Maps the file if possible. Otherwise falls back to the
+// page cache, or to buffered stream reads on platforms without pread.
+std::unique_ptr<FileSource> open_file_source(const std::string& fpath,
+                                             const FileSourceOptions& options = {});
+
+#endif
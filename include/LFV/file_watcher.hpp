@@ -0,0 +1,88 @@
+#ifndef LFV_FILE_WATCHER
+
+#define LFV_FILE_WATCHER
+
+#include <LFV/change_notifier.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// What identifies a file and tells whether it changed
+struct FileStatus {
+  uint64_t device = 0;
+  uint64_t inode = 0;
+  std::streamoff size = 0;
+  int64_t modified = 0;
+
+  // Whether both describe the same file, even if its content changed
+  bool is_same_file(const FileStatus& other) const {
+    return device == other.device && inode == other.inode;
+  }
+
+  bool operator==(const FileStatus& other) const {
+    return is_same_file(other) && size == other.size && modified == other.modified;
+  }
+
+  bool operator!=(const FileStatus& other) const { return !(*this == other); }
+};
+
+// Status of the file at fpath, or nothing if it does not exist. Without inode numbers on the
+// platform, every file looks like the same one.
+std::optional<FileStatus> stat_file(const std::string& fpath);
+
+// Watches a file on a thread of its own, and bumps a generation counter and notifies whenever its
+// status changes: when it grows, is truncated, or when another file takes its name, as log
+// rotation does.
+//
+// On Linux, inotify watches the directory of the file, so that a file created under the name is
+// seen too. The status is also checked every POLL_INTERVAL, which is the only way to notice
+// changes elsewhere and on file systems where inotify stays silent, such as network mounts.
+class FileWatcher {
+public:
+  static constexpr std::chrono::milliseconds POLL_INTERVAL{500};
+
+  FileWatcher(std::string fpath, std::shared_ptr<ChangeNotifier> notifier);
+
+  // Stops and joins the thread
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  // Changes seen so far
+  uint64_t get_generation() const { return m_generation.load(); }
+
+  bool is_using_inotify() const { return m_inotify_fd != -1; }
+
+private:
+  std::string m_fpath;
+  std::shared_ptr<ChangeNotifier> m_notifier;
+  std::optional<FileStatus> m_status;
+  std::atomic<uint64_t> m_generation = 0;
+
+  int m_inotify_fd = -1;
+  // Written to in order to wake the thread from poll
+  int m_stop_pipe[2] = {-1, -1};
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stopped = false;
+
+  std::thread m_thread;
+
+  void run();
+
+  // Returns false once stopped. Waits up to POLL_INTERVAL for an event about the file.
+  bool wait_for_event();
+
+  void check_status();
+};
+
+#endif
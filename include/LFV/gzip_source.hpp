@@ -0,0 +1,143 @@
+#ifndef LFV_GZIP_SOURCE
+
+#define LFV_GZIP_SOURCE
+
+#include <LFV/change_notifier.hpp>
+#include <LFV/file_source.hpp>
+#include <LFV/search_result.hpp>
+#include <atomic>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Whether the file starts with the gzip magic bytes
+bool is_gzip_file(const std::string& fpath);
+
+// Random access into a gzip file, in the manner of zlib's zran example. One pass over the file
+// saves the decompressor's state every span bytes of output: where it is in the compressed
+// stream, and the last 32 KiB it produced, which later back-references may point into. Reading
+// from any position then only decompresses from the checkpoint before it.
+//
+// Windows are kept deflated, which usually takes a few KiB each. Files made of several gzip
+// members one after another, as written by cat a.gz b.gz, are read as one.
+//
+// The index is built by one background thread and can be used by others while it grows: the
+// decompressed bytes it has reached so far can already be read.
+class GzipIndex {
+public:
+  static constexpr std::streamoff DEFAULT_SPAN = 4 << 20;
+  static constexpr size_t WINDOW_SIZE = 1 << 15;
+
+  struct Checkpoint {
+    // Position in the decompressed data
+    std::streamoff out_pos = 0;
+    // Position of the first compressed byte not fully used, or 0 for the start of the file
+    std::streamoff in_pos = 0;
+    // Bits of the byte before in_pos still to be used
+    int bits = 0;
+    // The WINDOW_SIZE bytes of output before out_pos, deflated
+    std::string window;
+  };
+
+  GzipIndex(std::string fpath, std::streamoff span = DEFAULT_SPAN);
+
+  // Decompresses the whole file, saving checkpoints as it goes. Throws LFVException if the data
+  // is corrupt. A file cut short, such as one still being written, ends where its data does.
+  void build(const std::atomic<bool>& aborted);
+
+  const std::string& get_fpath() const { return m_fpath; }
+
+  std::streamoff get_span() const { return m_span; }
+
+  BackgroundTaskStatus get_status() const { return m_status.load(); }
+
+  // Told about the progress of the build. Set before building.
+  void set_notifier(std::shared_ptr<ChangeNotifier> notifier) { m_notifier = std::move(notifier); }
+
+  // Decompressed bytes covered so far. This is the size of the data once the build has finished.
+  std::streamoff get_end() const { return m_end.load(std::memory_order_acquire); }
+
+  size_t get_num_checkpoints() const;
+
+  // The last checkpoint at or before pos
+  Checkpoint get_checkpoint_before(std::streamoff pos) const;
+
+  // Where that checkpoint is, without copying its window
+  std::streamoff get_checkpoint_pos_before(std::streamoff pos) const;
+
+  // Where the checkpoints are in the decompressed data, in order
+  std::vector<std::streamoff> get_checkpoint_positions() const;
+
+private:
+  std::string m_fpath;
+  std::streamoff m_span;
+
+  mutable std::mutex m_mutex;
+  // Starts with the start of the file
+  std::vector<Checkpoint> m_checkpoints;
+
+  std::atomic<BackgroundTaskStatus> m_status = BackgroundTaskStatus::NOT_STARTED;
+  std::atomic<std::streamoff> m_end = 0;
+
+  std::shared_ptr<ChangeNotifier> m_notifier;
+
+  void set_status(BackgroundTaskStatus status);
+
+  void notify() const;
+};
+
+// Decompresses a gzip file from a checkpoint on. Defined with the sources.
+class GzipInflater;
+
+// Decompressed bytes of a gzip file, through its index. Pages start at fixed steps from the
+// checkpoint before them, so that reading from a checkpoint never decompresses the span before
+// it. Reading on from the last page carries on with the same decompressor, and a page that needs
+// to go back starts from the checkpoint before it and caches the pages leading up to it, so that
+// scrolling backward does not decompress the span once per page.
+class GzipFileSource final : public FileSource {
+public:
+  GzipFileSource(std::shared_ptr<const GzipIndex> index, size_t page_size, size_t cache_pages);
+  GzipFileSource(GzipFileSource&&) = delete;
+  GzipFileSource(const GzipFileSource&) = delete;
+
+  GzipFileSource& operator=(GzipFileSource&&) = delete;
+  GzipFileSource& operator=(const GzipFileSource&) = delete;
+
+  ~GzipFileSource() override;
+
+  std::streamoff get_end() const override { return m_end; }
+
+  FileBlock fetch(std::streamoff pos) override;
+
+  // Extends the end over what the index has decompressed since
+  std::streamoff refresh() override;
+
+  CacheStats get_cache_stats() const override { return m_cache.get_stats(); }
+
+private:
+  std::shared_ptr<const GzipIndex> m_index;
+  std::streamoff m_end = 0;
+  std::streamoff m_page_size;
+  size_t m_cache_pages;
+  PageCache m_cache;
+
+  // The page fetched last, which scans over a page ask for again and again
+  std::streamoff m_last_begin = -1;
+  std::string_view m_last_data;
+
+  std::unique_ptr<GzipInflater> m_inflater;
+  // Position of the checkpoint the inflater started from
+  std::streamoff m_inflater_checkpoint = -1;
+  // Pages skipped on the way to another are decompressed into this
+  std::string m_scratch;
+
+  // Loads the page beginning at begin, which lies in the span of the checkpoint at base
+  const std::string& load_page(std::streamoff begin, std::streamoff base);
+
+  void read_page(std::string& data, std::streamoff size);
+};
+
+#endif
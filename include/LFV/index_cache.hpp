@@ -0,0 +1,88 @@
+#ifndef LFV_INDEX_CACHE
+
+#define LFV_INDEX_CACHE
+
+#include <LFV/line_index.hpp>
+#include <LFV/search_result.hpp>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A search whose results are kept, with what it looked for and where
+struct SavedSearch {
+  std::vector<std::string> patterns;
+  bool regex = false;
+  bool any = false;
+  std::streamoff from = 0;
+  // Searched up to there
+  std::streamoff to = 0;
+  // Whether the search carries on as the file grows
+  bool to_end = false;
+  // Finished. Whether it only counts is part of the result.
+  std::shared_ptr<SearchResult> result;
+};
+
+// What identifies the content of a file: its size and modification time, and a hash of a few
+// samples of it, the last one at its end
+struct FileKey {
+  std::streamoff size = 0;
+  int64_t modified = 0;
+  uint64_t sample_hash = 0;
+};
+
+// Key of the file as it is now, or nothing if it cannot be read
+std::optional<FileKey> get_file_key(const std::string& fpath);
+
+// Whether the file still holds the content the key was taken from, possibly followed by more.
+// Only the samples of the key are read again.
+bool is_same_content(const std::string& fpath, const FileKey& key);
+
+// $XDG_CACHE_HOME/lfv, or ~/.cache/lfv, or a directory under the temporary directory
+std::string get_default_index_cache_dir();
+
+// Line index and recent search results of a file, saved when it is closed so that reopening it
+// shows line numbers and results right away. The cache is one file per viewed file, named after
+// a hash of its absolute path.
+//
+// The format is versioned and compact: fixed-size little-endian header fields, then varints,
+// with positions delta-encoded, and a checksum at the end. It is memory-mapped to be read. A file
+// that only grew since is recognised by its samples up to the saved size, and only the bytes past
+// that are indexed and searched again.
+class IndexCache {
+public:
+  static constexpr uint32_t VERSION = 2;
+  static constexpr size_t MAX_SEARCHES = 4;
+  // Larger results are not worth the disk space and time to save
+  static constexpr int64_t MAX_SAVED_MATCHES = 1 << 22;
+
+  struct State {
+    std::shared_ptr<LineIndex> line_index;
+    // Most recent first
+    std::vector<SavedSearch> searches;
+  };
+
+  // Takes the key of the file as it is when opened
+  IndexCache(std::string fpath, std::string cache_dir = get_default_index_cache_dir());
+
+  const std::string& get_cache_path() const { return m_cache_path; }
+
+  // What was saved for the file, if anything was and the file did not change since other than by
+  // growing. A cache that is corrupt or of another version is ignored.
+  std::optional<State> load() const;
+
+  // Saves the index and searches, which must not be in use by background tasks. Nothing is saved
+  // if the file changed since it was opened other than by growing. Throws LFVException if the
+  // cache cannot be written. A temporary file is renamed over the cache, so that a concurrent
+  // reader never sees half of it.
+  void save(const LineIndex& line_index, const std::vector<SavedSearch>& searches) const;
+
+private:
+  std::string m_fpath;
+  std::string m_cache_path;
+  std::optional<FileKey> m_key;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef LFV_JSON
+
+#define LFV_JSON
+
+#include <cstdio>
+#include <string>
+
+// Writes str as a quoted JSON string, escaping quotes, backslashes and control characters
+void print_json_string(std::FILE* out, const std::string& str);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef LFV_LINE_INDEX
+
+#define LFV_LINE_INDEX
+
+#include <LFV/change_notifier.hpp>
+#include <LFV/search_result.hpp>
+#include <atomic>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+class FileExtractor;
+
+// Sparse map from line numbers to byte offsets. Only the start of every interval-th line is
+// stored, so the index takes 8 bytes per interval lines; other lines are found by scanning
+// forward from the nearest checkpoint. Line numbers start from 0.
+//
+// The index is built by one background thread and can be queried from others while it grows.
+class LineIndex {
+public:
+  static constexpr std::streamoff DEFAULT_CHECKPOINT_INTERVAL = 4096;
+
+  LineIndex(std::streamoff checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL);
+
+  // Scans the file from where the last build stopped to the end of the extractor, publishing
+  // checkpoints as it goes. Building again after the file grew only scans the new bytes, and an
+  // aborted build carries on where it was stopped.
+  void build(FileExtractor& extractor, const std::atomic<bool>& aborted);
+
+  BackgroundTaskStatus get_status() const { return m_status.load(); }
+
+  // Told about the progress of the build. Set before building.
+  void set_notifier(std::shared_ptr<ChangeNotifier> notifier) { m_notifier = std::move(notifier); }
+
+  // Bytes from the start of the file covered so far
+  std::streamoff get_indexed_pos() const { return m_indexed_pos.load(std::memory_order_acquire); }
+
+  std::streamoff get_end() const { return m_end.load(); }
+
+  // Lines seen so far. This is the line count of the file once the build has finished.
+  std::streamoff get_num_lines() const;
+
+  // Number of the line containing pos, if the index covers pos
+  std::optional<std::streamoff> get_line_number(FileExtractor& extractor,
+                                                std::streampos pos) const;
+
+  // Position where the line begins, if the index covers it
+  std::optional<std::streampos> get_line_begin(FileExtractor& extractor,
+                                               std::streamoff line) const;
+
+  std::streamoff get_interval() const { return m_interval; }
+
+  // Newlines before the indexed position
+  std::streamoff get_num_newlines() const {
+    return m_num_newlines.load(std::memory_order_acquire);
+  }
+
+  // Checkpoints up to the indexed position, as saved by the index cache. Read while no build runs.
+  std::vector<std::streamoff> get_checkpoints() const;
+
+  // Carries on from an index of the same file saved earlier, which covered indexed_pos bytes and
+  // num_newlines newlines. Call before building. Throws LFVException if the checkpoints do not fit.
+  void restore(std::vector<std::streamoff> checkpoints, std::streamoff num_newlines,
+               std::streamoff indexed_pos);
+
+private:
+  std::streamoff m_interval;
+
+  mutable std::mutex m_mutex;
+  // m_checkpoints[i] is where line i * m_interval begins
+  std::vector<std::streamoff> m_checkpoints;
+
+  std::atomic<BackgroundTaskStatus> m_status;
+  std::atomic<std::streamoff> m_end = 0;
+  std::atomic<std::streamoff> m_indexed_pos = 0;
+  std::atomic<std::streamoff> m_num_newlines = 0;
+  std::atomic<bool> m_has_unterminated_line = false;
+
+  std::shared_ptr<ChangeNotifier> m_notifier;
+
+  void set_status(BackgroundTaskStatus status);
+
+  void notify() const;
+
+  std::streamoff get_checkpoint(std::streamoff index) const;
+};
+
+#endif
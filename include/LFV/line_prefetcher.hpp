@@ -0,0 +1,132 @@
+#ifndef LFV_LINE_PREFETCHER
+
+#define LFV_LINE_PREFETCHER
+
+#include <LFV/file_source.hpp>
+#include <LFV/task_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ios>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class FileLineExtractor;
+
+// Reads the lines around the edit window on a background worker, so that scrolling finds them in
+// memory instead of reading the file on the UI thread.
+//
+// The window reports every scroll step. The prefetcher keeps a moving estimate of the scroll
+// velocity and reads further ahead in the scroll direction the faster the window moves, from one
+// screen when still up to MAX_SCREENS screens. One job at a time reads lines with its own
+// extractor. Requests arriving meanwhile are merged into the latest one, which the job handles
+// next.
+//
+// Lines are the segments the window wraps, which take at most
+// FileLineExtractor::MAX_SEGMENT_BYTES each, so memory stays at a few screens of segments.
+class LinePrefetcher : public std::enable_shared_from_this<LinePrefetcher> {
+public:
+  static constexpr int64_t MAX_SCREENS = 8;
+  // How far ahead the prefetched lines should last at the current velocity
+  static constexpr double LOOKAHEAD_SECONDS = 0.5;
+
+  LinePrefetcher(std::string fpath, const FileSourceOptions& options,
+                 std::shared_ptr<TaskPool> task_pool);
+
+  ~LinePrefetcher();
+
+  LinePrefetcher(const LinePrefetcher&) = delete;
+  LinePrefetcher& operator=(const LinePrefetcher&) = delete;
+
+  // Called by the window after it moved by direction rows (-1, 0 or 1). The window shows
+  // height rows of the bytes from begin to end.
+  void on_scroll(int direction, std::streampos begin, std::streampos end, int height);
+
+  // Copies the line starting at begin into content and returns where it ends, if it is loaded
+  std::optional<std::streampos> read_line_from(std::streampos begin, std::string& content);
+
+  // Copies the line ending at end into content and returns where it begins, if it is loaded
+  std::optional<std::streampos> read_line_before(std::streampos end, std::string& content);
+
+  // The file grew: loaded lines are dropped, as the last one may have been cut short, and the job
+  // extends its end
+  void refresh();
+
+  // The file was truncated or replaced: loaded lines are dropped, and the job opens it again
+  void reopen();
+
+  // Lines are read through other sources from the next job on
+  void set_source_options(const FileSourceOptions& options);
+
+  // Lines requested by the window that were loaded or not
+  CacheStats get_stats() const;
+
+  // Whether no job is queued or running
+  bool is_idle() const;
+
+  // Lines to keep loaded ahead of a window of height rows moving at velocity rows per second
+  static int64_t get_depth(double velocity, int height);
+
+private:
+  struct Request {
+    std::streampos begin;
+    std::streampos end;
+    int64_t lines_down;
+    int64_t lines_up;
+  };
+
+  struct Line {
+    std::streampos end;
+    std::string content;
+  };
+
+  using LineMap = std::map<std::streamoff, Line>;
+
+  std::string m_fpath;
+  FileSourceOptions m_options;
+  std::shared_ptr<TaskPool> m_task_pool;
+
+  // Scroll velocity estimate in rows per second, only touched by the window's thread
+  int m_last_direction = 0;
+  std::chrono::steady_clock::time_point m_last_step;
+  double m_velocity = 0;
+
+  mutable std::mutex m_mutex;
+  // Loaded lines by where they begin
+  LineMap m_lines;
+  std::optional<Request> m_pending;
+  bool m_job_running = false;
+  TaskHandle m_job;
+  // Bumped when the file changes. Lines read before that are not kept.
+  uint64_t m_generation = 0;
+  bool m_reopen = false;
+
+  std::atomic<uint64_t> m_hits = 0;
+  std::atomic<uint64_t> m_misses = 0;
+
+  // Only used by the job
+  std::unique_ptr<FileLineExtractor> m_extractor;
+  uint64_t m_extractor_generation = 0;
+
+  void invalidate(bool reopen);
+
+  // Stores a line read by the job, unless the file changed since the job started
+  bool add_line(uint64_t generation, std::streamoff begin, std::streampos end,
+                std::string_view content);
+
+  void run_jobs(const CancellationToken& token);
+
+  void prefetch(const Request& request, const CancellationToken& token);
+
+  // Loaded line starting at begin or ending at end, or the end of m_lines. Called with the
+  // mutex held.
+  LineMap::const_iterator find_line_from(std::streampos begin) const;
+
+  LineMap::const_iterator find_line_before(std::streampos end) const;
+};
+
+#endif
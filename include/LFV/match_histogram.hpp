@@ -0,0 +1,55 @@
+#ifndef LFV_MATCH_HISTOGRAM
+
+#define LFV_MATCH_HISTOGRAM
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <vector>
+
+// Number of matches in each of a fixed number of equal-sized buckets of the file. Memory does not
+// depend on the number of matches. Matches can be added from several threads while others read.
+class MatchHistogram {
+public:
+  static constexpr size_t DEFAULT_NUM_BUCKETS = 1024;
+
+  MatchHistogram(std::streampos file_end, size_t num_buckets = DEFAULT_NUM_BUCKETS);
+
+  void add(std::streampos pos) {
+    m_buckets[get_bucket(pos)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Adds count matches at once, as when restoring saved counts
+  void add_to_bucket(size_t bucket, uint64_t count) {
+    m_buckets[std::min(bucket, m_num_buckets - 1)].fetch_add(count, std::memory_order_relaxed);
+  }
+
+  size_t get_num_buckets() const { return m_num_buckets; }
+
+  std::streamoff get_bucket_size() const { return m_bucket_size; }
+
+  size_t get_bucket(std::streampos pos) const {
+    auto bucket = static_cast<size_t>(std::max<std::streamoff>(pos, 0) / m_bucket_size);
+    return std::min(bucket, m_num_buckets - 1);
+  }
+
+  uint64_t get_count(size_t bucket) const {
+    return m_buckets[bucket].load(std::memory_order_relaxed);
+  }
+
+  // Widens the buckets, merging neighbours, until they cover a file grown to file_end. Matches
+  // must not be added meanwhile.
+  void extend(std::streampos file_end);
+
+  // Counts merged into num_rows rows covering the whole file, for rendering
+  std::vector<uint64_t> get_rows(size_t num_rows) const;
+
+private:
+  size_t m_num_buckets;
+  std::streamoff m_bucket_size;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef LFV_MATCH_STORE
+
+#define LFV_MATCH_STORE
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Append-only list of match positions, each with the index of the pattern that matched.
+//
+// Matches are packed into blocks of BLOCK_MATCHES as varint deltas from the previous position,
+// which takes one or two bytes per match for dense matches. Once the sealed blocks take more than
+// the memory budget, further blocks are written to an anonymous temporary file instead. Reading a
+// match decodes its block, and the last decoded block is kept so that stepping through
+// neighbouring matches is cheap.
+//
+// One thread may add while any number of threads read, and the writer never waits for readers.
+// Sealed blocks are immutable and listed in a directory of fixed-size segments that never move.
+// The block being filled is kept raw, and a read from it is retried on the sealed block if the
+// writer moved on meanwhile. The size is published with release ordering, so readers always see a
+// consistent prefix of the matches.
+class MatchStore {
+public:
+  static constexpr size_t BLOCK_MATCHES = 4096;
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = 64 << 20;
+
+  MatchStore(size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+
+  ~MatchStore();
+
+  MatchStore(const MatchStore&) = delete;
+  MatchStore& operator=(const MatchStore&) = delete;
+
+  // Only from the writer thread
+  void add(std::streamoff pos, int32_t pattern);
+
+  int64_t size() const { return m_size.load(std::memory_order_acquire); }
+
+  // Position and pattern of the match at index, which must be below size()
+  std::pair<std::streamoff, int32_t> get(int64_t index) const;
+
+  // Index of the first match at or after pos, or size() if there is none, for matches added in
+  // ascending order. Blocks are told apart by their first position, so only one is decoded.
+  int64_t lower_bound(std::streamoff pos) const;
+
+  // Encoded bytes of sealed blocks held in memory
+  size_t get_memory_bytes() const { return m_memory_bytes.load(std::memory_order_relaxed); }
+
+  size_t get_spilled_bytes() const { return m_spilled_bytes.load(std::memory_order_relaxed); }
+
+private:
+  struct Block {
+    // Encoded matches, empty if spilled
+    std::vector<uint8_t> data;
+    // Where the block is in the spill file, or -1 if it is in memory
+    int64_t spill_offset = -1;
+    size_t spill_size = 0;
+  };
+
+  struct RawMatch {
+    std::atomic<int64_t> pos;
+    std::atomic<int32_t> pattern;
+  };
+
+  static constexpr size_t SEGMENT_BLOCKS = 4096;
+  static constexpr size_t MAX_SEGMENTS = 4096;
+
+  using Segment = std::array<std::unique_ptr<const Block>, SEGMENT_BLOCKS>;
+
+  size_t m_memory_budget;
+
+  // Written by the writer, then published through m_num_blocks
+  std::array<std::unique_ptr<Segment>, MAX_SEGMENTS> m_directory;
+  std::atomic<size_t> m_num_blocks = 0;
+  std::atomic<int64_t> m_size = 0;
+
+  // The block being filled. Entries are atomics, as readers may race with their reuse.
+  std::unique_ptr<RawMatch[]> m_open;
+
+  std::atomic<size_t> m_memory_bytes = 0;
+  std::atomic<size_t> m_spilled_bytes = 0;
+  // Anonymous file, only touched with positioned reads and writes
+  std::FILE* m_spill_file = nullptr;
+  bool m_spill_failed = false;
+
+  // The last decoded block, shared by readers
+  mutable std::mutex m_decode_mutex;
+  mutable int64_t m_decoded_block = -1;
+  mutable std::vector<std::pair<std::streamoff, int32_t>> m_decoded;
+
+  void seal();
+
+  // Writes the block to the spill file, or returns false
+  bool spill(Block& block);
+
+  const Block& get_block(size_t block_index) const {
+    return *(*m_directory[block_index / SEGMENT_BLOCKS])[block_index % SEGMENT_BLOCKS];
+  }
+
+  void decode(size_t block_index) const;
+
+  // Position of the first match of a sealed block
+  std::streamoff get_block_begin(size_t block_index) const;
+};
+
+#endif
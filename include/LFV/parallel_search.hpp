@@ -0,0 +1,33 @@
+#ifndef LFV_PARALLEL_SEARCH
+
+#define LFV_PARALLEL_SEARCH
+
+#include <LFV/file_source.hpp>
+#include <LFV/search_result.hpp>
+#include <LFV/task_pool.hpp>
+#include <atomic>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <string>
+
+constexpr std::streamoff DEFAULT_SEARCH_CHUNK_SIZE = 4 << 20;
+
+// Searches [begin, end) of a file on num_workers threads. The range is cut into chunks that
+// overlap by the pattern length minus one, so a match across a chunk border is found exactly
+// once, by the chunk it starts in. Matches are published to result in ascending order, and the
+// reported progress only covers chunks whose matches have all been published. A gzip file, given
+// by its index in the source options, is cut at its checkpoints rather than every chunk_size bytes.
+//
+// The calling thread scans chunks, helped by up to num_workers - 1 tasks on the task pool, or on
+// a pool made for the search if none is given. A chunk with many matches publishes them as it
+// goes once the chunks before it are published, and a count-only result only buffers counts.
+void search_in_file_parallel(const std::string& fpath, const std::string& pattern,
+                             std::streampos begin, std::streampos end, int64_t match_limit,
+                             std::shared_ptr<SearchResult> result,
+                             std::shared_ptr<std::atomic<bool>> aborted, unsigned num_workers,
+                             std::streamoff chunk_size = DEFAULT_SEARCH_CHUNK_SIZE,
+                             const FileSourceOptions& source_options = {},
+                             std::shared_ptr<TaskPool> task_pool = nullptr);
+
+#endif
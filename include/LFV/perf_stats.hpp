@@ -0,0 +1,108 @@
+#ifndef LFV_PERF_STATS
+
+#define LFV_PERF_STATS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Distribution of durations, in buckets a quarter of a power of two wide, so that percentiles are
+// within a quarter of the true value. Recording is a few relaxed atomic increments, and any
+// thread may record while others read.
+class LatencyHistogram {
+public:
+  static constexpr int SUB_BUCKET_BITS = 2;
+  static constexpr size_t NUM_BUCKETS = 64 << SUB_BUCKET_BITS;
+
+  void record(std::chrono::steady_clock::duration duration);
+
+  uint64_t get_count() const { return m_count.load(std::memory_order_relaxed); }
+
+  std::chrono::nanoseconds get_total() const {
+    return std::chrono::nanoseconds(m_total_ns.load(std::memory_order_relaxed));
+  }
+
+  // Duration that the given fraction of the recorded ones do not exceed, or 0 if none are
+  std::chrono::nanoseconds get_percentile(double fraction) const;
+
+  // Whether to time the next of the scopes sampled into this histogram, one in period of them
+  bool take_sample(uint32_t period) {
+    return m_num_sampled.fetch_add(1, std::memory_order_relaxed) % period == 0;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> m_buckets{};
+  std::atomic<uint64_t> m_count = 0;
+  std::atomic<uint64_t> m_total_ns = 0;
+  std::atomic<uint32_t> m_num_sampled = 0;
+};
+
+// Records the time until it goes out of scope
+class ScopedTimer {
+public:
+  explicit ScopedTimer(LatencyHistogram& histogram)
+      : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  ~ScopedTimer() { m_histogram.record(std::chrono::steady_clock::now() - m_start); }
+
+private:
+  LatencyHistogram& m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+// Times one in SAMPLE_PERIOD of the scopes recording into a histogram, for scopes so short and
+// frequent that reading the clock twice each time would slow them down
+class SampledTimer {
+public:
+  static constexpr uint32_t SAMPLE_PERIOD = 8;
+
+  explicit SampledTimer(LatencyHistogram& histogram) {
+    if (histogram.take_sample(SAMPLE_PERIOD)) {
+      m_histogram = &histogram;
+      m_start = std::chrono::steady_clock::now();
+    }
+  }
+  SampledTimer(const SampledTimer&) = delete;
+  SampledTimer& operator=(const SampledTimer&) = delete;
+
+  ~SampledTimer() {
+    if (m_histogram != nullptr) {
+      m_histogram->record(std::chrono::steady_clock::now() - m_start);
+    }
+  }
+
+private:
+  LatencyHistogram* m_histogram = nullptr;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+// Counters and latencies of the hot paths, for the whole process. Shown by /stats.
+struct PerfStats {
+  // Lines, or segments of gigantic lines, read by the edit window rather than the prefetcher.
+  // Sampled.
+  LatencyHistogram line_reads;
+  // Pages read from disk or decompressed on page cache misses. A mapped file is read by the
+  // kernel on page faults instead, which only shows in the resident size.
+  LatencyHistogram page_reads;
+  std::atomic<uint64_t> page_read_bytes = 0;
+  // Wrapping a line into rows. Sampled.
+  LatencyHistogram split_line;
+  // Building the edit window for a frame
+  LatencyHistogram render;
+  // From the start of a search to its first match
+  LatencyHistogram first_match;
+  // Bytes searched and time taken by searches that ended
+  std::atomic<uint64_t> num_searches = 0;
+  std::atomic<uint64_t> searched_bytes = 0;
+  std::atomic<uint64_t> search_ns = 0;
+};
+
+PerfStats& get_perf_stats();
+
+// Resident set size of the process, or 0 where it is not known
+uint64_t get_resident_bytes();
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef LFV_REGEX
+
+#define LFV_REGEX
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Thompson NFA compiled from a regular expression
+struct Nfa {
+  enum class NodeType : uint8_t {
+    // Consumes one byte from bytes
+    BYTES,
+    // Epsilon edges to next and alt
+    SPLIT,
+    // Passes if the byte consumed before is a newline, or nothing has been consumed yet
+    AFTER_NEWLINE,
+    // Passes if the byte consumed next is a newline, or there is nothing left
+    BEFORE_NEWLINE,
+    MATCH,
+  };
+
+  struct Node {
+    NodeType type;
+    int32_t next = -1;
+    int32_t alt = -1;
+    std::bitset<256> bytes;
+  };
+
+  std::vector<Node> nodes;
+  int32_t start = -1;
+};
+
+// DFA built from an NFA on demand. States are only created when the input reaches them, and at
+// most max_states are kept: when the cache is full it is flushed and refilled from the current
+// state. Memory therefore stays bounded whatever the pattern and input.
+//
+// An unanchored DFA finds leftmost-longest matches. Its states keep the NFA nodes in groups by
+// where their match started, earliest first. Once a group matches, the groups that started after
+// it are dropped and no new match starts, so the DFA dies where the longest match from the
+// leftmost start can grow no further. It reports each end that match grows through.
+//
+// A state id is only valid until the next call to next(). Ids are premultiplied offsets into the
+// transition table, so that a transition is a single dependent load.
+class LazyDfa {
+public:
+  static constexpr int32_t DEAD = -1;
+
+  // An unanchored DFA looks for matches starting anywhere; an anchored one only at the start
+  LazyDfa(std::shared_ptr<const Nfa> nfa, bool unanchored, size_t max_states);
+
+  int32_t get_start(bool after_newline) {
+    int32_t& start = m_start_states[after_newline ? 1 : 0];
+    if (start == UNKNOWN) {
+      start = compute_start(after_newline);
+    }
+
+    return start;
+  }
+
+  int32_t next(int32_t state, unsigned char byte) {
+    int32_t next_state = m_table[static_cast<size_t>(state) + m_byte_classes[byte]];
+    if (next_state != UNKNOWN) {
+      return next_state;
+    }
+
+    return compute_next(state, byte);
+  }
+
+  // Whether some state flag is set, so that the hot loop only looks further for these states
+  bool is_special(int32_t state) const {
+    return m_flags[static_cast<size_t>(state)] != 0;
+  }
+
+  // Whether a match ends right before the next byte
+  bool is_match(int32_t state) const { return (m_flags[static_cast<size_t>(state)] & MATCH) != 0; }
+
+  // Whether a match ends right before the next byte if that byte is a newline or the input ends
+  bool is_match_before_newline(int32_t state) const {
+    return (m_flags[static_cast<size_t>(state)] & MATCH_BEFORE_NEWLINE) != 0;
+  }
+
+  // Whether the state is a start state, which means no partial match is in progress
+  bool is_start(int32_t state) const { return (m_flags[static_cast<size_t>(state)] & START) != 0; }
+
+  size_t get_num_states() const { return m_states.size(); }
+
+  size_t get_num_flushes() const { return m_num_flushes; }
+
+private:
+  static constexpr int32_t UNKNOWN = -2;
+
+  static constexpr uint8_t MATCH = 1;
+  static constexpr uint8_t MATCH_BEFORE_NEWLINE = 2;
+  static constexpr uint8_t START = 4;
+
+  // Separates the groups of nodes in a state
+  static constexpr int32_t MARK = -1;
+
+  // The NFA nodes a DFA state stands for, whether the previous byte was a newline, and whether a
+  // match was seen, after which no new match starts
+  struct StateKey {
+    std::vector<int32_t> nodes;
+    bool after_newline = false;
+    bool matched = false;
+
+    bool operator<(const StateKey& other) const {
+      return std::tie(nodes, after_newline, matched)
+             < std::tie(other.nodes, other.after_newline, other.matched);
+    }
+  };
+
+  std::shared_ptr<const Nfa> m_nfa;
+  bool m_unanchored;
+  size_t m_max_states;
+
+  std::array<uint8_t, 256> m_byte_classes{};
+  size_t m_num_classes = 0;
+
+  std::vector<StateKey> m_states;
+  std::map<StateKey, int32_t> m_state_ids;
+  std::vector<int32_t> m_table;
+  // Indexed by state id like the table, so only the first entry of each row is used
+  std::vector<uint8_t> m_flags;
+  size_t m_num_flushes = 0;
+  std::array<int32_t, 2> m_start_states{UNKNOWN, UNKNOWN};
+
+  int32_t compute_start(bool after_newline);
+
+  int32_t compute_next(int32_t state, unsigned char byte);
+
+  int32_t intern(StateKey key, bool is_start);
+
+  void flush();
+
+  // Follows epsilon edges from the nodes. BEFORE_NEWLINE nodes are kept unresolved unless
+  // before_newline is set.
+  std::vector<int32_t> closure(const std::vector<int32_t>& nodes, bool after_newline,
+                               bool before_newline) const;
+};
+
+// A regular expression compiled for streaming search.
+//
+// Supported syntax: literals, ".", classes such as "[a-z_]" and "[^0-9]", the escapes \d \w \s
+// (and their negations), \n \t \r \xHH, groups "(...)" and "(?:...)", alternation "|",
+// the quantifiers * + ? {n} {n,} {n,m}, and the line anchors ^ and $. "." does not match newlines.
+//
+// Throws LFVException on invalid syntax, and for patterns that match the empty string.
+class Regex {
+public:
+  static constexpr size_t DEFAULT_MAX_DFA_STATES = 4096;
+
+  Regex(const std::string& pattern);
+
+  const std::string& get_pattern() const { return m_pattern; }
+
+  // Every match starts with this, possibly empty, literal
+  const std::string& get_literal_prefix() const { return m_literal_prefix; }
+
+  // Every match starts with one of these bytes
+  const std::bitset<256>& get_first_bytes() const { return m_first_bytes; }
+
+  // Finds where matches end, scanning forward
+  LazyDfa make_forward_dfa(size_t max_states = DEFAULT_MAX_DFA_STATES) const {
+    return LazyDfa(m_forward, true, max_states);
+  }
+
+  // Matches the reversed expression, for scanning backward from where a match ends
+  LazyDfa make_reverse_dfa(size_t max_states = DEFAULT_MAX_DFA_STATES) const {
+    return LazyDfa(m_reverse, false, max_states);
+  }
+
+private:
+  std::string m_pattern;
+  std::string m_literal_prefix;
+  std::bitset<256> m_first_bytes;
+  std::shared_ptr<const Nfa> m_forward;
+  std::shared_ptr<const Nfa> m_reverse;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef LFV_RING_BUFFER
+
+#define LFV_RING_BUFFER
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Double-ended queue over one circular array. Pushing and popping at either end is O(1) and
+// reuses the slots, so a buffer that has reached its working size no longer allocates. The
+// capacity doubles when full, which moves the elements.
+template <typename T> class RingBuffer {
+public:
+  class ConstIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+
+    ConstIterator(const RingBuffer* buffer, size_t index) : m_buffer(buffer), m_index(index) {}
+
+    const T& operator*() const { return (*m_buffer)[m_index]; }
+
+    const T* operator->() const { return &(*m_buffer)[m_index]; }
+
+    ConstIterator& operator++() {
+      m_index++;
+      return *this;
+    }
+
+    bool operator==(const ConstIterator& other) const { return m_index == other.m_index; }
+
+    bool operator!=(const ConstIterator& other) const { return m_index != other.m_index; }
+
+  private:
+    const RingBuffer* m_buffer;
+    size_t m_index;
+  };
+
+  // Elements first to last of a buffer, valid until the buffer is next changed
+  class Range {
+  public:
+    Range(ConstIterator first, ConstIterator last, size_t size)
+        : m_first(first), m_last(last), m_size(size) {}
+
+    ConstIterator begin() const { return m_first; }
+
+    ConstIterator end() const { return m_last; }
+
+    size_t size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+  private:
+    ConstIterator m_first;
+    ConstIterator m_last;
+    size_t m_size;
+  };
+
+  size_t size() const { return m_size; }
+
+  bool empty() const { return m_size == 0; }
+
+  T& operator[](size_t index) { return m_slots[slot(index)]; }
+
+  const T& operator[](size_t index) const { return m_slots[slot(index)]; }
+
+  T& front() { return (*this)[0]; }
+
+  T& back() { return (*this)[m_size - 1]; }
+
+  void push_back(T item) {
+    reserve_one();
+    m_slots[slot(m_size)] = std::move(item);
+    m_size++;
+  }
+
+  void push_front(T item) {
+    reserve_one();
+    m_head = (m_head + m_slots.size() - 1) & (m_slots.size() - 1);
+    m_slots[m_head] = std::move(item);
+    m_size++;
+  }
+
+  // The buffer must not be empty
+  T pop_front() {
+    T item = std::move(front());
+    m_head = (m_head + 1) & (m_slots.size() - 1);
+    m_size--;
+    return item;
+  }
+
+  T pop_back() {
+    T item = std::move(back());
+    m_size--;
+    return item;
+  }
+
+  void clear() {
+    while (!empty()) {
+      pop_back();
+    }
+    m_head = 0;
+  }
+
+  ConstIterator begin() const { return {this, 0}; }
+
+  ConstIterator end() const { return {this, m_size}; }
+
+  Range range(size_t first, size_t last) const {
+    return {{this, first}, {this, last}, last - first};
+  }
+
+private:
+  // The size is kept a power of two so that wrapping is a mask
+  std::vector<T> m_slots;
+  size_t m_head = 0;
+  size_t m_size = 0;
+
+  size_t slot(size_t index) const { return (m_head + index) & (m_slots.size() - 1); }
+
+  void reserve_one() {
+    if (m_size < m_slots.size()) {
+      return;
+    }
+
+    std::vector<T> slots(m_slots.empty() ? 16 : m_slots.size() * 2);
+    for (size_t i = 0; i < m_size; i++) {
+      slots[i] = std::move((*this)[i]);
+    }
+
+    m_slots = std::move(slots);
+    m_head = 0;
+  }
+};
+
+#endif
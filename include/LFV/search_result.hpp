@@ -2,35 +2,117 @@
 
 #define LFV_SEARCH_RESULT
 
+#include <LFV/change_notifier.hpp>
+#include <LFV/match_histogram.hpp>
+#include <LFV/match_store.hpp>
 #include <atomic>
-#include <mutex>
-#include <vector>
+#include <cstdint>
+#include <ios>
+#include <memory>
 
 enum class BackgroundTaskStatus { NOT_STARTED = 0, ONGOING = 1, FINISHED = 2, ABORTED = 3 };
 
+// Matches of a search. One thread adds matches and updates progress while others read: adding
+// never blocks, and readers see a consistent prefix of the matches.
 class SearchResult {
 public:
-  SearchResult();
+  // Matches are also counted into the histogram, if given. Count-only results keep no positions,
+  // so that their memory stays constant however many matches there are.
+  SearchResult(std::shared_ptr<MatchHistogram> histogram = nullptr, bool count_only = false);
 
-  int get_num_matches() const;
+  // Number of stored matches
+  int64_t get_num_matches() const;
 
-  std::streampos get_match(int index) const;
+  // Number of matches found, stored or not
+  int64_t get_num_found() const { return m_num_found.load(std::memory_order_relaxed); }
+
+  bool is_count_only() const { return m_count_only; }
+
+  std::shared_ptr<const MatchHistogram> get_histogram() const { return m_histogram; }
+
+  std::streampos get_match(int64_t index) const;
+
+  // Position of the last match added with add_match, stored or not, or -1 if there is none
+  std::streamoff get_last_match() const { return m_last_match.load(std::memory_order_relaxed); }
+
+  // Index of the first stored match at or after pos, or get_num_matches() if there is none.
+  // Searches store their matches in ascending order.
+  int64_t find_match(std::streampos pos) const { return m_matches.lower_bound(pos); }
 
   void add_match(std::streampos pos);
 
-  void set_current_pos(std::streampos pos) { m_current_pos = pos; }
+  // For searches with several patterns, also records which pattern matched
+  void add_match(std::streampos pos, int32_t pattern);
+
+  // Counts count matches from pos on, all in the histogram bucket holding pos, without storing
+  // them. For count-only results, which need no positions.
+  void add_match_count(std::streampos pos, int64_t count);
+
+  // Counts matches without positions or histogram, as when restoring a count-only result whose
+  // histogram is restored on its own
+  void add_num_found(int64_t count) { m_num_found.fetch_add(count, std::memory_order_relaxed); }
+
+  // As when restoring a count-only result, which has no positions to find it from
+  void set_last_match(std::streampos pos) { m_last_match.store(pos, std::memory_order_relaxed); }
+
+  // Index of the pattern behind a match, or 0 for single pattern searches
+  int32_t get_match_pattern(int64_t index) const;
 
-  int64_t get_current_pos() { return m_current_pos; }
+  void set_current_pos(std::streampos pos) {
+    m_current_pos = pos;
+    notify();
+  }
 
-  inline BackgroundTaskStatus get_status() { return m_status.load(); }
+  int64_t get_current_pos() const { return m_current_pos; }
 
-  inline void set_status(BackgroundTaskStatus status) { m_status = status; }
+  // Lets the histogram cover a file grown to file_end, before a search carries on over it
+  void extend_histogram(std::streampos file_end) {
+    if (m_histogram != nullptr) {
+      m_histogram->extend(file_end);
+    }
+  }
+
+  inline BackgroundTaskStatus get_status() const { return m_status.load(); }
+
+  inline void set_status(BackgroundTaskStatus status) {
+    m_status = status;
+    if (status == BackgroundTaskStatus::FINISHED || status == BackgroundTaskStatus::ABORTED) {
+      stop_timing();
+    }
+    notify();
+  }
+
+  // Marks the search as ongoing from begin. It is timed from there for the stats: to its first
+  // match, and to its end for the bytes searched per second.
+  void start(std::streampos begin);
+
+  // Told about progress and status changes. Set before the search starts.
+  void set_notifier(std::shared_ptr<ChangeNotifier> notifier) { m_notifier = std::move(notifier); }
 
 private:
   std::atomic<BackgroundTaskStatus> m_status;
   std::atomic<int64_t> m_current_pos = 0;
-  mutable std::mutex m_mutex;
-  std::vector<std::streampos> m_matches;
+  std::shared_ptr<MatchHistogram> m_histogram;
+  bool m_count_only;
+  std::atomic<int64_t> m_num_found = 0;
+  std::atomic<int64_t> m_last_match = -1;
+  MatchStore m_matches;
+  std::shared_ptr<ChangeNotifier> m_notifier;
+
+  // Steady clock time the search started at in ns, or -1 when it is not running
+  std::atomic<int64_t> m_start_ns = -1;
+  std::streamoff m_start_pos = 0;
+
+  void notify() {
+    if (m_notifier != nullptr) {
+      m_notifier->notify();
+    }
+  }
+
+  // Counts the matches, and returns whether they should be stored
+  bool count_match(std::streampos pos, int64_t count = 1);
+
+  void stop_timing();
 };
 
 #endif
\ No newline at end of file
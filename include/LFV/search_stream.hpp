@@ -1,113 +1,58 @@
-#include <LFV/lfv_exception.hpp>
+#ifndef LFV_SEARCH_STREAM
+
+#define LFV_SEARCH_STREAM
+
+#include <LFV/file_source.hpp>
+#include <LFV/regex.hpp>
 #include <LFV/search_result.hpp>
-#include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <string>
-
-// BMH algorithm
-
-// NOLINTBEGIN
-void search_in_stream(std::ifstream&& in, const std::string& pattern_str, std::streampos begin,
-                      std::streampos end, int32_t match_limit, std::shared_ptr<SearchResult> result,
-                      std::shared_ptr<std::atomic<bool>> aborted) {
-  constexpr int MAX_ALPHABET = 1 << 8;
-  constexpr int MAX_PAT_LEN = 1 << 8;
-
-  const size_t pat_len = pattern_str.size();
-
-  if (pat_len > MAX_PAT_LEN) {
-    throw LFVException("Pattern length exceeded max pattern length");
-  }
-
-  // Copy to array on stack to speed up
-  std::array<int, MAX_PAT_LEN> pattern = {};
-  for (size_t i = 0; i < pat_len; i++) {
-    pattern[i] = static_cast<unsigned char>(pattern_str[i]);
-  }
-
-  // Calculate BMH table
-  std::array<int, MAX_ALPHABET> table = {};
-  for (size_t i = 0; i < MAX_ALPHABET; i++) {
-    table[i] = static_cast<int>(pat_len);
-  }
-
-  for (size_t i = 0; i + 2 <= pat_len; i++) {
-    int ascii = pattern[i];
-
-    table[ascii] = static_cast<int>(pat_len - 1 - i);
-  }
-
-  // Consistent state: buffer always contain file content from in.tellg - patlen to in.tellg - 1
-  // buffer_index always points to the starting point
-  in.seekg(begin);
-
-  std::array<int, MAX_PAT_LEN> buffer = {};
-  size_t buffer_index = 0;
-
-  for (size_t k = 0; k < pat_len; k++) {
-    buffer[k] = in.get();
-  }
-
-  constexpr int32_t HEAVY_CYCLE = 1000;
-  // Run string matching until
-  // - match limit exceeded OR
-  // - reaches EOF
-  int count_match = 0;
-  int update_countdown = HEAVY_CYCLE;
-
-  result->set_status(BackgroundTaskStatus::ONGOING);
-
-  while (in.tellg() < end && count_match < match_limit) {
-    // We update progress and check exit condition
-    // every cycle/whenever a match is found to avoid overhead.
-    update_countdown--;
-    if (update_countdown == 0) {
-      result->set_current_pos(in.tellg());
-      update_countdown = HEAVY_CYCLE;
-      if (*aborted) {
-        result->set_status(BackgroundTaskStatus::ABORTED);
-
-        // Exit as we have handled all cleaning up.
-        return;
-      }
-    }
-
-    bool same = true;
-    for (size_t j = 0, k = buffer_index; same && j < pat_len; j++, k++) {
-      if (k >= pat_len) {
-        k -= pat_len;
-      }
-
-      same &= pattern[j] == buffer[k];
-    }
-
-    int forward_steps = 1;
-
-    if (same) {
-      result->add_match(in.tellg() - (std::streampos)pat_len);
-      count_match++;
-
-      forward_steps = std::min(1, (int)(end - in.tellg()));
-    } else {
-      int last_char = buffer_index == 0 ? buffer[pat_len - 1] : buffer[buffer_index - 1];
-      forward_steps = std::min(table[last_char], (int)(end - in.tellg()));
-    }
-
-    if (forward_steps == 0) {
-      break;
-    }
-
-    // Read some amount forward
-    for (int k = 0; k < forward_steps; k++) {
-      buffer[buffer_index] = in.get();
-      buffer_index++;
-      if (buffer_index == pat_len) {
-        buffer_index = 0;
-      }
-    }
-  }
-
-  result->set_status(BackgroundTaskStatus::FINISHED);
-}
-// NOLINTEND
+#include <vector>
+
+// Searches [begin, end) of the stream block by block with the SIMD substring kernel
+void search_in_stream(std::ifstream&& in, const std::string& pattern, std::streampos begin,
+                      std::streampos end, int64_t match_limit, std::shared_ptr<SearchResult> result,
+                      std::shared_ptr<std::atomic<bool>> aborted);
+
+// Searches [begin, end) for all patterns at once with an Aho-Corasick automaton. Each match records
+// the index of its pattern, and matches are published in ascending order of position.
+// Matches ending at or before min_match_end are skipped, so that a search resumed a little before
+// where an earlier one ended only reports the matches that one could not see.
+void search_any_in_stream(std::ifstream&& in, const std::vector<std::string>& patterns,
+                          std::streampos begin, std::streampos end, int64_t match_limit,
+                          std::shared_ptr<SearchResult> result,
+                          std::shared_ptr<std::atomic<bool>> aborted,
+                          std::streamoff min_match_end = 0);
+
+// The same, reading through a FileExtractor opened with the source options, such as a gzip file
+// through its index
+void search_any_in_file(const std::string& fpath, const FileSourceOptions& source_options,
+                        const std::vector<std::string>& patterns, std::streampos begin,
+                        std::streampos end, int64_t match_limit,
+                        std::shared_ptr<SearchResult> result,
+                        std::shared_ptr<std::atomic<bool>> aborted,
+                        std::streamoff min_match_end = 0);
+
+// Searches [begin, end) of the file for leftmost-longest matches of the regex in constant memory.
+// A forward lazy DFA runs until the longest match from the leftmost start ends, and a reverse one
+// scanning back from there finds that start; matches do not overlap. While no match is in
+// progress, only the literal prefix of the regex is looked for, with the SIMD substring kernel.
+// Matches beginning before min_match_begin were found by an earlier range.
+void search_regex_in_file(const std::string& fpath, const Regex& regex, std::streampos begin,
+                          std::streampos end, int64_t match_limit,
+                          std::shared_ptr<SearchResult> result,
+                          std::shared_ptr<std::atomic<bool>> aborted,
+                          const FileSourceOptions& source_options = {},
+                          std::streampos min_match_begin = 0);
+
+// The original byte-at-a-time BMH search, kept as a reference implementation. Patterns are
+// limited to 256 bytes.
+void search_in_stream_bmh(std::ifstream&& in, const std::string& pattern_str,
+                          std::streampos begin, std::streampos end, int64_t match_limit,
+                          std::shared_ptr<SearchResult> result,
+                          std::shared_ptr<std::atomic<bool>> aborted);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef LFV_SIMD
+
+#define LFV_SIMD
+
+// x86 vector kernels are built where the compiler can target AVX2 per function, and picked at
+// runtime with __builtin_cpu_supports. SSE2 is part of x86-64.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  include <immintrin.h>
+#  define LFV_HAS_X86_SIMD 1
+#  define LFV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef LFV_SUBSTRING_SEARCH
+
+#define LFV_SUBSTRING_SEARCH
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Substring search over in-memory blocks. Like the byte scan kernels, every kernel finds the same
+// matches and they only differ in the instruction set used.
+struct SubstringKernel {
+  const char* name;
+
+  // Returns the first occurrence of the pattern that lies entirely in [first, last), or nullptr.
+  // The pattern is at least 2 bytes long.
+  const char* (*find)(const char* first, const char* last, const char* pattern, size_t pat_len);
+};
+
+// Kernels supported by the running CPU, from the slowest to the fastest
+const std::vector<SubstringKernel>& available_substring_kernels();
+
+// The fastest supported kernel, picked once at runtime
+const SubstringKernel& substring_kernel();
+
+// Finds a fixed pattern. The SIMD kernels compare the first and last pattern bytes at 16 or 32
+// positions at once and only verify the whole pattern where both agree, so most of the input is
+// skipped at vector speed whatever the pattern length.
+class SubstringSearcher {
+public:
+  SubstringSearcher(std::string pattern, const SubstringKernel& kernel = substring_kernel());
+
+  const std::string& get_pattern() const { return m_pattern; }
+
+  // Returns the first occurrence of the pattern that lies entirely in [first, last), or nullptr
+  const char* find(const char* first, const char* last) const;
+
+  // Calls on_match with the offset of every occurrence in data, overlapping ones included, in
+  // ascending order. Stops early if on_match returns false.
+  template <typename OnMatch> void find_all(std::string_view data, OnMatch&& on_match) const {
+    const char* first = data.data();
+    const char* last = data.data() + data.size();
+
+    for (const char* found = find(first, last); found != nullptr; found = find(found + 1, last)) {
+      if (!on_match(static_cast<size_t>(found - first))) {
+        return;
+      }
+    }
+  }
+
+private:
+  std::string m_pattern;
+  const SubstringKernel* m_kernel;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef LFV_TASK_POOL
+
+#define LFV_TASK_POOL
+
+#include <LFV/change_notifier.hpp>
+#include <LFV/search_result.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Set to ask a task to stop. Tasks poll it, so cancellation takes effect at their next check.
+using CancellationToken = std::shared_ptr<std::atomic<bool>>;
+
+enum class TaskPriority { LOW = 0, NORMAL = 1, HIGH = 2 };
+
+// Shared view of a submitted task. A default handle refers to none: it stays NOT_STARTED without
+// error, cancelling it does nothing and waiting for it returns at once.
+class TaskHandle {
+public:
+  TaskHandle() = default;
+
+  bool is_valid() const { return m_state != nullptr; }
+
+  // NOT_STARTED while queued, ABORTED if it was cancelled or threw
+  BackgroundTaskStatus get_status() const {
+    return m_state != nullptr ? m_state->status.load() : BackgroundTaskStatus::NOT_STARTED;
+  }
+
+  bool is_done() const {
+    BackgroundTaskStatus status = get_status();
+    return status == BackgroundTaskStatus::FINISHED || status == BackgroundTaskStatus::ABORTED;
+  }
+
+  // A queued task is dropped; a running one sees its token set
+  void cancel() const {
+    if (m_state != nullptr) {
+      *m_state->token = true;
+    }
+  }
+
+  // Already set for a default handle
+  const CancellationToken& get_token() const;
+
+  // Blocks until the task has run or been dropped
+  void wait() const;
+
+  // What the task threw, if it did
+  std::string get_error() const;
+
+private:
+  friend class TaskPool;
+
+  struct State {
+    std::atomic<BackgroundTaskStatus> status = BackgroundTaskStatus::NOT_STARTED;
+    CancellationToken token = std::make_shared<std::atomic<bool>>(false);
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::string error;
+  };
+
+  std::shared_ptr<State> m_state;
+
+  explicit TaskHandle(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+  void finish(BackgroundTaskStatus status, std::string error = "") const;
+};
+
+// Status of a search result filled by task. The handle is a default one for a result restored
+// rather than searched. A task dropped from the queue never updates its result.
+inline BackgroundTaskStatus get_search_status(const SearchResult& result, const TaskHandle& task) {
+  if (task.is_valid() && task.get_status() == BackgroundTaskStatus::ABORTED) {
+    return BackgroundTaskStatus::ABORTED;
+  }
+
+  return result.get_status();
+}
+
+// Fixed set of worker threads running tasks from a bounded priority queue. Tasks of the same
+// priority run in submission order. Destroying the pool cancels every task, then waits for the
+// running ones to notice and for the workers to exit.
+class TaskPool {
+public:
+  using Task = std::function<void(const CancellationToken& token)>;
+
+  static constexpr size_t DEFAULT_QUEUE_CAPACITY = 256;
+
+  // One worker per core by default
+  TaskPool(size_t num_threads = 0, size_t queue_capacity = DEFAULT_QUEUE_CAPACITY);
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  ~TaskPool();
+
+  // Throws LFVException if the queue is full or the pool is shut down
+  TaskHandle submit(Task task, TaskPriority priority = TaskPriority::NORMAL);
+
+  // Told whenever a task finishes or is dropped. Set before submitting.
+  void set_notifier(std::shared_ptr<ChangeNotifier> notifier) { m_notifier = std::move(notifier); }
+
+  size_t get_num_threads() const { return m_workers.size(); }
+
+  size_t get_num_queued() const;
+
+  // Cancels everything and joins the workers. Called by the destructor.
+  void shutdown();
+
+private:
+  struct QueuedTask {
+    TaskPriority priority = TaskPriority::NORMAL;
+    uint64_t sequence = 0;
+    Task task;
+    TaskHandle handle;
+
+    // Highest priority first, then the earliest submitted
+    bool operator<(const QueuedTask& other) const {
+      if (priority != other.priority) {
+        return priority < other.priority;
+      }
+      return sequence > other.sequence;
+    }
+  };
+
+  size_t m_queue_capacity;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::priority_queue<QueuedTask> m_queue;
+  uint64_t m_next_sequence = 0;
+  bool m_stopping = false;
+  // Tasks being run, so that shutdown can cancel them
+  std::vector<TaskHandle> m_running;
+
+  std::vector<std::thread> m_workers;
+
+  std::shared_ptr<ChangeNotifier> m_notifier;
+
+  // Marks the task done and tells the notifier
+  void finish(const TaskHandle& handle, BackgroundTaskStatus status, std::string error = "");
+
+  void work();
+};
+
+#endif
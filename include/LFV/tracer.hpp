@@ -0,0 +1,107 @@
+#ifndef LFV_TRACER
+
+#define LFV_TRACER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Spans of work on each thread, written out as Chrome trace events to be seen side by side in
+// chrome://tracing or Perfetto.
+//
+// Tracing is off until started, and spans meanwhile cost a relaxed load. Once started, each
+// thread records into its own ring buffer, so that recording takes no lock: only the most recent
+// EVENTS_PER_THREAD spans of a thread are kept. When a thread exits, its buffer goes to the next
+// new thread, whose spans then follow on the same row of the trace. There are thus only as many
+// buffers as threads running at once, however many threads come and go.
+class Tracer {
+public:
+  static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+  Tracer();
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  // Spans are timed from here on
+  void start();
+
+  bool is_enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  // Names the calling thread in the trace. Can be called before tracing starts.
+  void set_thread_name(const std::string& name);
+
+  // Name must outlive the tracer, as string literals do
+  void record(const char* name, std::chrono::steady_clock::time_point begin,
+              std::chrono::steady_clock::time_point end);
+
+  // Writes the spans recorded so far in the Chrome trace event format. Call once the traced
+  // threads have stopped, or spans they record meanwhile may be torn. Throws LFVException if the
+  // file cannot be written.
+  void write(const std::string& fpath) const;
+
+  // Buffers allocated so far
+  size_t get_num_buffers() const;
+
+private:
+  struct Event {
+    const char* name;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+  };
+
+  // Written by its thread only. Kept after the thread exits, to be written out.
+  struct ThreadBuffer {
+    uint64_t tid = 0;
+    std::string name;
+    std::vector<Event> events;
+    std::atomic<uint64_t> num_recorded = 0;
+  };
+
+  // Tells tracers apart in the buffers threads remember
+  uint64_t m_id;
+  std::atomic<bool> m_enabled = false;
+  std::chrono::steady_clock::time_point m_origin;
+
+  // Shared with the threads, which hand their buffer back on exit even if the tracer is gone
+  struct Registry {
+    // Guards the lists of buffers and their names, not the events
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    // Buffers of exited threads, for new threads to reuse
+    std::vector<ThreadBuffer*> free_buffers;
+  };
+  std::shared_ptr<Registry> m_registry;
+
+  ThreadBuffer& get_thread_buffer();
+};
+
+Tracer& get_tracer();
+
+// Records the time until it goes out of scope as a span, when tracing
+class TraceSpan {
+public:
+  explicit TraceSpan(const char* name) {
+    if (get_tracer().is_enabled()) {
+      m_name = name;
+      m_begin = std::chrono::steady_clock::now();
+    }
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  ~TraceSpan() {
+    if (m_name != nullptr) {
+      get_tracer().record(m_name, m_begin, std::chrono::steady_clock::now());
+    }
+  }
+
+private:
+  const char* m_name = nullptr;
+  std::chrono::steady_clock::time_point m_begin;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <LFV/aho_corasick.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <algorithm>
+#include <queue>
+
+AhoCorasick::AhoCorasick(const std::vector<std::string>& patterns) {
+  if (patterns.empty()) {
+    throw LFVException("No patterns to search for");
+  }
+
+  // Give every byte used by a pattern its own column. Class 0 is shared by all other bytes.
+  for (const std::string& pattern : patterns) {
+    if (pattern.empty()) {
+      throw LFVException("Pattern cannot be empty");
+    }
+
+    for (char c : pattern) {
+      auto& byte_class = m_byte_classes[static_cast<unsigned char>(c)];
+      if (byte_class == 0) {
+        byte_class = static_cast<uint16_t>(m_num_classes++);
+      }
+    }
+
+    m_pattern_lengths.push_back(pattern.size());
+    m_max_pattern_length = std::max(m_max_pattern_length, pattern.size());
+  }
+
+  const auto num_classes = static_cast<size_t>(m_num_classes);
+  auto row = [num_classes](State state) { return static_cast<size_t>(state) * num_classes; };
+
+  // Build the trie, with -1 for missing edges
+  m_transitions.assign(num_classes, -1);
+  std::vector<std::vector<int32_t>> own_outputs(1);
+
+  for (size_t pattern = 0; pattern < patterns.size(); pattern++) {
+    State state = INITIAL_STATE;
+    for (char c : patterns[pattern]) {
+      size_t edge = row(state) + m_byte_classes[static_cast<unsigned char>(c)];
+      if (m_transitions[edge] == -1) {
+        m_transitions[edge] = static_cast<State>(own_outputs.size());
+        m_transitions.resize(m_transitions.size() + num_classes, -1);
+        own_outputs.emplace_back();
+      }
+
+      state = m_transitions[edge];
+    }
+
+    own_outputs[static_cast<size_t>(state)].push_back(static_cast<int32_t>(pattern));
+  }
+
+  // Complete the DFA breadth first. A missing edge follows the failure link, which has already
+  // been completed because it is shallower.
+  const size_t num_states = own_outputs.size();
+  std::vector<State> failure(num_states, INITIAL_STATE);
+  std::vector<State> order;
+  order.reserve(num_states);
+
+  std::queue<State> queue;
+  for (size_t c = 0; c < num_classes; c++) {
+    State& next = m_transitions[c];
+    if (next == -1) {
+      next = INITIAL_STATE;
+    } else {
+      queue.push(next);
+    }
+  }
+
+  while (!queue.empty()) {
+    State state = queue.front();
+    queue.pop();
+    order.push_back(state);
+
+    for (size_t c = 0; c < num_classes; c++) {
+      State& next = m_transitions[row(state) + c];
+      State fallback = m_transitions[row(failure[static_cast<size_t>(state)]) + c];
+
+      if (next == -1) {
+        next = fallback;
+      } else {
+        failure[static_cast<size_t>(next)] = fallback;
+        queue.push(next);
+      }
+    }
+  }
+
+  // A state reports its own patterns and everything its failure link reports. Breadth first order
+  // guarantees the failure link's list is complete first.
+  std::vector<std::vector<int32_t>> outputs = own_outputs;
+  for (State state : order) {
+    const auto& inherited = outputs[static_cast<size_t>(failure[static_cast<size_t>(state)])];
+    auto& list = outputs[static_cast<size_t>(state)];
+    list.insert(list.end(), inherited.begin(), inherited.end());
+  }
+
+  m_output_offsets.reserve(num_states + 1);
+  m_output_offsets.push_back(0);
+  for (const auto& list : outputs) {
+    m_outputs.insert(m_outputs.end(), list.begin(), list.end());
+    m_output_offsets.push_back(static_cast<int32_t>(m_outputs.size()));
+  }
+}
@@ -1,21 +1,38 @@
 #include <LFV/app.hpp>
-#include <LFV/background_task_runner.hpp>
+#include <LFV/change_notifier.hpp>
 #include <LFV/file_extractor.hpp>
+#include <LFV/file_watcher.hpp>
+#include <LFV/gzip_source.hpp>
+#include <LFV/index_cache.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/line_index.hpp>
+#include <LFV/parallel_search.hpp>
+#include <LFV/perf_stats.hpp>
+#include <LFV/regex.hpp>
 #include <LFV/safe_arg.hpp>
 #include <LFV/search_stream.hpp>
+#include <LFV/task_pool.hpp>
+#include <LFV/tracer.hpp>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cxxopts.hpp>
 #include <deque>
 #include <ftxui/component/component_base.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/screen.hpp>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
-constexpr int32_t DEFAULT_MATCH_LIMIT = 5'000'000;
-constexpr int32_t DEFAULT_SYNCHRONISATION_DELAY = 30;
+// Matches take a few bytes each and spill to disk, so searches are not capped
+constexpr int64_t DEFAULT_MATCH_LIMIT = std::numeric_limits<int64_t>::max();
 
 // The components below follow a React-ive pattern by gathering all 3 concerns in one component:
 // - Rendering
@@ -184,23 +201,30 @@ public:
 
   ftxui::Element Render() override {
     using namespace ftxui;
+    ScopedTimer timer(get_perf_stats().render);
 
     // Adjust size if needed
     adjust_size();
 
     std::vector<ftxui::Element> line_texts;
-    for (const std::string& line : m_extractor->get_lines()) {
-      line_texts.emplace_back(ftxui::text(line));
+    for (std::string_view line : m_extractor->get_lines()) {
+      line_texts.emplace_back(ftxui::text(std::string(line)));
     }
 
     std::string formatted_fsize = std::to_string(m_extractor->get_size()) + " bytes";
 
     std::string formatted_pos = std::to_string(m_extractor->get_streampos()) + " bytes";
+    if (!m_extractor->is_wrapping()) {
+      formatted_pos += ", column " + std::to_string(m_extractor->get_column() + 1);
+    }
+    if (m_extractor->is_filtering()) {
+      formatted_pos += ", matching lines";
+    }
 
-    auto element = window(
-        text(m_extractor->get_fpath() + " [" + formatted_pos + " / " + formatted_fsize + "]")
-            | color(Color::GreenLight) | bold,
-        vbox(line_texts));
+    auto element = window(text(m_extractor->get_fpath() + " [" + get_formatted_line()
+                               + formatted_pos + " / " + formatted_fsize + "]")
+                              | color(Color::GreenLight) | bold,
+                          vbox(line_texts));
 
     element = flex_grow(element);
     element |= ftxui::reflect(m_box);
@@ -228,6 +252,33 @@ public:
       return true;
     }
 
+    // Without wrapping, lines scroll sideways by a quarter of the window
+    if (!m_extractor->is_wrapping() && (event == Event::ArrowRight || event == Event::ArrowLeft)) {
+      std::streamoff step = std::max(1, (m_last_dim_x - 2) / 4);
+      m_extractor->move_columns(event == Event::ArrowRight ? step : -step);
+      return true;
+    }
+
+    if (event == Event::PageDown) {
+      m_extractor->page_down();
+      return true;
+    }
+
+    if (event == Event::PageUp) {
+      m_extractor->page_up();
+      return true;
+    }
+
+    if (event == Event::Home) {
+      m_extractor->move_to(0);
+      return true;
+    }
+
+    if (event == Event::End) {
+      m_extractor->move_to_end();
+      return true;
+    }
+
     return false;
   }
 
@@ -245,6 +296,26 @@ private:
 
   ftxui::Box m_box;
 
+  // Line position for the title, e.g. "line 12 / 3400+ (indexing 40%) | "
+  std::string get_formatted_line() {
+    auto line_index = m_extractor->get_line_index();
+    if (line_index == nullptr) {
+      return "";
+    }
+
+    auto line_number = m_extractor->get_line_number();
+    std::string formatted = "line " + (line_number ? std::to_string(*line_number + 1) : "?")
+                            + " / " + std::to_string(line_index->get_num_lines());
+
+    if (line_index->get_status() != BackgroundTaskStatus::FINISHED) {
+      std::streamoff end = std::max<std::streamoff>(line_index->get_end(), 1);
+      formatted += "+ (indexing " + std::to_string(line_index->get_indexed_pos() * 100 / end)
+                   + "%)";
+    }
+
+    return formatted + " | ";
+  }
+
   void adjust_size() {
     int dimx = m_box.x_max - m_box.x_min + 1;
     int dimy = m_box.y_max - m_box.y_min + 1;
@@ -258,12 +329,250 @@ private:
   }
 };
 
+// Match density over the whole file, one row per slice of the file. Rows the search has not
+// reached yet are dotted, and the row holding the top of the edit window is highlighted.
+// It doubles as a scrollbar: clicking or dragging on it jumps to the matching part of the file.
+class MinimapWindow final : public ftxui::ComponentBase {
+public:
+  MinimapWindow(std::shared_ptr<EditWindowExtractor> extractor)
+      : m_extractor(std::move(extractor)) {}
+
+  ftxui::Element Render() override {
+    using namespace ftxui;
+
+    // Shades from no matches to the densest row
+    static const std::vector<std::string> SHADES{" ", "░", "▒", "▓", "█"};
+
+    size_t num_rows = get_num_rows();
+    std::streamoff file_end = std::max<std::streamoff>(m_extractor->get_end(), 1);
+    std::streamoff view_pos = m_extractor->get_streampos();
+    auto view_row = std::min(
+        static_cast<size_t>(view_pos * static_cast<std::streamoff>(num_rows) / file_end),
+        num_rows - 1);
+
+    std::vector<uint64_t> counts(num_rows, 0);
+    std::streamoff scanned_pos = file_end;
+    if (m_search_result != nullptr && m_search_result->get_histogram() != nullptr) {
+      counts = m_search_result->get_histogram()->get_rows(num_rows);
+      if (m_search_result->get_status() != BackgroundTaskStatus::FINISHED) {
+        scanned_pos = m_search_result->get_current_pos();
+      }
+    }
+
+    uint64_t max_count = std::max<uint64_t>(*std::max_element(counts.begin(), counts.end()), 1);
+
+    std::vector<Element> rows;
+    for (size_t row = 0; row < num_rows; row++) {
+      auto row_begin = static_cast<std::streamoff>(row) * file_end
+                       / static_cast<std::streamoff>(num_rows);
+
+      Element cell;
+      if (row_begin >= scanned_pos) {
+        cell = text("·") | dim;
+      } else {
+        // Any match at all gets at least the lightest shade
+        uint64_t level = (counts[row] * (SHADES.size() - 1) + max_count - 1) / max_count;
+        cell = text(SHADES[level]) | color(Color::Yellow);
+      }
+
+      if (row == view_row) {
+        cell |= inverted;
+      }
+
+      rows.push_back(cell);
+    }
+
+    return vbox(rows) | border | reflect(m_box);
+  }
+
+  bool OnEvent(ftxui::Event event) override {
+    using namespace ftxui;
+
+    if (!event.is_mouse()) {
+      return false;
+    }
+
+    Mouse& mouse = event.mouse();
+    if (mouse.button == Mouse::Left && mouse.motion == Mouse::Pressed
+        && (m_dragging || m_box.Contain(mouse.x, mouse.y))) {
+      // Keeps following the pointer when a drag goes past the minimap
+      m_dragging = true;
+      jump_to_row(mouse.y - m_box.y_min - 1);
+      return true;
+    }
+
+    if (m_dragging && mouse.motion == Mouse::Released) {
+      m_dragging = false;
+      return true;
+    }
+
+    return false;
+  }
+
+  void OnAnimation([[maybe_unused]] ftxui::animation::Params& params) override {
+    // Do nothing
+  }
+
+  void set_search_result(std::shared_ptr<const SearchResult> search_result) {
+    m_search_result = std::move(search_result);
+  }
+
+private:
+  std::shared_ptr<EditWindowExtractor> m_extractor;
+  std::shared_ptr<const SearchResult> m_search_result;
+  ftxui::Box m_box;
+  bool m_dragging = false;
+
+  // Rows inside the border
+  size_t get_num_rows() const {
+    return static_cast<size_t>(std::max(1, m_box.y_max - m_box.y_min - 1));
+  }
+
+  void jump_to_row(int row) {
+    auto num_rows = static_cast<std::streamoff>(get_num_rows());
+    std::streamoff clamped = std::clamp<std::streamoff>(row, 0, num_rows - 1);
+    m_extractor->move_to(clamped * m_extractor->get_end() / num_rows);
+  }
+};
+
+// Counters and latencies of the hot paths, drawn over the edit window by /stats. It is drawn
+// again whenever the screen is, which input and background progress trigger.
+class StatsWindow final : public ftxui::ComponentBase {
+public:
+  StatsWindow(std::shared_ptr<EditWindowExtractor> extractor) : m_extractor(std::move(extractor)) {}
+
+  ftxui::Element Render() override {
+    using namespace ftxui;
+    const PerfStats& stats = get_perf_stats();
+
+    std::vector<Elements> rows{get_row({"", "count", "mean", "p50", "p90", "p99", "p99.9"})};
+    for (auto [name, histogram] : {std::pair{"Line reads (sampled)", &stats.line_reads},
+                                   std::pair{"Page reads", &stats.page_reads},
+                                   std::pair{"split_line (sampled)", &stats.split_line},
+                                   std::pair{"Render", &stats.render},
+                                   std::pair{"Search to first match", &stats.first_match}}) {
+      rows.push_back(get_latency_row(name, *histogram));
+    }
+
+    return window(text("Stats (/stats to close)") | bold,
+                  vbox({gridbox(rows), separator(), text(get_search_line(stats)),
+                        text(get_page_cache_line(stats)), text(get_memory_line())}))
+           | clear_under | center;
+  }
+
+  bool OnEvent([[maybe_unused]] ftxui::Event event) override { return false; }
+
+  void OnAnimation([[maybe_unused]] ftxui::animation::Params& params) override {
+    // Do nothing
+  }
+
+private:
+  std::shared_ptr<EditWindowExtractor> m_extractor;
+
+  static ftxui::Elements get_row(const std::vector<std::string>& cells) {
+    ftxui::Elements row;
+    for (const std::string& cell : cells) {
+      row.push_back(ftxui::text(" " + cell + " "));
+    }
+
+    return row;
+  }
+
+  static ftxui::Elements get_latency_row(const std::string& name,
+                                         const LatencyHistogram& histogram) {
+    uint64_t count = histogram.get_count();
+    if (count == 0) {
+      return get_row({name, "0", "-", "-", "-", "-", "-"});
+    }
+
+    auto mean = std::chrono::nanoseconds(histogram.get_total().count()
+                                         / static_cast<int64_t>(count));
+    return get_row({name, std::to_string(count), format_duration(mean),
+                    format_duration(histogram.get_percentile(0.5)),
+                    format_duration(histogram.get_percentile(0.9)),
+                    format_duration(histogram.get_percentile(0.99)),
+                    format_duration(histogram.get_percentile(0.999))});
+  }
+
+  static std::string get_search_line(const PerfStats& stats) {
+    uint64_t bytes = stats.searched_bytes.load(std::memory_order_relaxed);
+    uint64_t ns = stats.search_ns.load(std::memory_order_relaxed);
+    std::string line = "Searches: " + std::to_string(stats.num_searches.load()) + " ended, "
+                       + format_bytes(bytes) + " searched";
+    if (ns > 0) {
+      // In double, as bytes times 10^9 overflows past 18 GB searched
+      const double seconds = static_cast<double>(ns) / 1e9;
+      line += " at " + format_bytes(static_cast<uint64_t>(static_cast<double>(bytes) / seconds))
+              + "/s";
+    }
+
+    return line;
+  }
+
+  std::string get_page_cache_line(const PerfStats& stats) const {
+    std::string line = "Page reads: " + format_bytes(stats.page_read_bytes.load()) + " read";
+
+    CacheStats cache = m_extractor->get_cache_stats();
+    if (uint64_t lookups = cache.hits + cache.misses; lookups > 0) {
+      double hit_rate = 100.0 * static_cast<double>(cache.hits) / static_cast<double>(lookups);
+      line += ", view cache hit rate " + format_decimal(hit_rate) + "% of "
+              + std::to_string(lookups);
+    } else {
+      line += ", no page cache for the view (memory-mapped)";
+    }
+
+    return line;
+  }
+
+  static std::string get_memory_line() {
+    uint64_t resident = get_resident_bytes();
+    return "Resident memory: " + (resident > 0 ? format_bytes(resident) : "unknown");
+  }
+
+  static std::string format_decimal(double value) {
+    char formatted[32];
+    std::snprintf(formatted, sizeof(formatted), "%.1f", value);
+    return formatted;
+  }
+
+  static std::string format_duration(std::chrono::nanoseconds duration) {
+    auto ns = static_cast<double>(duration.count());
+    if (ns < 1e3) {
+      return std::to_string(duration.count()) + " ns";
+    }
+    if (ns < 1e6) {
+      return format_decimal(ns / 1e3) + " us";
+    }
+    if (ns < 1e9) {
+      return format_decimal(ns / 1e6) + " ms";
+    }
+
+    return format_decimal(ns / 1e9) + " s";
+  }
+
+  static std::string format_bytes(uint64_t bytes) {
+    if (bytes < 1024) {
+      return std::to_string(bytes) + " B";
+    }
+
+    const char* units[] = {"KiB", "MiB", "GiB", "TiB"};
+    auto value = static_cast<double>(bytes) / 1024;
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < std::size(units)) {
+      value /= 1024;
+      unit++;
+    }
+
+    return format_decimal(value) + " " + units[unit];
+  }
+};
+
 class FileEditor : public ftxui::ComponentBase {
 public:
   FileEditor(std::shared_ptr<EditWindow> edit_window,
              std::shared_ptr<EditWindowExtractor> extractor,
              std::shared_ptr<BackgroundTaskMessageWindow> task_message_window,
-             std::shared_ptr<BackgroundTaskRunner> runner_ptr)
+             std::shared_ptr<TaskPool> task_pool, std::shared_ptr<ChangeNotifier> notifier)
       : m_edit_window(std::move(edit_window)),
         m_task_message_window(std::move(task_message_window)),
         m_command_window(std::make_shared<CommandWindow>(
@@ -271,29 +580,59 @@ public:
         m_message_window(std::make_shared<MessageWindow>()),
 
         m_extractor(std::move(extractor)),
+        m_minimap_window(std::make_shared<MinimapWindow>(m_extractor)),
+        m_stats_window(std::make_shared<StatsWindow>(m_extractor)),
 
-        m_runner_ptr(std::move(runner_ptr)),
+        m_task_pool(std::move(task_pool)),
+        m_notifier(std::move(notifier)),
 
         m_jump_options("jump", "Jump to a location if the file"),
-        m_search_options("search", "Search a pattern") {
-    m_jump_options.add_options()("p,position", "Position to jump to in bytes",
-                                 cxxopts::value<long long>());
+        m_search_options("search", "Search a pattern"),
+        m_search_any_options("search-any", "Search several patterns at once") {
+    m_jump_options.add_options()(
+        "p,position", "Position to jump to in bytes, or in percent of the file as in 37%",
+        cxxopts::value<std::string>())(
+        "l,line", "Line to jump to, counting from 1", cxxopts::value<long long>());
     m_jump_options.parse_positional({"position"});
 
     m_search_options.add_options()("p,pattern", "Pattern to search", cxxopts::value<std::string>())(
         "f,from", "Starting position in bytes", cxxopts::value<long long>()->default_value("0"))(
-        "t,to", "Ending position in bytes",
-        cxxopts::value<long long>()->default_value(std::to_string(m_extractor->get_size())));
+        "t,to", "Ending position in bytes, the end of the file by default",
+        cxxopts::value<long long>())(
+        "j,jobs", "Number of threads to search with",
+        cxxopts::value<unsigned>()->default_value(
+            std::to_string(std::max(1U, std::thread::hardware_concurrency()))))(
+        "r,regex", "Treat the pattern as a regular expression")(
+        "c,count", "Only count matches, without storing where they are");
     m_search_options.parse_positional({"pattern"});
 
+    m_search_any_options.add_options()("p,patterns", "Patterns to search",
+                                       cxxopts::value<std::vector<std::string>>())(
+        "f,from", "Starting position in bytes", cxxopts::value<long long>()->default_value("0"))(
+        "t,to", "Ending position in bytes, the end of the file by default",
+        cxxopts::value<long long>())(
+        "c,count", "Only count matches, without storing where they are");
+    m_search_any_options.parse_positional({"patterns"});
+
     Add(m_edit_window);
     Add(m_task_message_window);
     Add(m_message_window);
     Add(m_command_window);
+
+    m_file_status = stat_file(m_extractor->get_fpath()).value_or(FileStatus{});
+    restart_indexing();
   }
 
   bool OnEvent(ftxui::Event event) override {
     using namespace ftxui;
+    TraceSpan span("event");
+
+    // Background state changed
+    if (event == Event::Custom) {
+      synchronise();
+      return true;
+    }
+
     // Handle special events
     if (event == Event::Special({0})) {
       m_edit_window->OnEvent(event);
@@ -314,6 +653,11 @@ public:
       return m_message_window->OnEvent(event);
     }
 
+    // The minimap scrollbar takes clicks in any mode
+    if (event.is_mouse() && m_minimap_window->OnEvent(event)) {
+      return true;
+    }
+
     if (event == Event::Escape) {
       if (m_mode != Mode::VIEW) {
         switch_mode(Mode::VIEW);
@@ -340,14 +684,22 @@ public:
   }
 
   ftxui::Element Render() override {
+    using namespace ftxui;
+    TraceSpan span("render");
+
+    auto edit_area = hbox({m_edit_window->Render() | flex, m_minimap_window->Render()}) | flex;
+    if (m_stats_shown) {
+      edit_area = dbox({edit_area, m_stats_window->Render()});
+    }
+
     if (m_mode == Mode::VIEW) {
       // View mode
-      return ftxui::vbox({m_edit_window->Render(), m_task_message_window->Render()});
+      return ftxui::vbox({edit_area, m_task_message_window->Render()});
     }
 
     // Command mode
     return ftxui::vbox({
-        m_edit_window->Render(),
+        edit_area,
         m_task_message_window->Render(),
         m_message_window->Render(),
         m_command_window->Render(),
@@ -360,25 +712,144 @@ public:
 
   bool Focusable() const override { return true; }
 
+  // Follows the end of the file as it grows, like tail -f
+  void set_following(bool following) {
+    if (!following) {
+      m_watcher.reset();
+      return;
+    }
+
+    if (m_watcher != nullptr) {
+      return;
+    }
+
+    if (m_gzip_index != nullptr) {
+      throw LFVException("Compressed files cannot be followed");
+    }
+
+    stop_mapped_reads();
+    m_watcher = std::make_unique<FileWatcher>(m_extractor->get_fpath(), m_notifier);
+    m_seen_generation = 0;
+
+    // Catches up with changes made while not following
+    check_file();
+    m_extractor->move_to_end();
+  }
+
+  // Reading a mapped file past the end it was truncated to faults, so a followed file is read with
+  // pread. Background tasks reading the mapping are stopped and started again the same way.
+  void stop_mapped_reads() {
+    FileSourceOptions options = m_extractor->get_source_options();
+    if (!options.use_mmap) {
+      return;
+    }
+    options.use_mmap = false;
+
+    const bool indexing = m_index_task.is_valid() && !m_index_task.is_done();
+    const bool searching = m_search_task.is_valid() && !m_search_task.is_done();
+    for (const TaskHandle* task : {&m_index_task, &m_search_task}) {
+      if (task->is_valid()) {
+        task->cancel();
+        task->wait();
+      }
+    }
+
+    m_extractor->set_source_options(options);
+
+    // The index carries on from where it stopped, and the search starts over
+    if (indexing) {
+      submit_indexing();
+    }
+    if (searching) {
+      reset_search(m_search_result->is_count_only());
+      submit_search_range(m_search_spec.from, m_search_spec.to, 0);
+    }
+  }
+
+  // Decompresses the gzip file in the background, showing its content as it comes
+  void start_decompression(std::shared_ptr<GzipIndex> gzip_index) {
+    m_gzip_index = gzip_index;
+    m_gzip_task = m_task_pool->submit([gzip_index](const CancellationToken& token) {
+      TraceSpan span("decompress");
+      gzip_index->build(*token);
+    });
+  }
+
+  // Loads the line index and searches saved the last time the file was viewed in the background,
+  // as decoding saved matches takes a while. They are picked up once loaded.
+  void set_index_cache(std::unique_ptr<IndexCache> index_cache) {
+    m_index_cache = std::move(index_cache);
+
+    auto loaded = std::make_shared<std::optional<IndexCache::State>>();
+    m_loaded_cache = loaded;
+    m_cache_task = m_task_pool->submit(
+        [index_cache = m_index_cache, loaded](const CancellationToken&) {
+          TraceSpan span("load index cache");
+          *loaded = index_cache->load();
+        },
+        TaskPriority::HIGH);
+  }
+
+  // Call once background tasks have stopped
+  void save_index_cache() {
+    if (m_index_cache == nullptr) {
+      return;
+    }
+
+    std::vector<SavedSearch> searches;
+    if (m_search_result != nullptr) {
+      searches.push_back(get_saved_search());
+    }
+    searches.insert(searches.end(), m_recent_searches.begin(), m_recent_searches.end());
+
+    m_index_cache->save(*m_line_index, searches);
+  }
+
   void synchronise() {
+    TraceSpan span("synchronise");
+
+    restore_index_cache();
+
+    try {
+      if (m_watcher != nullptr) {
+        follow_file();
+      } else if (m_gzip_index != nullptr) {
+        follow_decompression();
+      }
+    } catch (LFVException const& e) {
+      m_message_window->error(e.what());
+    }
+
     // Synchronise UI state with background task if needed
     if (m_search_result != nullptr) {
-      BackgroundTaskStatus status = m_search_result->get_status();
-      switch (status) {
+      // Lines with matches found since fill a filtered window
+      if (m_extractor->is_filtering()) {
+        m_extractor->refresh_filter();
+      }
+
+      // A restored result has no task
+      switch (get_search_status(*m_search_result, m_search_task)) {
         case BackgroundTaskStatus::NOT_STARTED:
           m_task_message_window->set_message("Search pending");
           break;
         case BackgroundTaskStatus::ONGOING:
           m_task_message_window->set_message(
               "Searched until location " + std::to_string(m_search_result->get_current_pos())
-              + "... " + std::to_string(m_search_result->get_num_matches()) + " occurences found.");
+              + "... " + std::to_string(m_search_result->get_num_found()) + " occurences found."
+              + get_displayed_match_description());
           break;
         case BackgroundTaskStatus::FINISHED:
-          m_task_message_window->set_message("Searche completed. "
-                                             + std::to_string(m_search_result->get_num_matches())
-                                             + " occurences found.");
+          m_task_message_window->set_message(
+              "Searche completed. " + std::to_string(m_search_result->get_num_found())
+              + " occurences found." + get_displayed_match_description());
           break;
         case BackgroundTaskStatus::ABORTED:
+          if (std::string error = m_search_task.is_valid() ? m_search_task.get_error() : "";
+              !error.empty()) {
+            m_task_message_window->set_message("Search failed: " + error);
+            break;
+          }
+
           m_task_message_window->set_message("Search canceled!");
           break;
       }
@@ -392,17 +863,61 @@ private:
   std::shared_ptr<CommandWindow> m_command_window;
   std::shared_ptr<MessageWindow> m_message_window;
   std::shared_ptr<EditWindowExtractor> m_extractor;
-  std::shared_ptr<BackgroundTaskRunner> m_runner_ptr;
+  std::shared_ptr<MinimapWindow> m_minimap_window;
+  std::shared_ptr<StatsWindow> m_stats_window;
+  bool m_stats_shown = false;
+  std::shared_ptr<TaskPool> m_task_pool;
+  std::shared_ptr<ChangeNotifier> m_notifier;
+
+  std::shared_ptr<LineIndex> m_line_index;
+  TaskHandle m_index_task;
+
+  // Set for a gzip file, whose content grows as the index decompresses it
+  std::shared_ptr<const GzipIndex> m_gzip_index;
+  TaskHandle m_gzip_task;
+  bool m_gzip_error_shown = false;
+
+  // Set while following the file
+  std::unique_ptr<FileWatcher> m_watcher;
+  uint64_t m_seen_generation = 0;
+  // The file as it was last read, to tell growth from truncation and replacement
+  FileStatus m_file_status;
 
   // Users' commands parsers
   cxxopts::Options m_jump_options;
   cxxopts::Options m_search_options;
+  cxxopts::Options m_search_any_options;
 
   // Search result, if there is any
-  static constexpr int NOT_DISPLAYED = -1;
-  int m_displayed_search_index = NOT_DISPLAYED;
+  static constexpr int64_t NOT_DISPLAYED = -1;
+  int64_t m_displayed_search_index = NOT_DISPLAYED;
   std::shared_ptr<SearchResult> m_search_result;
-  std::shared_ptr<std::atomic<bool>> m_search_aborted;
+  TaskHandle m_search_task;
+  // Whether only the lines with matches are shown
+  bool m_filtering = false;
+
+  // What the current search looks for and where, so that it can carry on over appended bytes
+  struct SearchSpec {
+    // So that a match can also say which pattern it is for
+    std::vector<std::string> patterns;
+    std::shared_ptr<const Regex> regex;
+    bool any = false;
+    unsigned jobs = 1;
+    std::streamoff from = 0;
+    // Searched up to there so far
+    std::streamoff to = 0;
+    // Whether the search carries on as the file grows
+    bool to_end = false;
+  };
+  SearchSpec m_search_spec;
+
+  // Finished searches before the current one, most recent first
+  std::deque<SavedSearch> m_recent_searches;
+
+  std::shared_ptr<IndexCache> m_index_cache;
+  // Where the cache is loaded to in the background
+  TaskHandle m_cache_task;
+  std::shared_ptr<std::optional<IndexCache::State>> m_loaded_cache;
 
   void switch_mode(Mode new_mode) {
     clear_current_mode();
@@ -424,8 +939,12 @@ private:
       execute_command_unguarded(std::move(command));
     } catch (cxxopts::OptionException const& e) {
       m_message_window->error(e.what());
-      return;
+    } catch (LFVException const& e) {
+      m_message_window->error(e.what());
     }
+
+    // Commands may start or cancel tasks before these get to notify
+    synchronise();
   }
 
   void execute_command_unguarded(const std::string& command) {
@@ -433,7 +952,8 @@ private:
     std::string command_type(safe_arg.get_argv()[0]);
 
     if (command_type == "exit") {
-      exit(0);
+      ftxui::ScreenInteractive::Active()->ExitLoopClosure()();
+      return;
     }
 
     if (command_type == "jump") {
@@ -441,15 +961,46 @@ private:
       return;
     }
 
+    if (command_type == "wrap") {
+      m_extractor->set_wrap(!m_extractor->is_wrapping());
+      m_message_window->info(m_extractor->is_wrapping() ? "Lines are wrapped"
+                                                        : "Lines are not wrapped");
+      return;
+    }
+
+    if (command_type == "follow") {
+      set_following(m_watcher == nullptr);
+      m_message_window->info(m_watcher != nullptr ? "Following the end of the file"
+                                                  : "Stopped following the file");
+      return;
+    }
+
+    if (command_type == "stats") {
+      m_stats_shown = !m_stats_shown;
+      return;
+    }
+
     if (command_type == "search") {
       execute_search_command(safe_arg);
       return;
     }
 
+    if (command_type == "search-any") {
+      execute_search_any_command(safe_arg);
+      return;
+    }
+
+    if (command_type == "filter") {
+      execute_filter_command(safe_arg);
+      return;
+    }
+
     if (command_type == "cancel") {
       // Request search to cancel. The thread running this search won't really be stopped until
       // it reads the signal.
-      *m_search_aborted = true;
+      if (m_search_task.is_valid()) {
+        m_search_task.cancel();
+      }
       return;
     }
 
@@ -460,7 +1011,18 @@ private:
     cxxopts::ParseResult parse_result
         = m_jump_options.parse(safe_arg.get_argc(), safe_arg.get_argv());
 
-    auto pos = static_cast<std::streampos>(parse_result["position"].as<long long>());
+    if (parse_result.count("line") != 0) {
+      execute_jump_to_line(parse_result["line"].as<long long>());
+      return;
+    }
+
+    auto position = parse_result["position"].as<std::string>();
+    if (!position.empty() && position.back() == '%') {
+      execute_jump_to_percent(position);
+      return;
+    }
+
+    auto pos = static_cast<std::streampos>(parse_number<long long>(position));
 
     if (pos < 0 || pos >= m_extractor->get_end()) {
       m_message_window->error("Invalid position: " + std::to_string(pos));
@@ -470,19 +1032,118 @@ private:
     }
   }
 
-  void execute_search_command(const SafeArg& safe_arg) {
+  void execute_jump_to_percent(const std::string& position) {
+    auto percent = parse_number<double>(position.substr(0, position.size() - 1));
+    if (!(percent >= 0 && percent <= 100)) {
+      m_message_window->error("Invalid position: " + position);
+      return;
+    }
+
+    if (percent == 100) {
+      m_extractor->move_to_end();
+    } else {
+      auto end = static_cast<double>(m_extractor->get_end());
+      m_extractor->move_to(static_cast<std::streamoff>(end * percent / 100));
+    }
+
+    m_message_window->info("Jumped to " + position);
+  }
+
+  // Parses the whole of text as a number, or throws LFVException
+  template <typename Number> static Number parse_number(const std::string& text) {
+    std::istringstream in(text);
+    Number number{};
+    if (!(in >> number) || !in.eof()) {
+      throw LFVException("Invalid number: " + text);
+    }
+
+    return number;
+  }
+
+  void execute_jump_to_line(long long line) {
+    auto line_index = m_extractor->get_line_index();
+    if (line_index == nullptr) {
+      m_message_window->error("Line numbers are not available");
+      return;
+    }
+
+    bool finished = line_index->get_status() == BackgroundTaskStatus::FINISHED;
+    if (line < 1 || (finished && line > line_index->get_num_lines())) {
+      m_message_window->error("Invalid line: " + std::to_string(line));
+      return;
+    }
+
+    // Lines are shown counting from 1 but indexed from 0
+    if (!m_extractor->move_to_line(line - 1)) {
+      m_message_window->error("Line " + std::to_string(line) + " is not indexed yet");
+      return;
+    }
+
+    m_message_window->info("Jumped to line " + std::to_string(line));
+  }
+
+  // Returns whether the search started
+  bool execute_search_command(const SafeArg& safe_arg) {
     cxxopts::ParseResult parse_result
         = m_search_options.parse(safe_arg.get_argc(), safe_arg.get_argv());
 
     auto pattern = parse_result["pattern"].as<std::string>();
     auto from = static_cast<std::streampos>(parse_result["from"].as<long long>());
-    auto to = static_cast<std::streampos>(parse_result["to"].as<long long>());
+    auto to = get_search_end(parse_result);
+    auto jobs = parse_result["jobs"].as<unsigned>();
+    bool is_regex = parse_result.count("regex") > 0;
+    bool count_only = parse_result.count("count") > 0;
 
     if (pattern.empty()) {
       m_message_window->error("Pattern cannot be empty");
+      return false;
+    }
+
+    // Compiled here so that syntax errors are reported right away
+    std::shared_ptr<const Regex> regex;
+    if (is_regex) {
+      try {
+        regex = std::make_shared<const Regex>(pattern);
+      } catch (LFVException const& e) {
+        m_message_window->error(e.what());
+        return false;
+      }
+    }
+
+    if (from > to || from < 0 || from > m_extractor->get_end() || to < 0
+        || to > m_extractor->get_end()) {
+      m_message_window->error("Invalid range: " + std::to_string(from) + " - "
+                              + std::to_string(to));
+      return false;
+    }
+
+    // Reset search variables
+    start_search({{pattern}, regex, false, jobs, from, from, to == m_extractor->get_end()}, to,
+                 count_only);
+    return true;
+  }
+
+  void execute_search_any_command(const SafeArg& safe_arg) {
+    cxxopts::ParseResult parse_result
+        = m_search_any_options.parse(safe_arg.get_argc(), safe_arg.get_argv());
+
+    if (parse_result.count("patterns") == 0) {
+      m_message_window->error("No patterns given");
       return;
     }
 
+    auto patterns = parse_result["patterns"].as<std::vector<std::string>>();
+    auto from = static_cast<std::streampos>(parse_result["from"].as<long long>());
+    auto to = get_search_end(parse_result);
+    bool count_only = parse_result.count("count") > 0;
+
+    for (const auto& pattern : patterns) {
+      if (pattern.empty()) {
+        m_message_window->error("Pattern cannot be empty");
+        return;
+      }
+    }
+
     if (from > to || from < 0 || from > m_extractor->get_end() || to < 0
         || to > m_extractor->get_end()) {
       m_message_window->error("Invalid range: " + std::to_string(from) + " - "
@@ -490,27 +1151,381 @@ private:
       return;
     }
 
-    if (!m_runner_ptr->can_run_task()) {
-      m_message_window->error("Already running a background task. ");
+    start_search({patterns, nullptr, true, 1, from, from, to == m_extractor->get_end()}, to,
+                 count_only);
+  }
+
+  // With a pattern, searches as /search does and shows only the lines with matches as they are
+  // found. Without one, shows only the lines with matches of the current search, or every line
+  // again if they were filtered.
+  void execute_filter_command(const SafeArg& safe_arg) {
+    if (safe_arg.get_argc() > 1) {
+      if (!execute_search_command(safe_arg)) {
+        return;
+      }
+    } else if (m_filtering) {
+      set_filtering(false);
+      m_message_window->info("Showing every line");
       return;
     }
 
-    // Reset search variables
-    reset_search();
+    if (m_search_result == nullptr) {
+      m_message_window->error("No search to filter by");
+      return;
+    }
+
+    if (m_search_result->is_count_only()) {
+      m_message_window->error("Matches are not kept by count-only searches");
+      return;
+    }
+
+    set_filtering(true);
+    m_message_window->info("Showing the lines with matches");
+  }
+
+  // While filtering, the edit window shows only the lines with matches of the current search
+  void set_filtering(bool filtering) {
+    m_filtering = filtering;
+    update_filter();
+  }
+
+  void update_filter() {
+    bool shown = m_filtering && m_search_result != nullptr && !m_search_result->is_count_only();
+    m_extractor->set_filter(shown ? m_search_result : nullptr);
+  }
 
+  std::streampos get_search_end(const cxxopts::ParseResult& parse_result) {
+    if (parse_result.count("to") == 0) {
+      return m_extractor->get_end();
+    }
+
+    return static_cast<std::streampos>(parse_result["to"].as<long long>());
+  }
+
+  // Searches [begin, end) for the current search into its result. Matches ending at or before
+  // min_match_end, or for a regex beginning before min_match_begin, were found by an earlier range.
+  void submit_search_range(std::streamoff begin, std::streamoff end, std::streamoff min_match_end,
+                           std::streamoff min_match_begin = 0) {
     // Capturing by reference leads to reading trash values when
-    // the lambda is called later.
-    m_runner_ptr->run_task([this, pattern, from, to] {
-      search_in_stream(std::ifstream(m_extractor->get_fpath()), pattern, from, to,
-                       DEFAULT_MATCH_LIMIT, m_search_result, m_search_aborted);
+    // the lambda is called later. The result is captured too, as a later search replaces it.
+    auto fpath = m_extractor->get_fpath();
+    auto source_options = m_extractor->get_source_options();
+    auto result = m_search_result;
+    auto spec = m_search_spec;
+    // The workers of a parallel search run on the pool, which does not own itself through them
+    std::weak_ptr<TaskPool> task_pool = m_task_pool;
+    submit_search([fpath, source_options, result, spec, begin, end, min_match_end,
+                   min_match_begin, task_pool](const CancellationToken& token) {
+      // A gzip file is only read decompressed, through its index
+      const bool compressed = source_options.gzip_index != nullptr;
+
+      if (spec.regex != nullptr) {
+        search_regex_in_file(fpath, *spec.regex, begin, end, DEFAULT_MATCH_LIMIT, result, token,
+                             source_options, min_match_begin);
+        return;
+      }
+
+      if (spec.any) {
+        if (compressed) {
+          search_any_in_file(fpath, source_options, spec.patterns, begin, end,
+                             DEFAULT_MATCH_LIMIT, result, token, min_match_end);
+        } else {
+          search_any_in_stream(std::ifstream(fpath), spec.patterns, begin, end,
+                               DEFAULT_MATCH_LIMIT, result, token, min_match_end);
+        }
+        return;
+      }
+
+      const std::string& pattern = spec.patterns.front();
+      if (spec.jobs <= 1 && !compressed) {
+        search_in_stream(std::ifstream(fpath), pattern, begin, end, DEFAULT_MATCH_LIMIT, result,
+                         token);
+        return;
+      }
+
+      search_in_file_parallel(fpath, pattern, begin, end, DEFAULT_MATCH_LIMIT, result, token,
+                              spec.jobs, DEFAULT_SEARCH_CHUNK_SIZE, source_options,
+                              task_pool.lock());
     });
+
+    m_search_spec.to = end;
   }
 
-  void reset_search() {
+  // Shows the saved state once loaded. The index replaces the one being built if it got further,
+  // and the searches are restored unless one was started meanwhile.
+  void restore_index_cache() {
+    if (!m_cache_task.is_valid() || !m_cache_task.is_done()) {
+      return;
+    }
+
+    std::optional<IndexCache::State> state = std::move(*m_loaded_cache);
+    m_cache_task = TaskHandle();
+    m_loaded_cache.reset();
+    if (!state) {
+      return;
+    }
+
+    if (state->line_index->get_indexed_pos() > m_line_index->get_indexed_pos()) {
+      if (m_index_task.is_valid()) {
+        m_index_task.cancel();
+      }
+
+      m_line_index = state->line_index;
+      m_line_index->set_notifier(m_notifier);
+      m_extractor->set_line_index(m_line_index);
+      submit_indexing();
+    }
+
+    if (!state->searches.empty()) {
+      if (m_search_result == nullptr) {
+        restore_search(state->searches.front(),
+                       std::max(1U, std::thread::hardware_concurrency()));
+        m_recent_searches.assign(state->searches.begin() + 1, state->searches.end());
+        extend_search();
+      } else {
+        m_recent_searches.insert(m_recent_searches.end(), state->searches.begin(),
+                                 state->searches.end());
+        while (m_recent_searches.size() > IndexCache::MAX_SEARCHES) {
+          m_recent_searches.pop_back();
+        }
+      }
+    }
+
+    m_message_window->info("Restored the line index and searches of the last session");
+  }
+
+  // Indexes the file from its start, as when it is opened or replaced
+  void restart_indexing() {
+    if (m_index_task.is_valid()) {
+      m_index_task.cancel();
+    }
+
+    m_line_index = std::make_shared<LineIndex>();
+    m_line_index->set_notifier(m_notifier);
+    m_extractor->set_line_index(m_line_index);
+    submit_indexing();
+  }
+
+  // Indexes from where the index stopped to the current end of the file
+  void submit_indexing() {
+    auto fpath = m_extractor->get_fpath();
+    auto source_options = m_extractor->get_source_options();
+    auto line_index = m_line_index;
+    m_index_task
+        = m_task_pool->submit([fpath, source_options, line_index](const CancellationToken& token) {
+            TraceSpan span("index lines");
+            FileExtractor index_extractor(fpath, source_options);
+            line_index->build(index_extractor, *token);
+          });
+  }
+
+  // Catches up with the followed file
+  void follow_file() {
+    if (uint64_t generation = m_watcher->get_generation(); generation != m_seen_generation) {
+      m_seen_generation = generation;
+      check_file();
+    }
+
+    catch_up();
+  }
+
+  // Shows what the gzip index has decompressed since, without moving the view
+  void follow_decompression() {
+    if (m_gzip_index->get_end() > m_extractor->get_end()) {
+      m_extractor->refresh(false);
+    }
+
+    if (std::string error = m_gzip_task.get_error(); !error.empty() && !m_gzip_error_shown) {
+      m_gzip_error_shown = true;
+      m_message_window->error("Decompression stopped: " + error);
+    }
+
+    catch_up();
+  }
+
+  // Indexing and searching carry on over the new bytes once they are done with the old ones
+  void catch_up() {
+    if (m_line_index->get_status() == BackgroundTaskStatus::FINISHED
+        && m_line_index->get_end() < m_extractor->get_end()) {
+      submit_indexing();
+    }
+
+    extend_search();
+  }
+
+  void check_file() {
+    auto status = stat_file(m_extractor->get_fpath());
+    if (!status) {
+      // Moved away by rotation, and not created again yet: the old content stays on screen
+      return;
+    }
+
+    if (!status->is_same_file(m_file_status)) {
+      reopen_file("The file was replaced");
+    } else if (status->size < m_extractor->get_end()) {
+      reopen_file("The file was truncated");
+    } else {
+      m_extractor->refresh();
+    }
+
+    m_file_status = *status;
+  }
+
+  // Starts over on a new file under the same name
+  void reopen_file(const std::string& reason) {
+    // What was saved is of the old content
+    m_cache_task = TaskHandle();
+    m_loaded_cache.reset();
+
+    m_extractor->reopen();
+    m_extractor->move_to_end();
+    restart_indexing();
+
+    // Matches were positions in the old content
+    if (m_search_task.is_valid()) {
+      m_search_task.cancel();
+    }
+    m_displayed_search_index = NOT_DISPLAYED;
+    m_search_result.reset();
+    m_recent_searches.clear();
+    m_minimap_window->set_search_result(nullptr);
+    set_filtering(false);
+
+    m_task_message_window->set_message(reason + ", and was read again from its start");
+  }
+
+  // Carries a search that went to the end of the file on over the bytes appended since. Only a
+  // pattern's length before the old end is read again, to find the matches crossing it, or for a
+  // regex the last line.
+  void extend_search() {
+    if (m_search_result == nullptr || !m_search_spec.to_end
+        || m_search_result->get_status() != BackgroundTaskStatus::FINISHED) {
+      return;
+    }
+
+    const std::streamoff end = m_extractor->get_end();
+    const std::streamoff old_end = m_search_spec.to;
+    if (old_end >= end) {
+      return;
+    }
+
+    // Matches are added in ascending order
+    const std::streamoff last_match = m_search_result->get_last_match();
+    m_search_result->extend_histogram(end);
+
+    if (m_search_spec.regex != nullptr) {
+      // Regex matches have no bounded length: the last match may still grow, and one under way at
+      // the old end may have started anywhere on its line. The search resumes at the later of the
+      // two, and leaves out the matches already found.
+      const std::streamoff floor = std::max(m_search_spec.from, last_match);
+      submit_search_range(m_extractor->get_line_begin(old_end, floor), end, 0, last_match + 1);
+      return;
+    }
+
+    std::streamoff overlap = 0;
+    for (const auto& pattern : m_search_spec.patterns) {
+      overlap = std::max(overlap, static_cast<std::streamoff>(pattern.size()) - 1);
+    }
+
+    std::streamoff resume = std::max(m_search_spec.from, old_end - overlap);
+    if (last_match != -1) {
+      resume = std::max(resume, last_match + 1);
+    }
+
+    submit_search_range(resume, end, old_end);
+  }
+
+  // Searches [spec.from, to), or shows the results of the same search from earlier
+  void start_search(SearchSpec spec, std::streamoff to, bool count_only) {
+    remember_search();
+
+    if (auto it = find_recent_search(spec, to, count_only); it != m_recent_searches.end()) {
+      SavedSearch search = std::move(*it);
+      m_recent_searches.erase(it);
+      restore_search(search, spec.jobs);
+      m_message_window->info("Showing the results of the same search from earlier");
+
+      // Over what the file grew by since, if the search went to its end
+      extend_search();
+      return;
+    }
+
+    reset_search(count_only);
+    m_search_spec = std::move(spec);
+    submit_search_range(m_search_spec.from, to, 0);
+  }
+
+  // Keeps the current search if it finished, so that it can be shown again and saved in the
+  // index cache
+  void remember_search() {
+    if (m_search_result == nullptr
+        || m_search_result->get_status() != BackgroundTaskStatus::FINISHED) {
+      return;
+    }
+
+    m_recent_searches.push_front(get_saved_search());
+    if (m_recent_searches.size() > IndexCache::MAX_SEARCHES) {
+      m_recent_searches.pop_back();
+    }
+  }
+
+  std::deque<SavedSearch>::iterator find_recent_search(const SearchSpec& spec, std::streamoff to,
+                                                       bool count_only) {
+    return std::find_if(
+        m_recent_searches.begin(), m_recent_searches.end(), [&](const SavedSearch& search) {
+          return search.patterns == spec.patterns && search.regex == (spec.regex != nullptr)
+                 && search.any == spec.any && search.from == spec.from
+                 && search.result->is_count_only() == count_only
+                 && (spec.to_end ? search.to_end : !search.to_end && search.to == to);
+        });
+  }
+
+  SavedSearch get_saved_search() const {
+    return {m_search_spec.patterns, m_search_spec.regex != nullptr, m_search_spec.any,
+            m_search_spec.from,     m_search_spec.to,              m_search_spec.to_end,
+            m_search_result};
+  }
+
+  void restore_search(const SavedSearch& search, unsigned jobs) {
+    std::shared_ptr<const Regex> regex;
+    if (search.regex) {
+      regex = std::make_shared<const Regex>(search.patterns.front());
+    }
+
+    set_search_result(search.result);
+    m_search_spec
+        = {search.patterns, regex, search.any, jobs, search.from, search.to, search.to_end};
+  }
+
+  void reset_search(bool count_only) {
+    set_search_result(std::make_shared<SearchResult>(
+        std::make_shared<MatchHistogram>(m_extractor->get_end()), count_only));
+  }
+
+  void set_search_result(std::shared_ptr<SearchResult> result) {
+    // Only the latest search is shown, so an earlier one still running is of no use
+    if (m_search_task.is_valid()) {
+      m_search_task.cancel();
+    }
+    // Until one is submitted for it: a restored result has none
+    m_search_task = TaskHandle();
+
     // Reset search variables
     m_displayed_search_index = NOT_DISPLAYED;
-    m_search_result = std::make_shared<SearchResult>();
-    m_search_aborted = std::make_shared<std::atomic<bool>>(false);
+    m_search_result = std::move(result);
+    m_search_result->set_notifier(m_notifier);
+    m_minimap_window->set_search_result(m_search_result);
+    update_filter();
+  }
+
+  void submit_search(TaskPool::Task task) {
+    // Searches come before background work such as indexing
+    m_search_task = m_task_pool->submit(
+        [task = std::move(task)](const CancellationToken& token) {
+          TraceSpan span("search");
+          task(token);
+        },
+        TaskPriority::HIGH);
   }
 
   bool handleSearchEvents(ftxui::Event event) {
@@ -534,7 +1549,12 @@ private:
   }
 
   bool handleSearchTabEvent() {
-    int num_match = m_search_result->get_num_matches();
+    if (m_search_result->is_count_only()) {
+      m_message_window->error("Matches are not kept by count-only searches");
+      return true;
+    }
+
+    int64_t num_match = m_search_result->get_num_matches();
     BackgroundTaskStatus status = m_search_result->get_status();
     bool search_finished_or_aborted
         = status == BackgroundTaskStatus::FINISHED || status == BackgroundTaskStatus::ABORTED;
@@ -555,12 +1575,17 @@ private:
     }
 
     m_displayed_search_index++;
-    m_extractor->move_to(m_search_result->get_match(m_displayed_search_index));
+    move_to_displayed_match();
     return true;
   }
 
   bool handleSearchReverseTabEvent() {
-    int num_match = m_search_result->get_num_matches();
+    if (m_search_result->is_count_only()) {
+      m_message_window->error("Matches are not kept by count-only searches");
+      return true;
+    }
+
+    int64_t num_match = m_search_result->get_num_matches();
 
     if (num_match == 0) {
       m_message_window->error("No matches found yet");
@@ -573,60 +1598,107 @@ private:
     }
 
     m_displayed_search_index--;
-    m_extractor->move_to(m_search_result->get_match(m_displayed_search_index));
+    move_to_displayed_match();
     return true;
   }
-};
 
-class SynchroniseLoop {
-public:
-  SynchroniseLoop(std::shared_ptr<FileEditor> file_editor, int delay)
-      : m_file_editor(std::move(file_editor)), m_delay(delay) {}
-
-  void loop() {
-    while (true) {
-      m_file_editor->synchronise();
-      ftxui::ScreenInteractive* screen = ftxui::ScreenInteractive::Active();
-      if (screen != nullptr) {
-        screen->PostEvent(ftxui::Event::Custom);
-      }
-      std::this_thread::sleep_for(std::chrono::microseconds(m_delay));
-    }
+  void move_to_displayed_match() {
+    m_extractor->move_to(m_search_result->get_match(m_displayed_search_index));
   }
 
-private:
-  std::shared_ptr<FileEditor> m_file_editor;
-  int m_delay;
+  // Says which pattern the displayed match is for, when searching for several
+  std::string get_displayed_match_description() {
+    if (m_search_spec.patterns.size() <= 1 || m_displayed_search_index == NOT_DISPLAYED) {
+      return "";
+    }
+
+    auto pattern
+        = static_cast<size_t>(m_search_result->get_match_pattern(m_displayed_search_index));
+    return " Showing match " + std::to_string(m_displayed_search_index + 1) + ": "
+           + m_search_spec.patterns[pattern];
+  }
 };
 
-void run_app(std::string fpath) {
+void run_app(std::string fpath, const FileSourceOptions& source_options, int32_t max_redraw_rate,
+             bool follow, bool use_index_cache, const std::string& trace_fpath) {
   using namespace ftxui;
 
-  auto extractor = std::make_shared<EditWindowExtractor>(fpath);
+  // Rejected before any thread starts or the screen is taken over
+  const bool is_gzip = is_gzip_file(fpath);
+  if (follow && is_gzip) {
+    throw LFVException("Compressed files cannot be followed: " + fpath);
+  }
 
-  auto background_task_message_window = std::make_shared<BackgroundTaskMessageWindow>();
+  // Started before any thread, so that all of them are traced
+  if (!trace_fpath.empty()) {
+    get_tracer().start();
+  }
+  get_tracer().set_thread_name("UI");
 
-  auto edit_window = std::make_shared<EditWindow>(extractor);
+  auto notifier = std::make_shared<ChangeNotifier>(max_redraw_rate);
 
-  auto runner_ptr = std::make_shared<BackgroundTaskRunner>();
+  auto task_pool = std::make_shared<TaskPool>();
+  task_pool->set_notifier(notifier);
 
-  auto file_editor = std::make_shared<FileEditor>(edit_window, extractor,
-                                                  background_task_message_window, runner_ptr);
+  // A gzip file is shown decompressed, from its start while the rest is decompressed
+  FileSourceOptions options = source_options;
+  std::shared_ptr<GzipIndex> gzip_index;
+  if (is_gzip) {
+    gzip_index = std::make_shared<GzipIndex>(fpath);
+    gzip_index->set_notifier(notifier);
+    options.gzip_index = gzip_index;
+  }
 
-  auto screen = ftxui::ScreenInteractive::Fullscreen();
+  // A followed file may be truncated, which faults reads of a mapping past its new end
+  if (follow) {
+    options.use_mmap = false;
+  }
 
-  auto loop = SynchroniseLoop(file_editor, DEFAULT_SYNCHRONISATION_DELAY);
+  auto extractor = std::make_shared<EditWindowExtractor>(fpath, options);
+  extractor->set_prefetcher(std::make_shared<LinePrefetcher>(fpath, options, task_pool));
 
-  // Start the synchronise thread and the background thread
-  auto synchronise_thread = std::thread([&loop] { loop.loop(); });
+  auto background_task_message_window = std::make_shared<BackgroundTaskMessageWindow>();
+
+  auto edit_window = std::make_shared<EditWindow>(extractor);
+
+  auto file_editor = std::make_shared<FileEditor>(
+      edit_window, extractor, background_task_message_window, task_pool, notifier);
+  if (gzip_index != nullptr) {
+    file_editor->start_decompression(gzip_index);
+  } else if (use_index_cache) {
+    file_editor->set_index_cache(std::make_unique<IndexCache>(fpath));
+  }
+  file_editor->set_following(follow);
+
+  auto screen = ftxui::ScreenInteractive::Fullscreen();
 
-  auto background_thread = std::thread([&runner_ptr] { runner_ptr->loop(); });
+  // Background tasks notify when their state changes, and the UI thread synchronises with them
+  // on the custom event. The thread sleeps while nothing happens.
+  auto synchronise_thread = std::thread([&notifier, &screen] {
+    get_tracer().set_thread_name("Synchronise");
+    notifier->run([&screen] {
+      TraceSpan span("post event");
+      screen.PostEvent(Event::Custom);
+    });
+  });
 
   // Start the ftxui loop
   screen.Loop(file_editor);
 
   // Wait for the children threads
+  notifier->stop();
   synchronise_thread.join();
 
-  background_thread.join();
+  // Cancels the running tasks and waits for them
+  task_pool->shutdown();
+
+  try {
+    file_editor->save_index_cache();
+  } catch (LFVException const&) {
+    // Without the cache, the next session only takes longer to index
+  }
+
+  if (!trace_fpath.empty()) {
+    get_tracer().write(trace_fpath);
+  }
 }
\ No newline at end of file
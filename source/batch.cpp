@@ -0,0 +1,341 @@
+#include <zlib.h>
+
+#include <LFV/batch.hpp>
+#include <LFV/file_extractor.hpp>
+#include <LFV/gzip_source.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/parallel_search.hpp>
+#include <LFV/regex.hpp>
+#include <LFV/search_stream.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+  // Matches spill to disk, so batch searches are not capped
+  constexpr int64_t MATCH_LIMIT = std::numeric_limits<int64_t>::max();
+  // Bytes of a range written at a time
+  constexpr std::streamoff CHUNK_BYTES = 1 << 20;
+
+  // Gathers small writes into large ones. Writes larger than half the buffer go out directly.
+  class OutputWriter {
+  public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    explicit OutputWriter(std::FILE* out) : m_out(out) { m_buffer.reserve(BUFFER_SIZE); }
+
+    void write(std::string_view data) {
+      if (m_buffer.size() + data.size() > BUFFER_SIZE) {
+        flush();
+      }
+
+      if (data.size() >= BUFFER_SIZE / 2) {
+        write_out(data);
+        return;
+      }
+
+      m_buffer.append(data);
+    }
+
+    // Writes the number and a newline
+    void write_line(uint64_t number) {
+      char digits[24];
+      char* first = std::end(digits);
+      *--first = '\n';
+      do {
+        *--first = static_cast<char>('0' + number % 10);
+        number /= 10;
+      } while (number != 0);
+
+      write(std::string_view(first, static_cast<size_t>(std::end(digits) - first)));
+    }
+
+    void flush() {
+      write_out(m_buffer);
+      m_buffer.clear();
+      if (std::fflush(m_out) != 0) {
+        throw LFVException("Cannot write the output");
+      }
+    }
+
+  private:
+    std::FILE* m_out;
+    std::string m_buffer;
+
+    void write_out(std::string_view data) {
+      if (!data.empty() && std::fwrite(data.data(), 1, data.size(), m_out) != data.size()) {
+        throw LFVException("Cannot write the output");
+      }
+    }
+  };
+
+  // A gzip file is decompressed once to index it, so that the search can read it in parallel
+  FileSourceOptions get_search_source_options(const std::string& fpath,
+                                             FileSourceOptions source_options) {
+    if (is_gzip_file(fpath)) {
+      auto gzip_index = std::make_shared<GzipIndex>(fpath);
+      std::atomic<bool> aborted = false;
+      gzip_index->build(aborted);
+      source_options.gzip_index = gzip_index;
+    }
+
+    return source_options;
+  }
+
+  // Calls on_data with the decompressed bytes of a gzip file from its start, a block at a time,
+  // until it returns false. No index is built, for commands that read the file once in order. A
+  // file cut short ends where its data does, as in the viewer.
+  template <typename OnData> void read_gzip(const std::string& fpath, OnData&& on_data) {
+    gzFile file = gzopen(fpath.c_str(), "rb");
+    if (file == nullptr) {
+      throw LFVException("Cannot open " + fpath);
+    }
+
+    std::string buffer(static_cast<size_t>(CHUNK_BYTES), '\0');
+    try {
+      while (true) {
+        int count = gzread(file, buffer.data(), static_cast<unsigned>(buffer.size()));
+        if (count < 0) {
+          int error = Z_OK;
+          gzerror(file, &error);
+          if (error == Z_BUF_ERROR) {
+            break;
+          }
+          throw LFVException("Corrupt gzip data in " + fpath);
+        }
+
+        if (count == 0 || !on_data(std::string_view(buffer.data(), static_cast<size_t>(count)))) {
+          break;
+        }
+      }
+    } catch (...) {
+      gzclose(file);
+      throw;
+    }
+
+    gzclose(file);
+  }
+
+  // Moves past up to num_lines newlines of data. Returns how many it passed.
+  std::streamoff skip_lines(std::string_view& data, std::streamoff num_lines) {
+    std::streamoff skipped = 0;
+    for (; skipped < num_lines; skipped++) {
+      size_t newline = data.find('\n');
+      if (newline == std::string_view::npos) {
+        data = data.substr(data.size());
+        break;
+      }
+
+      data.remove_prefix(newline + 1);
+    }
+
+    return skipped;
+  }
+
+  void write_gzip_lines(const std::string& fpath, std::streamoff first_line,
+                        std::optional<std::streamoff> last_line, OutputWriter& writer) {
+    // Newlines before the first line, and then to write
+    std::streamoff to_skip = first_line - 1;
+    std::optional<std::streamoff> to_write;
+    if (last_line) {
+      to_write = *last_line - first_line + 1;
+    }
+
+    read_gzip(fpath, [&](std::string_view data) {
+      to_skip -= skip_lines(data, to_skip);
+      if (to_skip > 0) {
+        return true;
+      }
+
+      if (!to_write) {
+        writer.write(data);
+        return true;
+      }
+
+      std::string_view rest = data;
+      *to_write -= skip_lines(rest, *to_write);
+      writer.write(data.substr(0, data.size() - rest.size()));
+      return *to_write > 0;
+    });
+  }
+
+  void write_gzip_slice(const std::string& fpath, std::streamoff offset, std::streamoff length,
+                        OutputWriter& writer) {
+    read_gzip(fpath, [&](std::string_view data) {
+      const auto size = static_cast<std::streamoff>(data.size());
+      const std::streamoff skipped = std::min(offset, size);
+      data.remove_prefix(static_cast<size_t>(skipped));
+      offset -= skipped;
+
+      const std::streamoff taken = std::min(length, size - skipped);
+      writer.write(data.substr(0, static_cast<size_t>(taken)));
+      length -= taken;
+      return length > 0;
+    });
+  }
+
+  void write_range(FileExtractor& extractor, std::streamoff begin, std::streamoff end,
+                   OutputWriter& writer) {
+    end = std::min<std::streamoff>(end, extractor.get_end());
+    for (std::streamoff pos = std::max<std::streamoff>(begin, 0); pos < end;) {
+      std::string_view data = extractor.view(pos, std::min(pos + CHUNK_BYTES, end));
+      if (data.empty()) {
+        // The file was truncated
+        break;
+      }
+
+      writer.write(data);
+      pos += static_cast<std::streamoff>(data.size());
+    }
+  }
+
+  // Where the line, counting from 0, begins. The saved index, if it covers the line, is used to
+  // skip to the checkpoint before it.
+  std::streamoff find_line_begin(const std::string& fpath, FileExtractor& extractor,
+                                 std::streamoff line, const std::string& index_cache_dir) {
+    if (line == 0) {
+      return 0;
+    }
+
+    if (!index_cache_dir.empty()) {
+      if (auto state = IndexCache(fpath, index_cache_dir).load(); state) {
+        if (auto line_begin = state->line_index->get_line_begin(extractor, line); line_begin) {
+          return *line_begin;
+        }
+      }
+    }
+
+    std::streamoff newline = extractor.find_nth('\n', 0, line);
+    return newline == -1 ? -1 : newline + 1;
+  }
+}  // namespace
+
+int64_t run_batch_search(const std::string& fpath, const FileSourceOptions& source_options,
+                         const BatchSearch& search, std::FILE* out) {
+  const FileSourceOptions options = get_search_source_options(fpath, source_options);
+  // The file is only opened for its end when no end is given
+  const std::streamoff end
+      = search.to ? *search.to : std::streamoff(FileExtractor(fpath, options).get_end());
+
+  std::shared_ptr<const Regex> regex;
+  if (search.regex) {
+    regex = std::make_shared<const Regex>(search.pattern);
+  }
+
+  auto result = std::make_shared<SearchResult>(nullptr, search.count_only);
+  auto aborted = std::make_shared<std::atomic<bool>>(false);
+  std::atomic<bool> done = false;
+  std::exception_ptr error;
+
+  std::thread searcher([&] {
+    try {
+      if (regex != nullptr) {
+        search_regex_in_file(fpath, *regex, search.from, end, MATCH_LIMIT, result, aborted,
+                             options);
+      } else {
+        search_in_file_parallel(fpath, search.pattern, search.from, end, MATCH_LIMIT, result,
+                                aborted, search.jobs, DEFAULT_SEARCH_CHUNK_SIZE, options);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    done = true;
+  });
+
+  // Matches are printed as they are published, while the search goes on
+  OutputWriter writer(out);
+  try {
+    int64_t num_written = 0;
+    while (true) {
+      const bool finished = done;
+      const int64_t num_matches = result->get_num_matches();
+      for (; num_written < num_matches; num_written++) {
+        writer.write_line(static_cast<uint64_t>(std::streamoff(result->get_match(num_written))));
+      }
+
+      if (finished) {
+        break;
+      }
+
+      if (num_written == num_matches) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+
+    if (search.count_only) {
+      writer.write_line(static_cast<uint64_t>(result->get_num_found()));
+    }
+    writer.flush();
+  } catch (...) {
+    *aborted = true;
+    searcher.join();
+    throw;
+  }
+
+  searcher.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  return result->get_num_found();
+}
+
+void run_batch_lines(const std::string& fpath, const FileSourceOptions& source_options,
+                     std::streamoff first_line, std::optional<std::streamoff> last_line,
+                     std::FILE* out, const std::string& index_cache_dir) {
+  if (first_line < 1 || (last_line && *last_line < first_line)) {
+    throw LFVException("Invalid line range");
+  }
+
+  // A gzip file is read once up to the last line, and not cached by the viewer
+  if (is_gzip_file(fpath)) {
+    OutputWriter writer(out);
+    write_gzip_lines(fpath, first_line, last_line, writer);
+    writer.flush();
+    return;
+  }
+
+  FileExtractor extractor(fpath, source_options);
+  std::streamoff begin = find_line_begin(fpath, extractor, first_line - 1, index_cache_dir);
+  if (begin == -1 || begin >= extractor.get_end()) {
+    return;
+  }
+
+  std::streamoff end = extractor.get_end();
+  if (last_line) {
+    std::streamoff last_newline = extractor.find_nth('\n', begin, *last_line - first_line + 1);
+    if (last_newline != -1) {
+      end = last_newline + 1;
+    }
+  }
+
+  OutputWriter writer(out);
+  write_range(extractor, begin, end, writer);
+  writer.flush();
+}
+
+void run_batch_slice(const std::string& fpath, const FileSourceOptions& source_options,
+                     std::streamoff offset, std::streamoff length, std::FILE* out) {
+  if (offset < 0 || length < 0) {
+    throw LFVException("Invalid range");
+  }
+
+  OutputWriter writer(out);
+  if (is_gzip_file(fpath)) {
+    write_gzip_slice(fpath, offset, length, writer);
+    writer.flush();
+    return;
+  }
+
+  FileExtractor extractor(fpath, source_options);
+  write_range(extractor, offset, offset + std::min<std::streamoff>(length, extractor.get_end()),
+              writer);
+  writer.flush();
+}
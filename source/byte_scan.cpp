@@ -0,0 +1,204 @@
+#include <LFV/byte_scan.hpp>
+#include <LFV/simd.hpp>
+#include <cstdint>
+
+namespace {
+  const char* find_first_scalar(const char* first, const char* last, char target) {
+    for (; first < last; first++) {
+      if (*first == target) {
+        return first;
+      }
+    }
+
+    return nullptr;
+  }
+
+  const char* find_last_scalar(const char* first, const char* last, char target) {
+    while (last > first) {
+      last--;
+      if (*last == target) {
+        return last;
+      }
+    }
+
+    return nullptr;
+  }
+
+  size_t count_scalar(const char* first, const char* last, char target) {
+    size_t count = 0;
+    for (; first < last; first++) {
+      count += static_cast<size_t>(*first == target);
+    }
+
+    return count;
+  }
+
+#ifdef LFV_HAS_X86_SIMD
+  // NOLINTBEGIN
+  int lowest_bit(uint32_t mask) { return __builtin_ctz(mask); }
+
+  int highest_bit(uint32_t mask) { return 31 - __builtin_clz(mask); }
+
+  const char* find_first_sse2(const char* first, const char* last, char target) {
+    const __m128i needle = _mm_set1_epi8(target);
+
+    for (; last - first >= 16; first += 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+      auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+      if (mask != 0) {
+        return first + lowest_bit(mask);
+      }
+    }
+
+    return find_first_scalar(first, last, target);
+  }
+
+  const char* find_last_sse2(const char* first, const char* last, char target) {
+    const __m128i needle = _mm_set1_epi8(target);
+
+    for (; last - first >= 16; last -= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(last - 16));
+      auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+      if (mask != 0) {
+        return last - 16 + highest_bit(mask);
+      }
+    }
+
+    return find_last_scalar(first, last, target);
+  }
+
+  // Equal bytes compare to -1, so subtracting the comparison counts matches in each byte lane.
+  // The lanes are flushed into 64-bit sums before they can overflow.
+  size_t count_sse2(const char* first, const char* last, char target) {
+    const __m128i needle = _mm_set1_epi8(target);
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+
+    while (last - first >= 16) {
+      __m128i lanes = zero;
+      for (int i = 0; i < 255 && last - first >= 16; i++, first += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, needle));
+      }
+
+      __m128i sums = _mm_sad_epu8(lanes, zero);
+      count += static_cast<size_t>(_mm_cvtsi128_si64(sums))
+               + static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums)));
+    }
+
+    return count + count_scalar(first, last, target);
+  }
+
+  LFV_TARGET_AVX2 const char* find_first_avx2(const char* first, const char* last, char target) {
+    const __m256i needle = _mm256_set1_epi8(target);
+
+    // Two vectors per iteration so that the loop is bound by loads rather than branches
+    for (; last - first >= 64; first += 64) {
+      __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+      __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + 32));
+      __m256i lo_eq = _mm256_cmpeq_epi8(lo, needle);
+      __m256i hi_eq = _mm256_cmpeq_epi8(hi, needle);
+      __m256i any_eq = _mm256_or_si256(lo_eq, hi_eq);
+
+      if (_mm256_testz_si256(any_eq, any_eq) == 0) {
+        auto lo_mask = static_cast<uint32_t>(_mm256_movemask_epi8(lo_eq));
+        if (lo_mask != 0) {
+          return first + lowest_bit(lo_mask);
+        }
+
+        return first + 32 + lowest_bit(static_cast<uint32_t>(_mm256_movemask_epi8(hi_eq)));
+      }
+    }
+
+    for (; last - first >= 32; first += 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+      if (mask != 0) {
+        return first + lowest_bit(mask);
+      }
+    }
+
+    return find_first_sse2(first, last, target);
+  }
+
+  LFV_TARGET_AVX2 const char* find_last_avx2(const char* first, const char* last, char target) {
+    const __m256i needle = _mm256_set1_epi8(target);
+
+    for (; last - first >= 64; last -= 64) {
+      __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last - 64));
+      __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last - 32));
+      __m256i lo_eq = _mm256_cmpeq_epi8(lo, needle);
+      __m256i hi_eq = _mm256_cmpeq_epi8(hi, needle);
+      __m256i any_eq = _mm256_or_si256(lo_eq, hi_eq);
+
+      if (_mm256_testz_si256(any_eq, any_eq) == 0) {
+        auto hi_mask = static_cast<uint32_t>(_mm256_movemask_epi8(hi_eq));
+        if (hi_mask != 0) {
+          return last - 32 + highest_bit(hi_mask);
+        }
+
+        return last - 64 + highest_bit(static_cast<uint32_t>(_mm256_movemask_epi8(lo_eq)));
+      }
+    }
+
+    for (; last - first >= 32; last -= 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last - 32));
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+      if (mask != 0) {
+        return last - 32 + highest_bit(mask);
+      }
+    }
+
+    return find_last_sse2(first, last, target);
+  }
+
+  LFV_TARGET_AVX2 size_t count_avx2(const char* first, const char* last, char target) {
+    const __m256i needle = _mm256_set1_epi8(target);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+
+    while (last - first >= 32) {
+      __m256i lanes = zero;
+      for (int i = 0; i < 255 && last - first >= 32; i++, first += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(block, needle));
+      }
+
+      __m256i sums = _mm256_sad_epu8(lanes, zero);
+      count += static_cast<size_t>(_mm256_extract_epi64(sums, 0))
+               + static_cast<size_t>(_mm256_extract_epi64(sums, 1))
+               + static_cast<size_t>(_mm256_extract_epi64(sums, 2))
+               + static_cast<size_t>(_mm256_extract_epi64(sums, 3));
+    }
+
+    return count + count_sse2(first, last, target);
+  }
+  // NOLINTEND
+#endif
+
+  std::vector<ByteScanKernel> detect_kernels() {
+    std::vector<ByteScanKernel> kernels{
+        {"scalar", find_first_scalar, find_last_scalar, count_scalar}};
+
+#ifdef LFV_HAS_X86_SIMD
+    // SSE2 is part of x86-64
+    kernels.push_back({"sse2", find_first_sse2, find_last_sse2, count_sse2});
+
+    if (__builtin_cpu_supports("avx2")) {
+      kernels.push_back({"avx2", find_first_avx2, find_last_avx2, count_avx2});
+    }
+#endif
+
+    return kernels;
+  }
+}  // namespace
+
+const std::vector<ByteScanKernel>& available_byte_scan_kernels() {
+  static const std::vector<ByteScanKernel> kernels = detect_kernels();
+  return kernels;
+}
+
+const ByteScanKernel& byte_scan_kernel() {
+  static const ByteScanKernel& kernel = available_byte_scan_kernels().back();
+  return kernel;
+}
@@ -0,0 +1,51 @@
+#include <LFV/change_notifier.hpp>
+#include <algorithm>
+
+ChangeNotifier::ChangeNotifier(int32_t max_rate)
+    : m_min_interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::seconds(1))
+                     / std::max(max_rate, 1)) {}
+
+void ChangeNotifier::notify() {
+  // Cheap when the consumer has not caught up yet
+  if (m_pending.load(std::memory_order_relaxed) || m_pending.exchange(true)) {
+    return;
+  }
+
+  // Locking orders the flag with the consumer's check before it waits
+  { std::scoped_lock<std::mutex> lock(m_mutex); }
+  m_cv.notify_one();
+}
+
+void ChangeNotifier::run(const std::function<void()>& on_change) {
+  auto last_delivery = std::chrono::steady_clock::now() - m_min_interval;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [this] { return m_stopped || m_pending; });
+
+    // Let more changes pile up until the next delivery is due
+    m_cv.wait_until(lock, last_delivery + m_min_interval, [this] { return m_stopped; });
+    if (m_stopped) {
+      return;
+    }
+
+    // Changes after this point are caught by the next round
+    m_pending = false;
+    lock.unlock();
+
+    on_change();
+    m_num_deliveries++;
+    last_delivery = std::chrono::steady_clock::now();
+
+    lock.lock();
+  }
+}
+
+void ChangeNotifier::stop() {
+  {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_stopped = true;
+  }
+  m_cv.notify_all();
+}
@@ -0,0 +1,280 @@
+#include <LFV/file_source.hpp>
+#include <LFV/gzip_source.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/perf_stats.hpp>
+#include <LFV/tracer.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define LFV_HAS_MMAP 1
+#  define LFV_HAS_PREAD 1
+#endif
+
+MappedFileSource::MappedFileSource(const std::string& fpath) {
+#ifdef LFV_HAS_MMAP
+  // The descriptor is kept to map the file again when it grows
+  m_fd = open(fpath.c_str(), O_RDONLY);
+  if (m_fd == -1) {
+    throw LFVException("Cannot open " + fpath);
+  }
+
+  struct stat st {};
+  if (fstat(m_fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    // Empty files and special files cannot be mapped
+    close(m_fd);
+    throw LFVException("Cannot map " + fpath);
+  }
+
+  void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if (addr == MAP_FAILED) {
+    close(m_fd);
+    throw LFVException("Cannot map " + fpath);
+  }
+
+  m_data = static_cast<const char*>(addr);
+  m_size = static_cast<std::streamoff>(st.st_size);
+#else
+  throw LFVException("Memory mapping is not supported on this platform: " + fpath);
+#endif
+}
+
+MappedFileSource::~MappedFileSource() {
+#ifdef LFV_HAS_MMAP
+  munmap(const_cast<char*>(m_data), static_cast<size_t>(m_size));  // NOLINT
+  close(m_fd);
+#endif
+}
+
+std::streamoff MappedFileSource::refresh() {
+#ifdef LFV_HAS_MMAP
+  struct stat st {};
+  if (fstat(m_fd, &st) == -1 || static_cast<std::streamoff>(st.st_size) <= m_size) {
+    return m_size;
+  }
+
+  void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if (addr == MAP_FAILED) {
+    throw LFVException("Cannot map the grown file");
+  }
+
+  munmap(const_cast<char*>(m_data), static_cast<size_t>(m_size));  // NOLINT
+  m_data = static_cast<const char*>(addr);
+  m_size = static_cast<std::streamoff>(st.st_size);
+#endif
+  return m_size;
+}
+
+StreamFileSource::StreamFileSource(const std::string& fpath) {
+  // Open with exception thrown if fail
+  m_in.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  m_in.open(fpath, std::ios_base::binary);
+
+  m_in.seekg(0, std::ios_base::end);
+  m_end = m_in.tellg();
+  m_in.seekg(0, std::ios_base::beg);
+
+  // Reads near the end are allowed to come up short
+  m_in.exceptions(std::ifstream::badbit);
+}
+
+FileBlock StreamFileSource::fetch(std::streamoff pos) {
+  std::streamoff block_begin = pos - pos % BLOCK_SIZE;
+
+  if (block_begin != m_block_begin) {
+    ScopedTimer timer(get_perf_stats().page_reads);
+    TraceSpan span("page read");
+    auto block_size = static_cast<size_t>(std::min(BLOCK_SIZE, m_end - block_begin));
+
+    m_block.resize(block_size);
+    m_in.clear();
+    m_in.seekg(block_begin);
+    m_in.read(m_block.data(), static_cast<std::streamsize>(block_size));
+    m_block.resize(static_cast<size_t>(m_in.gcount()));
+    get_perf_stats().page_read_bytes.fetch_add(m_block.size(), std::memory_order_relaxed);
+
+    // A block read short, as from a file truncated under us, is read again next time
+    m_block_begin = m_block.size() == block_size ? block_begin : -1;
+    return {block_begin, m_block};
+  }
+
+  return {m_block_begin, m_block};
+}
+
+std::streamoff StreamFileSource::refresh() {
+  m_in.clear();
+  m_in.seekg(0, std::ios_base::end);
+  std::streamoff end = m_in.tellg();
+
+  if (end > m_end) {
+    m_end = end;
+    // The block holding the old end may have been read short
+    m_block_begin = -1;
+  }
+
+  return m_end;
+}
+
+PageCache::PageCache(size_t capacity) : m_capacity(std::max<size_t>(capacity, 1)) {}
+
+const std::string* PageCache::find(std::streamoff begin) {
+  auto it = m_page_index.find(begin);
+  if (it == m_page_index.end()) {
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+
+  // Move to the front of the LRU list
+  m_pages.splice(m_pages.begin(), m_pages, it->second);
+  return &m_pages.front().data;
+}
+
+std::string& PageCache::insert(std::streamoff begin) {
+  if (auto it = m_page_index.find(begin); it != m_page_index.end()) {
+    m_pages.splice(m_pages.begin(), m_pages, it->second);
+    return m_pages.front().data;
+  }
+
+  if (m_pages.size() < m_capacity) {
+    m_pages.emplace_front();
+  } else {
+    // Recycle the least recently used page and its buffer
+    m_page_index.erase(m_pages.back().begin);
+    m_pages.splice(m_pages.begin(), m_pages, std::prev(m_pages.end()));
+  }
+
+  Page& page = m_pages.front();
+  page.begin = begin;
+  m_page_index[begin] = m_pages.begin();
+  return page.data;
+}
+
+void PageCache::erase(std::streamoff begin) {
+  if (auto it = m_page_index.find(begin); it != m_page_index.end()) {
+    m_pages.erase(it->second);
+    m_page_index.erase(it);
+  }
+}
+
+PagedFileSource::PagedFileSource(const std::string& fpath, size_t page_size, size_t cache_pages)
+    : m_page_size(static_cast<std::streamoff>(std::max<size_t>(page_size, 1))),
+      m_cache(cache_pages) {
+#ifdef LFV_HAS_PREAD
+  m_fd = open(fpath.c_str(), O_RDONLY);
+  if (m_fd == -1) {
+    throw LFVException("Cannot open " + fpath);
+  }
+
+  struct stat st {};
+  if (fstat(m_fd, &st) == -1) {
+    close(m_fd);
+    throw LFVException("Cannot stat " + fpath);
+  }
+
+  m_end = static_cast<std::streamoff>(st.st_size);
+#else
+  throw LFVException("pread is not supported on this platform: " + fpath);
+#endif
+}
+
+PagedFileSource::~PagedFileSource() {
+#ifdef LFV_HAS_PREAD
+  close(m_fd);
+#endif
+}
+
+std::streamoff PagedFileSource::refresh() {
+#ifdef LFV_HAS_PREAD
+  struct stat st {};
+  if (fstat(m_fd, &st) == -1 || static_cast<std::streamoff>(st.st_size) <= m_end) {
+    return m_end;
+  }
+
+  if (m_end > 0) {
+    m_cache.erase((m_end - 1) / m_page_size * m_page_size);
+  }
+
+  m_end = static_cast<std::streamoff>(st.st_size);
+#endif
+  return m_end;
+}
+
+FileBlock PagedFileSource::fetch(std::streamoff pos) {
+  std::streamoff page_begin = pos - pos % m_page_size;
+
+  if (const std::string* data = m_cache.find(page_begin); data != nullptr) {
+    return {page_begin, *data};
+  }
+
+  ScopedTimer timer(get_perf_stats().page_reads);
+  TraceSpan span("page read");
+  std::string& data = m_cache.insert(page_begin);
+  load_page(data, page_begin);
+  get_perf_stats().page_read_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+
+  if (static_cast<std::streamoff>(data.size()) < std::min(m_page_size, m_end - page_begin)) {
+    // The file was truncated under us
+    std::swap(m_short_page, data);
+    m_cache.erase(page_begin);
+    return {page_begin, m_short_page};
+  }
+
+  return {page_begin, data};
+}
+
+void PagedFileSource::load_page(std::string& data, std::streamoff begin) {
+  data.resize(static_cast<size_t>(std::min(m_page_size, m_end - begin)));
+
+#ifdef LFV_HAS_PREAD
+  size_t loaded = 0;
+  while (loaded < data.size()) {
+    ssize_t count = pread(m_fd, data.data() + loaded, data.size() - loaded,
+                          static_cast<off_t>(begin + static_cast<std::streamoff>(loaded)));
+    if (count == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (count == -1) {
+      throw LFVException("Cannot read page at " + std::to_string(begin));
+    }
+
+    if (count == 0) {
+      // The file was truncated under us
+      break;
+    }
+
+    loaded += static_cast<size_t>(count);
+  }
+
+  data.resize(loaded);
+#endif
+}
+
+std::unique_ptr<FileSource> open_file_source(const std::string& fpath,
+                                             const FileSourceOptions& options) {
+  if (options.gzip_index != nullptr) {
+    return std::make_unique<GzipFileSource>(options.gzip_index, options.page_size,
+                                            options.cache_pages);
+  }
+
+  if (options.use_mmap) {
+    try {
+      return std::make_unique<MappedFileSource>(fpath);
+    } catch (LFVException const&) {
+      // Fall through to the page cache
+    }
+  }
+
+#ifdef LFV_HAS_PREAD
+  return std::make_unique<PagedFileSource>(fpath, options.page_size, options.cache_pages);
+#else
+  return std::make_unique<StreamFileSource>(fpath);
+#endif
+}
@@ -0,0 +1,137 @@
+#include <LFV/file_watcher.hpp>
+#include <filesystem>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/stat.h>
+#  define LFV_HAS_STAT 1
+#endif
+
+#ifdef __linux__
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#  include <array>
+#  include <cerrno>
+#  define LFV_HAS_INOTIFY 1
+#endif
+
+std::optional<FileStatus> stat_file(const std::string& fpath) {
+#ifdef LFV_HAS_STAT
+  struct stat st {};
+  if (stat(fpath.c_str(), &st) == -1) {
+    return std::nullopt;
+  }
+
+  return FileStatus{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+                    static_cast<std::streamoff>(st.st_size), static_cast<int64_t>(st.st_mtime)};
+#else
+  std::error_code error;
+  auto size = std::filesystem::file_size(fpath, error);
+  if (error) {
+    return std::nullopt;
+  }
+
+  auto modified = std::filesystem::last_write_time(fpath, error);
+  return FileStatus{0, 0, static_cast<std::streamoff>(size),
+                    static_cast<int64_t>(modified.time_since_epoch().count())};
+#endif
+}
+
+FileWatcher::FileWatcher(std::string fpath, std::shared_ptr<ChangeNotifier> notifier)
+    : m_fpath(std::move(fpath)), m_notifier(std::move(notifier)), m_status(stat_file(m_fpath)) {
+#ifdef LFV_HAS_INOTIFY
+  std::filesystem::path path(m_fpath);
+  std::string dir = path.has_parent_path() ? path.parent_path().string() : ".";
+
+  m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotify_fd != -1 && pipe(m_stop_pipe) == -1) {
+    close(m_inotify_fd);
+    m_inotify_fd = -1;
+  }
+
+  constexpr uint32_t EVENTS = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+                              | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+  if (m_inotify_fd != -1 && inotify_add_watch(m_inotify_fd, dir.c_str(), EVENTS) == -1) {
+    // Polling still works
+    close(m_inotify_fd);
+    close(m_stop_pipe[0]);
+    close(m_stop_pipe[1]);
+    m_inotify_fd = -1;
+  }
+#endif
+
+  m_thread = std::thread([this] { run(); });
+}
+
+FileWatcher::~FileWatcher() {
+  {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_stopped = true;
+  }
+  m_cv.notify_all();
+
+#ifdef LFV_HAS_INOTIFY
+  if (m_inotify_fd != -1) {
+    char byte = 0;
+    [[maybe_unused]] auto written = write(m_stop_pipe[1], &byte, 1);
+  }
+#endif
+
+  m_thread.join();
+
+#ifdef LFV_HAS_INOTIFY
+  if (m_inotify_fd != -1) {
+    close(m_inotify_fd);
+    close(m_stop_pipe[0]);
+    close(m_stop_pipe[1]);
+  }
+#endif
+}
+
+void FileWatcher::run() {
+  while (wait_for_event()) {
+    check_status();
+  }
+}
+
+bool FileWatcher::wait_for_event() {
+#ifdef LFV_HAS_INOTIFY
+  if (m_inotify_fd != -1) {
+    std::array<pollfd, 2> fds{{{m_inotify_fd, POLLIN, 0}, {m_stop_pipe[0], POLLIN, 0}}};
+    if (poll(fds.data(), fds.size(), static_cast<int>(POLL_INTERVAL.count())) == -1
+        && errno != EINTR) {
+      return false;
+    }
+
+    if (fds[1].revents != 0) {
+      return false;
+    }
+
+    // Events only wake the thread up: the status check tells whether the file changed, so an
+    // event about another file of the directory costs a stat at most
+    std::array<char, 4096> buffer{};
+    while (read(m_inotify_fd, buffer.data(), buffer.size()) > 0) {
+    }
+
+    return true;
+  }
+#endif
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return !m_cv.wait_for(lock, POLL_INTERVAL, [this] { return m_stopped; });
+}
+
+void FileWatcher::check_status() {
+  // Several events for one write, or events about other files, leave the status as it was
+  auto status = stat_file(m_fpath);
+  if (status == m_status) {
+    return;
+  }
+
+  m_status = status;
+  m_generation++;
+  if (m_notifier != nullptr) {
+    m_notifier->notify();
+  }
+}
@@ -0,0 +1,430 @@
+#include <zlib.h>
+
+#include <LFV/gzip_source.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/perf_stats.hpp>
+#include <LFV/tracer.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+  // Accepts gzip and zlib headers alike
+  constexpr int AUTO_HEADER_WINDOW_BITS = MAX_WBITS + 32;
+  constexpr int RAW_WINDOW_BITS = -MAX_WBITS;
+
+  constexpr size_t INPUT_BUFFER_SIZE = 1 << 16;
+
+  std::string deflate_window(const std::string& window) {
+    uLongf size = compressBound(static_cast<uLong>(window.size()));
+    std::string deflated(size, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(deflated.data()), &size,
+                  reinterpret_cast<const Bytef*>(window.data()), static_cast<uLong>(window.size()),
+                  Z_BEST_SPEED)
+        != Z_OK) {
+      throw LFVException("Cannot compress a gzip index window");
+    }
+
+    deflated.resize(size);
+    return deflated;
+  }
+
+  std::string inflate_window(const std::string& deflated) {
+    uLongf size = GzipIndex::WINDOW_SIZE;
+    std::string window(size, '\0');
+    if (uncompress(reinterpret_cast<Bytef*>(window.data()), &size,
+                   reinterpret_cast<const Bytef*>(deflated.data()),
+                   static_cast<uLong>(deflated.size()))
+        != Z_OK) {
+      throw LFVException("Corrupt gzip index window");
+    }
+
+    window.resize(size);
+    return window;
+  }
+}  // namespace
+
+// Inflates a file from a checkpoint on, through members one after another
+class GzipInflater {
+public:
+  explicit GzipInflater(const std::string& fpath) : m_in(fpath, std::ios::binary) {
+    if (!m_in) {
+      throw LFVException("Cannot open " + fpath);
+    }
+
+    if (inflateInit2(&m_strm, AUTO_HEADER_WINDOW_BITS) != Z_OK) {
+      throw LFVException("Cannot initialise zlib");
+    }
+  }
+
+  GzipInflater(const GzipInflater&) = delete;
+  GzipInflater& operator=(const GzipInflater&) = delete;
+
+  ~GzipInflater() { inflateEnd(&m_strm); }
+
+  void start(const GzipIndex::Checkpoint& checkpoint) {
+    m_strm.avail_in = 0;
+    m_finished = false;
+    m_member_ended = false;
+    m_out_pos = checkpoint.out_pos;
+
+    if (checkpoint.in_pos == 0) {
+      seek(0);
+      m_raw = false;
+      inflateReset2(&m_strm, AUTO_HEADER_WINDOW_BITS);
+      return;
+    }
+
+    // The middle of a member has no header: the rest of it is read as raw deflate data
+    seek(checkpoint.in_pos - (checkpoint.bits != 0 ? 1 : 0));
+    m_raw = true;
+    inflateReset2(&m_strm, RAW_WINDOW_BITS);
+
+    if (checkpoint.bits != 0) {
+      if (!fill_input(1)) {
+        throw LFVException("Gzip file shrank under its index");
+      }
+
+      int byte = *m_strm.next_in;
+      m_strm.next_in++;
+      m_strm.avail_in--;
+      inflatePrime(&m_strm, checkpoint.bits, byte >> (8 - checkpoint.bits));
+    }
+
+    std::string window = inflate_window(checkpoint.window);
+    inflateSetDictionary(&m_strm, reinterpret_cast<const Bytef*>(window.data()),
+                         static_cast<uInt>(window.size()));
+  }
+
+  // Inflates up to size bytes into out, and returns how many. Stops early at the end of a member,
+  // and with Z_BLOCK, at the end of every deflate block.
+  size_t read(char* out, size_t size, int flush = Z_NO_FLUSH) {
+    m_member_ended = false;
+    m_strm.next_out = reinterpret_cast<Bytef*>(out);
+    m_strm.avail_out = static_cast<uInt>(size);
+
+    while (m_strm.avail_out > 0 && !m_finished) {
+      if (m_strm.avail_in == 0 && !fill_input(1)) {
+        // The file is cut short
+        m_finished = true;
+        break;
+      }
+
+      int ret = inflate(&m_strm, flush);
+      if (ret == Z_STREAM_END) {
+        next_member();
+        m_member_ended = true;
+        break;
+      }
+
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        throw LFVException("Corrupt gzip data around byte " + std::to_string(get_in_pos()));
+      }
+
+      if (flush == Z_BLOCK) {
+        break;
+      }
+    }
+
+    size_t produced = size - m_strm.avail_out;
+    m_out_pos += static_cast<std::streamoff>(produced);
+    return produced;
+  }
+
+  // Reads size bytes unless the data ends first
+  size_t read_fully(char* out, size_t size) {
+    size_t produced = 0;
+    while (produced < size && !m_finished) {
+      produced += read(out + produced, size - produced);
+    }
+
+    return produced;
+  }
+
+  bool is_finished() const { return m_finished; }
+
+  // Whether the last read stopped between two deflate blocks of a member, where a checkpoint can
+  // be saved
+  bool is_at_block_boundary() const {
+    return !m_finished && !m_member_ended && (m_strm.data_type & 128) != 0
+           && (m_strm.data_type & 64) == 0;
+  }
+
+  std::streamoff get_out_pos() const { return m_out_pos; }
+
+  std::streamoff get_in_pos() const {
+    return m_read_pos - static_cast<std::streamoff>(m_strm.avail_in);
+  }
+
+  int get_bits() const { return m_strm.data_type & 7; }
+
+private:
+  std::ifstream m_in;
+  std::string m_input = std::string(INPUT_BUFFER_SIZE, '\0');
+  z_stream m_strm{};
+  // Reading the rest of a member from a checkpoint, without its header
+  bool m_raw = false;
+  bool m_finished = false;
+  bool m_member_ended = false;
+  // Bytes of the file read into the input buffer so far
+  std::streamoff m_read_pos = 0;
+  std::streamoff m_out_pos = 0;
+
+  void seek(std::streamoff pos) {
+    m_in.clear();
+    m_in.seekg(pos);
+    m_read_pos = pos;
+  }
+
+  // Returns whether at least count bytes of input are available
+  bool fill_input(size_t count) {
+    if (m_strm.avail_in >= count) {
+      return true;
+    }
+
+    size_t kept = m_strm.avail_in;
+    if (kept > 0) {
+      std::memmove(m_input.data(), m_strm.next_in, kept);
+    }
+
+    m_in.read(m_input.data() + kept, static_cast<std::streamsize>(m_input.size() - kept));
+    auto count_read = static_cast<size_t>(m_in.gcount());
+    m_read_pos += static_cast<std::streamoff>(count_read);
+
+    m_strm.next_in = reinterpret_cast<Bytef*>(m_input.data());
+    m_strm.avail_in = static_cast<uInt>(kept + count_read);
+    return m_strm.avail_in >= count;
+  }
+
+  void skip_input(size_t count) {
+    while (count > 0 && (m_strm.avail_in > 0 || fill_input(1))) {
+      size_t skipped = std::min<size_t>(count, m_strm.avail_in);
+      m_strm.next_in += skipped;
+      m_strm.avail_in -= static_cast<uInt>(skipped);
+      count -= skipped;
+    }
+  }
+
+  void next_member() {
+    if (m_raw) {
+      // Raw inflation stops before the trailer of CRC and size
+      skip_input(8);
+    }
+
+    // Another member may follow, as in files made by concatenation
+    if (!fill_input(2) || m_strm.next_in[0] != 0x1f || m_strm.next_in[1] != 0x8b) {
+      m_finished = true;
+      return;
+    }
+
+    m_raw = false;
+    inflateReset2(&m_strm, AUTO_HEADER_WINDOW_BITS);
+  }
+};
+
+bool is_gzip_file(const std::string& fpath) {
+  std::ifstream in(fpath, std::ios::binary);
+  char magic[2] = {};
+  return in.read(magic, 2) && static_cast<unsigned char>(magic[0]) == 0x1f
+         && static_cast<unsigned char>(magic[1]) == 0x8b;
+}
+
+GzipIndex::GzipIndex(std::string fpath, std::streamoff span)
+    : m_fpath(std::move(fpath)), m_span(std::max<std::streamoff>(span, 1)), m_checkpoints(1) {}
+
+void GzipIndex::build(const std::atomic<bool>& aborted) {
+  // Progress is published at least once per step
+  constexpr std::streamoff STEP = 1 << 20;
+
+  set_status(BackgroundTaskStatus::ONGOING);
+
+  try {
+    GzipInflater inflater(m_fpath);
+    inflater.start(Checkpoint{});
+
+    // The output goes round a circular window, which always holds the last WINDOW_SIZE bytes
+    std::string window(WINDOW_SIZE, '\0');
+    size_t window_pos = 0;
+    std::streamoff last_checkpoint = 0;
+    std::streamoff last_notified = 0;
+
+    while (!inflater.is_finished()) {
+      if (aborted) {
+        set_status(BackgroundTaskStatus::ABORTED);
+        return;
+      }
+
+      window_pos += inflater.read(window.data() + window_pos, WINDOW_SIZE - window_pos, Z_BLOCK);
+      window_pos %= WINDOW_SIZE;
+
+      std::streamoff out_pos = inflater.get_out_pos();
+      if (inflater.is_at_block_boundary() && out_pos - last_checkpoint >= m_span) {
+        // Oldest bytes first. Before WINDOW_SIZE bytes of output, the zeros in front are never
+        // referred to.
+        std::string ordered = window.substr(window_pos) + window.substr(0, window_pos);
+        Checkpoint checkpoint{out_pos, inflater.get_in_pos(), inflater.get_bits(),
+                              deflate_window(ordered)};
+        {
+          const std::scoped_lock<std::mutex> lock(m_mutex);
+          m_checkpoints.push_back(std::move(checkpoint));
+        }
+
+        last_checkpoint = out_pos;
+      }
+
+      m_end.store(out_pos, std::memory_order_release);
+      if (out_pos - last_notified >= STEP) {
+        last_notified = out_pos;
+        notify();
+      }
+    }
+  } catch (const LFVException&) {
+    set_status(BackgroundTaskStatus::ABORTED);
+    throw;
+  }
+
+  set_status(BackgroundTaskStatus::FINISHED);
+}
+
+size_t GzipIndex::get_num_checkpoints() const {
+  const std::scoped_lock<std::mutex> lock(m_mutex);
+  return m_checkpoints.size();
+}
+
+GzipIndex::Checkpoint GzipIndex::get_checkpoint_before(std::streamoff pos) const {
+  const std::scoped_lock<std::mutex> lock(m_mutex);
+  auto it = std::upper_bound(
+      m_checkpoints.begin(), m_checkpoints.end(), pos,
+      [](std::streamoff pos, const Checkpoint& checkpoint) { return pos < checkpoint.out_pos; });
+  return *std::prev(it);
+}
+
+std::streamoff GzipIndex::get_checkpoint_pos_before(std::streamoff pos) const {
+  const std::scoped_lock<std::mutex> lock(m_mutex);
+  auto it = std::upper_bound(
+      m_checkpoints.begin(), m_checkpoints.end(), pos,
+      [](std::streamoff pos, const Checkpoint& checkpoint) { return pos < checkpoint.out_pos; });
+  return std::prev(it)->out_pos;
+}
+
+std::vector<std::streamoff> GzipIndex::get_checkpoint_positions() const {
+  const std::scoped_lock<std::mutex> lock(m_mutex);
+  std::vector<std::streamoff> positions;
+  positions.reserve(m_checkpoints.size());
+  for (const auto& checkpoint : m_checkpoints) {
+    positions.push_back(checkpoint.out_pos);
+  }
+
+  return positions;
+}
+
+void GzipIndex::set_status(BackgroundTaskStatus status) {
+  m_status = status;
+  notify();
+}
+
+void GzipIndex::notify() const {
+  if (m_notifier != nullptr) {
+    m_notifier->notify();
+  }
+}
+
+GzipFileSource::GzipFileSource(std::shared_ptr<const GzipIndex> index, size_t page_size,
+                               size_t cache_pages)
+    : m_index(std::move(index)),
+      m_end(m_index->get_end()),
+      m_page_size(static_cast<std::streamoff>(std::max<size_t>(page_size, 1))),
+      m_cache_pages(std::max<size_t>(cache_pages, 1)),
+      m_cache(m_cache_pages),
+      m_inflater(std::make_unique<GzipInflater>(m_index->get_fpath())) {}
+
+GzipFileSource::~GzipFileSource() = default;
+
+std::streamoff GzipFileSource::refresh() {
+  std::streamoff end = m_index->get_end();
+  if (end <= m_end) {
+    return m_end;
+  }
+
+  if (m_end > 0) {
+    // The page holding the old end was read short. Checkpoints saved since all lie past it, so
+    // it still starts where it did.
+    std::streamoff base = m_index->get_checkpoint_pos_before(m_end - 1);
+    m_cache.erase(base + (m_end - 1 - base) / m_page_size * m_page_size);
+  }
+
+  m_last_begin = -1;
+  m_end = end;
+  return m_end;
+}
+
+FileBlock GzipFileSource::fetch(std::streamoff pos) {
+  if (m_last_begin != -1 && pos >= m_last_begin
+      && pos < m_last_begin + static_cast<std::streamoff>(m_last_data.size())) {
+    return {m_last_begin, m_last_data};
+  }
+
+  std::streamoff base = m_index->get_checkpoint_pos_before(pos);
+  std::streamoff page_begin = base + (pos - base) / m_page_size * m_page_size;
+
+  const std::string* data = m_cache.find(page_begin);
+  if (data == nullptr) {
+    ScopedTimer timer(get_perf_stats().page_reads);
+    TraceSpan span("page read");
+    data = &load_page(page_begin, base);
+    get_perf_stats().page_read_bytes.fetch_add(data->size(), std::memory_order_relaxed);
+  }
+
+  m_last_begin = page_begin;
+  m_last_data = *data;
+  return {page_begin, m_last_data};
+}
+
+const std::string& GzipFileSource::load_page(std::streamoff begin, std::streamoff base) {
+  // Carries on when the page is further on in the span being inflated
+  if (m_inflater_checkpoint != base || m_inflater->get_out_pos() > begin) {
+    m_inflater_checkpoint = -1;
+    m_inflater->start(m_index->get_checkpoint_before(begin));
+    m_inflater_checkpoint = base;
+  }
+
+  // Pages on the way are only kept when close before the one asked for, as scrolling back asks
+  // for them next
+  const std::streamoff keep_from
+      = begin - static_cast<std::streamoff>(m_cache_pages / 2) * m_page_size;
+  std::streamoff filling = -1;
+
+  try {
+    while (m_inflater->get_out_pos() < begin) {
+      std::streamoff page_begin = m_inflater->get_out_pos();
+      std::streamoff size = std::min(m_page_size, begin - page_begin);
+      if (page_begin >= keep_from && (page_begin - base) % m_page_size == 0) {
+        filling = page_begin;
+        read_page(m_cache.insert(page_begin), size);
+      } else {
+        read_page(m_scratch, size);
+      }
+    }
+
+    filling = begin;
+    std::string& data = m_cache.insert(begin);
+    read_page(data, std::min(m_page_size, m_end - begin));
+    return data;
+  } catch (const LFVException&) {
+    // Neither a short page nor the inflater is to be used again
+    if (filling != -1) {
+      m_cache.erase(filling);
+    }
+
+    m_inflater_checkpoint = -1;
+    throw;
+  }
+}
+
+void GzipFileSource::read_page(std::string& data, std::streamoff size) {
+  data.resize(static_cast<size_t>(size));
+  size_t produced = m_inflater->read_fully(data.data(), data.size());
+  if (produced < data.size()) {
+    throw LFVException("Gzip data ends before its index does");
+  }
+}
@@ -0,0 +1,476 @@
+#include <LFV/file_extractor.hpp>
+#include <LFV/file_watcher.hpp>
+#include <LFV/index_cache.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <system_error>
+
+namespace {
+  constexpr std::string_view MAGIC = "LFVINDEX";
+
+  // The key hashes this many samples of this size, spread evenly from the start to the end
+  constexpr std::streamoff NUM_SAMPLES = 16;
+  constexpr std::streamoff SAMPLE_SIZE = 4096;
+
+  constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+  constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+  // Flags of a saved search
+  constexpr uint64_t REGEX = 1;
+  constexpr uint64_t ANY = 2;
+  constexpr uint64_t COUNT_ONLY = 4;
+  constexpr uint64_t TO_END = 8;
+
+  uint64_t fnv1a(std::string_view data, uint64_t hash = FNV_OFFSET) {
+    for (char c : data) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+    }
+
+    return hash;
+  }
+
+  uint64_t hash_samples(FileExtractor& extractor, std::streamoff size) {
+    uint64_t hash = fnv1a(std::to_string(size));
+    if (size <= SAMPLE_SIZE) {
+      return fnv1a(extractor.view(0, size), hash);
+    }
+
+    for (std::streamoff i = 0; i < NUM_SAMPLES; i++) {
+      std::streamoff begin = (size - SAMPLE_SIZE) * i / (NUM_SAMPLES - 1);
+      hash = fnv1a(extractor.view(begin, begin + SAMPLE_SIZE), hash);
+    }
+
+    return hash;
+  }
+
+  class Writer {
+  public:
+    void put_fixed(uint64_t value, int bytes) {
+      for (int i = 0; i < bytes; i++) {
+        m_data += static_cast<char>((value >> (8 * i)) & 0xff);
+      }
+    }
+
+    void put_varint(uint64_t value) {
+      while (value >= 0x80) {
+        m_data += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+
+      m_data += static_cast<char>(value);
+    }
+
+    void put_pos(std::streamoff pos) { put_varint(static_cast<uint64_t>(pos)); }
+
+    void put_string(std::string_view str) {
+      put_varint(str.size());
+      m_data += str;
+    }
+
+    const std::string& get_data() const { return m_data; }
+
+  private:
+    std::string m_data;
+  };
+
+  class Reader {
+  public:
+    explicit Reader(std::string_view data) : m_data(data) {}
+
+    uint64_t get_fixed(int bytes) {
+      require(static_cast<size_t>(bytes));
+
+      uint64_t value = 0;
+      for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(m_data[m_pos++])) << (8 * i);
+      }
+
+      return value;
+    }
+
+    uint64_t get_varint() {
+      uint64_t value = 0;
+      for (int shift = 0; shift < 64; shift += 7) {
+        require(1);
+        auto byte = static_cast<unsigned char>(m_data[m_pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+          return value;
+        }
+      }
+
+      throw LFVException("Corrupt index cache");
+    }
+
+    std::streamoff get_pos() {
+      uint64_t value = get_varint();
+      if (value > static_cast<uint64_t>(std::numeric_limits<std::streamoff>::max())) {
+        throw LFVException("Corrupt index cache");
+      }
+
+      return static_cast<std::streamoff>(value);
+    }
+
+    // Number of items that follow, each taking at least min_bytes, so that a corrupt count is
+    // caught before anything is allocated for it
+    size_t get_count(size_t min_bytes = 1) {
+      uint64_t count = get_varint();
+      if (count > (m_data.size() - m_pos) / min_bytes) {
+        throw LFVException("Corrupt index cache");
+      }
+
+      return static_cast<size_t>(count);
+    }
+
+    std::string_view get_string() {
+      auto size = static_cast<size_t>(get_varint());
+      require(size);
+      std::string_view str = m_data.substr(m_pos, size);
+      m_pos += size;
+      return str;
+    }
+
+    bool at_end() const { return m_pos == m_data.size(); }
+
+  private:
+    std::string_view m_data;
+    size_t m_pos = 0;
+
+    void require(size_t count) const {
+      if (m_data.size() - m_pos < count) {
+        throw LFVException("Corrupt index cache");
+      }
+    }
+  };
+
+  void write_search(Writer& writer, const SavedSearch& search) {
+    const SearchResult& result = *search.result;
+    auto histogram = result.get_histogram();
+
+    uint64_t flags = (search.regex ? REGEX : 0) | (search.any ? ANY : 0)
+                     | (result.is_count_only() ? COUNT_ONLY : 0) | (search.to_end ? TO_END : 0);
+    writer.put_varint(flags);
+    writer.put_pos(search.from);
+    writer.put_pos(search.to);
+    writer.put_varint(search.patterns.size());
+    for (const auto& pattern : search.patterns) {
+      writer.put_string(pattern);
+    }
+
+    writer.put_varint(static_cast<uint64_t>(result.get_num_found()));
+    writer.put_varint(histogram != nullptr ? histogram->get_num_buckets() : 0);
+
+    if (histogram != nullptr) {
+      writer.put_pos(histogram->get_bucket_size());
+
+      // The histogram of a result with positions is counted again from them
+      if (result.is_count_only()) {
+        for (size_t bucket = 0; bucket < histogram->get_num_buckets(); bucket++) {
+          writer.put_varint(histogram->get_count(bucket));
+        }
+      }
+    }
+
+    if (result.is_count_only()) {
+      // Where a search carried on over appended bytes resumes, with 0 for no match
+      writer.put_pos(result.get_last_match() + 1);
+      return;
+    }
+
+    writer.put_varint(static_cast<uint64_t>(result.get_num_matches()));
+    std::streamoff last = 0;
+    for (int64_t i = 0; i < result.get_num_matches(); i++) {
+      std::streamoff pos = result.get_match(i);
+      writer.put_pos(pos - last);
+      last = pos;
+
+      if (search.any) {
+        writer.put_varint(static_cast<uint64_t>(result.get_match_pattern(i)));
+      }
+    }
+  }
+
+  SavedSearch read_search(Reader& reader, std::streamoff saved_size) {
+    SavedSearch search;
+    uint64_t flags = reader.get_varint();
+    search.regex = (flags & REGEX) != 0;
+    search.any = (flags & ANY) != 0;
+    search.to_end = (flags & TO_END) != 0;
+    const bool count_only = (flags & COUNT_ONLY) != 0;
+
+    search.from = reader.get_pos();
+    search.to = reader.get_pos();
+    if (search.from > search.to || search.to > saved_size) {
+      throw LFVException("Corrupt index cache");
+    }
+
+    for (size_t i = reader.get_count(); i > 0; i--) {
+      search.patterns.emplace_back(reader.get_string());
+    }
+
+    auto num_found = static_cast<int64_t>(reader.get_varint());
+
+    // Count-only histograms store each bucket's count. The others are counted again from the
+    // matches, and never have more buckets than the file has bytes or than by default.
+    std::shared_ptr<MatchHistogram> histogram;
+    const size_t num_buckets
+        = count_only ? reader.get_count() : static_cast<size_t>(reader.get_varint());
+    if (num_buckets > 0) {
+      const std::streamoff bucket_size = reader.get_pos();
+      const auto max_size = static_cast<uint64_t>(std::max<std::streamoff>(saved_size, 1));
+      if (num_buckets > std::max<uint64_t>(max_size, MatchHistogram::DEFAULT_NUM_BUCKETS)
+          || bucket_size < 1 || static_cast<uint64_t>(bucket_size) > max_size) {
+        throw LFVException("Corrupt index cache");
+      }
+
+      histogram = std::make_shared<MatchHistogram>(
+          bucket_size * static_cast<std::streamoff>(num_buckets), num_buckets);
+
+      if (count_only) {
+        for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+          histogram->add_to_bucket(bucket, reader.get_varint());
+        }
+      }
+    }
+
+    search.result = std::make_shared<SearchResult>(histogram, count_only);
+
+    if (count_only) {
+      search.result->add_num_found(num_found);
+
+      const std::streamoff last_match = reader.get_pos() - 1;
+      if (last_match >= search.to) {
+        throw LFVException("Corrupt index cache");
+      }
+      search.result->set_last_match(last_match);
+    } else {
+      std::streamoff pos = 0;
+      // Each match takes a byte, and one more for its pattern
+      const size_t num_matches = reader.get_count(search.any ? 2 : 1);
+      if (num_matches > static_cast<size_t>(IndexCache::MAX_SAVED_MATCHES)) {
+        throw LFVException("Corrupt index cache");
+      }
+
+      for (size_t i = num_matches; i > 0; i--) {
+        pos += reader.get_pos();
+        if (search.any) {
+          search.result->add_match(pos, static_cast<int32_t>(reader.get_varint()));
+        } else {
+          search.result->add_match(pos);
+        }
+      }
+    }
+
+    search.result->set_current_pos(search.to);
+    search.result->set_status(BackgroundTaskStatus::FINISHED);
+    return search;
+  }
+}  // namespace
+
+std::optional<FileKey> get_file_key(const std::string& fpath) {
+  auto status = stat_file(fpath);
+  if (!status) {
+    return std::nullopt;
+  }
+
+  try {
+    FileExtractor extractor(fpath);
+    if (extractor.get_end() < status->size) {
+      return std::nullopt;
+    }
+
+    return FileKey{status->size, status->modified, hash_samples(extractor, status->size)};
+  } catch (const LFVException&) {
+    return std::nullopt;
+  }
+}
+
+bool is_same_content(const std::string& fpath, const FileKey& key) {
+  auto status = stat_file(fpath);
+
+  // Rewritten in place if modified without growing
+  if (!status || status->size < key.size
+      || (status->size == key.size && status->modified != key.modified)) {
+    return false;
+  }
+
+  try {
+    FileExtractor extractor(fpath);
+    return extractor.get_end() >= key.size && hash_samples(extractor, key.size) == key.sample_hash;
+  } catch (const LFVException&) {
+    return false;
+  }
+}
+
+std::string get_default_index_cache_dir() {
+  if (const char* cache_home = std::getenv("XDG_CACHE_HOME");
+      cache_home != nullptr && *cache_home != '\0') {
+    return (std::filesystem::path(cache_home) / "lfv").string();
+  }
+
+  if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+    return (std::filesystem::path(home) / ".cache" / "lfv").string();
+  }
+
+  std::error_code error;
+  return (std::filesystem::temp_directory_path(error) / "lfv-cache").string();
+}
+
+IndexCache::IndexCache(std::string fpath, std::string cache_dir) : m_fpath(std::move(fpath)) {
+  std::error_code error;
+  if (auto absolute = std::filesystem::absolute(m_fpath, error); !error) {
+    m_fpath = absolute.lexically_normal().string();
+  }
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.lfvindex",
+                static_cast<unsigned long long>(fnv1a(m_fpath)));
+  m_cache_path = (std::filesystem::path(cache_dir) / name).string();
+
+  m_key = get_file_key(m_fpath);
+}
+
+std::optional<IndexCache::State> IndexCache::load() const {
+  if (!m_key) {
+    return std::nullopt;
+  }
+
+  try {
+    // Mapped when possible, so that only the pages read are loaded
+    FileExtractor cache(m_cache_path);
+    std::string_view data = cache.view(0, cache.get_end());
+
+    if (data.size() < MAGIC.size() + 8) {
+      return std::nullopt;
+    }
+
+    std::string_view content = data.substr(0, data.size() - 8);
+    if (Reader(data.substr(content.size())).get_fixed(8) != fnv1a(content)) {
+      return std::nullopt;
+    }
+
+    Reader reader(content);
+    if (reader.get_fixed(MAGIC.size()) != Reader(MAGIC).get_fixed(MAGIC.size())
+        || reader.get_fixed(4) != VERSION) {
+      return std::nullopt;
+    }
+
+    FileKey saved;
+    saved.size = static_cast<std::streamoff>(reader.get_fixed(8));
+    saved.modified = static_cast<int64_t>(reader.get_fixed(8));
+    saved.sample_hash = reader.get_fixed(8);
+
+    // Another path with the same hash, or content that changed
+    if (reader.get_string() != m_fpath || !is_same_content(m_fpath, saved)) {
+      return std::nullopt;
+    }
+
+    State state;
+    state.line_index = std::make_shared<LineIndex>(reader.get_pos());
+
+    std::streamoff num_newlines = reader.get_pos();
+    std::streamoff indexed_pos = reader.get_pos();
+    if (indexed_pos > saved.size) {
+      return std::nullopt;
+    }
+
+    std::vector<std::streamoff> checkpoints(reader.get_count());
+    std::streamoff checkpoint = 0;
+    for (auto& pos : checkpoints) {
+      checkpoint += reader.get_pos();
+      pos = checkpoint;
+    }
+    state.line_index->restore(std::move(checkpoints), num_newlines, indexed_pos);
+
+    for (size_t i = reader.get_count(); i > 0; i--) {
+      state.searches.push_back(read_search(reader, saved.size));
+    }
+
+    if (!reader.at_end()) {
+      return std::nullopt;
+    }
+
+    return state;
+  } catch (const LFVException&) {
+    return std::nullopt;
+  }
+}
+
+void IndexCache::save(const LineIndex& line_index, const std::vector<SavedSearch>& searches) const {
+  if (!m_key || !is_same_content(m_fpath, *m_key)) {
+    return;
+  }
+
+  // Taken again, so that the samples cover what the file grew by while open
+  auto key = get_file_key(m_fpath);
+  if (!key) {
+    return;
+  }
+
+  Writer writer;
+  for (char c : MAGIC) {
+    writer.put_fixed(static_cast<unsigned char>(c), 1);
+  }
+  writer.put_fixed(VERSION, 4);
+  writer.put_fixed(static_cast<uint64_t>(key->size), 8);
+  writer.put_fixed(static_cast<uint64_t>(key->modified), 8);
+  writer.put_fixed(key->sample_hash, 8);
+  writer.put_string(m_fpath);
+
+  writer.put_pos(line_index.get_interval());
+  writer.put_pos(line_index.get_num_newlines());
+  writer.put_pos(line_index.get_indexed_pos());
+
+  std::vector<std::streamoff> checkpoints = line_index.get_checkpoints();
+  writer.put_varint(checkpoints.size());
+  std::streamoff last = 0;
+  for (std::streamoff checkpoint : checkpoints) {
+    writer.put_pos(checkpoint - last);
+    last = checkpoint;
+  }
+
+  std::vector<const SavedSearch*> saved;
+  for (const auto& search : searches) {
+    if (saved.size() < MAX_SEARCHES && search.result != nullptr
+        && search.result->get_status() == BackgroundTaskStatus::FINISHED
+        && search.result->get_num_matches() <= MAX_SAVED_MATCHES) {
+      saved.push_back(&search);
+    }
+  }
+
+  writer.put_varint(saved.size());
+  for (const SavedSearch* search : saved) {
+    write_search(writer, *search);
+  }
+
+  writer.put_fixed(fnv1a(writer.get_data()), 8);
+
+  const std::filesystem::path cache_path(m_cache_path);
+  std::error_code error;
+  std::filesystem::create_directories(cache_path.parent_path(), error);
+
+  // Named apart from the temporary files of other instances saving the same cache
+  std::filesystem::path temp_path
+      = cache_path.string() + "." + std::to_string(std::random_device()()) + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    out.write(writer.get_data().data(), static_cast<std::streamsize>(writer.get_data().size()));
+    if (!out) {
+      std::filesystem::remove(temp_path, error);
+      throw LFVException("Cannot write the index cache " + temp_path.string());
+    }
+  }
+
+  std::filesystem::rename(temp_path, cache_path, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    throw LFVException("Cannot write the index cache " + m_cache_path);
+  }
+}
@@ -0,0 +1,32 @@
+#include <LFV/json.hpp>
+
+void print_json_string(std::FILE* out, const std::string& str) {
+  std::fputc('"', out);
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        std::fputs("\\\"", out);
+        break;
+      case '\\':
+        std::fputs("\\\\", out);
+        break;
+      case '\n':
+        std::fputs("\\n", out);
+        break;
+      case '\r':
+        std::fputs("\\r", out);
+        break;
+      case '\t':
+        std::fputs("\\t", out);
+        break;
+      default:
+        // Other control characters cannot appear raw in a JSON string
+        if (static_cast<unsigned char>(c) < 0x20) {
+          std::fprintf(out, "\\u%04x", static_cast<unsigned>(c));
+        } else {
+          std::fputc(c, out);
+        }
+    }
+  }
+  std::fputc('"', out);
+}
@@ -0,0 +1,157 @@
+#include <LFV/file_extractor.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/line_index.hpp>
+#include <algorithm>
+
+LineIndex::LineIndex(std::streamoff checkpoint_interval)
+    : m_interval(std::max<std::streamoff>(checkpoint_interval, 1)),
+      m_checkpoints{0},
+      m_status(BackgroundTaskStatus::NOT_STARTED) {}
+
+void LineIndex::build(FileExtractor& extractor, const std::atomic<bool>& aborted) {
+  // Progress is published and the abort flag checked once per step
+  constexpr std::streamoff STEP = 1 << 20;
+
+  const std::streamoff end = extractor.get_end();
+  m_end = end;
+  set_status(BackgroundTaskStatus::ONGOING);
+
+  std::streamoff newlines = m_num_newlines.load(std::memory_order_acquire);
+  std::streamoff cur = get_indexed_pos();
+
+  while (cur < end) {
+    if (aborted) {
+      set_status(BackgroundTaskStatus::ABORTED);
+      return;
+    }
+
+    std::streamoff step_end = std::min(cur + STEP, end);
+    std::streamoff next_checkpoint = (newlines / m_interval + 1) * m_interval;
+    std::streamoff found = extractor.count('\n', cur, step_end);
+
+    if (newlines + found < next_checkpoint) {
+      newlines += found;
+      cur = step_end;
+    } else {
+      // The next checkpoint lies in this step. Locate it exactly and carry on from there.
+      std::streamoff newline_pos = extractor.find_nth('\n', cur, next_checkpoint - newlines);
+      {
+        const std::scoped_lock<std::mutex> lock(m_mutex);
+        m_checkpoints.push_back(newline_pos + 1);
+      }
+
+      newlines = next_checkpoint;
+      cur = newline_pos + 1;
+    }
+
+    m_num_newlines.store(newlines, std::memory_order_release);
+    m_indexed_pos.store(cur, std::memory_order_release);
+    notify();
+  }
+
+  m_has_unterminated_line = end > 0 && extractor.getc(end - 1) != '\n';
+  set_status(BackgroundTaskStatus::FINISHED);
+}
+
+void LineIndex::set_status(BackgroundTaskStatus status) {
+  m_status = status;
+  notify();
+}
+
+void LineIndex::notify() const {
+  if (m_notifier != nullptr) {
+    m_notifier->notify();
+  }
+}
+
+std::streamoff LineIndex::get_num_lines() const {
+  std::streamoff newlines = m_num_newlines.load(std::memory_order_acquire);
+  if (get_status() == BackgroundTaskStatus::FINISHED && m_has_unterminated_line) {
+    return newlines + 1;
+  }
+
+  return newlines;
+}
+
+std::optional<std::streamoff> LineIndex::get_line_number(FileExtractor& extractor,
+                                                         std::streampos pos) const {
+  // The end of the file only counts as covered once the build has finished
+  bool finished = get_status() == BackgroundTaskStatus::FINISHED;
+  if (pos < 0 || (pos >= get_indexed_pos() && !(finished && pos <= get_end()))) {
+    return std::nullopt;
+  }
+
+  std::streamoff checkpoint_index = 0;
+  std::streamoff checkpoint = 0;
+  {
+    const std::scoped_lock<std::mutex> lock(m_mutex);
+    auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(),
+                               static_cast<std::streamoff>(pos));
+    checkpoint_index = (it - m_checkpoints.begin()) - 1;
+    checkpoint = m_checkpoints[static_cast<size_t>(checkpoint_index)];
+  }
+
+  return checkpoint_index * m_interval + extractor.count('\n', checkpoint, pos);
+}
+
+std::optional<std::streampos> LineIndex::get_line_begin(FileExtractor& extractor,
+                                                        std::streamoff line) const {
+  // Line n begins right after the n-th newline
+  if (line < 0 || line > m_num_newlines.load(std::memory_order_acquire)) {
+    return std::nullopt;
+  }
+
+  std::streamoff checkpoint = get_checkpoint(line / m_interval);
+  if (checkpoint == -1) {
+    return std::nullopt;
+  }
+
+  std::streamoff remaining = line % m_interval;
+  if (remaining == 0) {
+    return checkpoint;
+  }
+
+  std::streampos newline_pos = extractor.find_nth('\n', checkpoint, remaining);
+  if (newline_pos == -1) {
+    return std::nullopt;
+  }
+
+  return newline_pos + (std::streamoff)1;
+}
+
+std::streamoff LineIndex::get_checkpoint(std::streamoff index) const {
+  const std::scoped_lock<std::mutex> lock(m_mutex);
+
+  if (index >= static_cast<std::streamoff>(m_checkpoints.size())) {
+    return -1;
+  }
+
+  return m_checkpoints[static_cast<size_t>(index)];
+}
+
+std::vector<std::streamoff> LineIndex::get_checkpoints() const {
+  // One checkpoint per interval newlines seen, and the start of the file
+  auto count = static_cast<size_t>(get_num_newlines() / m_interval + 1);
+
+  const std::scoped_lock<std::mutex> lock(m_mutex);
+  return {m_checkpoints.begin(), m_checkpoints.begin() + std::min(count, m_checkpoints.size())};
+}
+
+void LineIndex::restore(std::vector<std::streamoff> checkpoints, std::streamoff num_newlines,
+                        std::streamoff indexed_pos) {
+  if (checkpoints.empty() || checkpoints.front() != 0 || num_newlines < 0
+      || static_cast<std::streamoff>(checkpoints.size()) != num_newlines / m_interval + 1
+      || !std::is_sorted(checkpoints.begin(), checkpoints.end())
+      || checkpoints.back() > indexed_pos) {
+    throw LFVException("Saved line index does not fit");
+  }
+
+  {
+    const std::scoped_lock<std::mutex> lock(m_mutex);
+    m_checkpoints = std::move(checkpoints);
+  }
+
+  m_num_newlines.store(num_newlines, std::memory_order_release);
+  m_indexed_pos.store(indexed_pos, std::memory_order_release);
+  m_end = indexed_pos;
+}
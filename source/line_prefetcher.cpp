@@ -0,0 +1,245 @@
+#include <LFV/file_extractor.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/line_prefetcher.hpp>
+#include <LFV/tracer.hpp>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+LinePrefetcher::LinePrefetcher(std::string fpath, const FileSourceOptions& options,
+                               std::shared_ptr<TaskPool> task_pool)
+    : m_fpath(std::move(fpath)), m_options(options), m_task_pool(std::move(task_pool)) {}
+
+LinePrefetcher::~LinePrefetcher() = default;
+
+int64_t LinePrefetcher::get_depth(double velocity, int height) {
+  // Every line takes at least one row, so this many lines cover the rows
+  auto screen = static_cast<int64_t>(std::max(height, 1));
+  auto rows = static_cast<int64_t>(velocity * LOOKAHEAD_SECONDS);
+  return std::clamp(rows, screen, screen * MAX_SCREENS);
+}
+
+void LinePrefetcher::on_scroll(int direction, std::streampos begin, std::streampos end,
+                               int height) {
+  auto now = std::chrono::steady_clock::now();
+  if (direction == 0 || direction != m_last_direction) {
+    m_velocity = 0;
+  } else {
+    std::chrono::duration<double> elapsed = now - m_last_step;
+    double step_velocity = 1 / std::max(elapsed.count(), 1e-4);
+    // Smooths out the uneven spacing of key repeats and wheel events
+    m_velocity = 0.7 * m_velocity + 0.3 * step_velocity;
+  }
+  m_last_direction = direction;
+  m_last_step = now;
+
+  int64_t ahead = get_depth(m_velocity, height);
+  int64_t behind = get_depth(0, height);
+  Request request{begin, end, direction >= 0 ? ahead : behind, direction < 0 ? ahead : behind};
+
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  m_pending = request;
+  if (m_job_running) {
+    // The running job picks it up
+    return;
+  }
+
+  try {
+    m_job = m_task_pool->submit(
+        [self = shared_from_this()](const CancellationToken& token) {
+          TraceSpan span("prefetch");
+          self->run_jobs(token);
+        },
+        TaskPriority::LOW);
+    m_job_running = true;
+  } catch (LFVException const&) {
+    // The pool is busy or shutting down, so the window reads the lines itself
+    m_pending.reset();
+  }
+}
+
+std::optional<std::streampos> LinePrefetcher::read_line_from(std::streampos begin,
+                                                             std::string& content) {
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  auto it = find_line_from(begin);
+  if (it == m_lines.end()) {
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+  content.assign(it->second.content);
+  return it->second.end;
+}
+
+std::optional<std::streampos> LinePrefetcher::read_line_before(std::streampos end,
+                                                               std::string& content) {
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  auto it = find_line_before(end);
+  if (it == m_lines.end()) {
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+  content.assign(it->second.content);
+  return it->first;
+}
+
+CacheStats LinePrefetcher::get_stats() const {
+  return {m_hits.load(std::memory_order_relaxed), m_misses.load(std::memory_order_relaxed)};
+}
+
+void LinePrefetcher::refresh() { invalidate(false); }
+
+void LinePrefetcher::reopen() { invalidate(true); }
+
+void LinePrefetcher::set_source_options(const FileSourceOptions& options) {
+  {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_options = options;
+  }
+
+  invalidate(true);
+}
+
+void LinePrefetcher::invalidate(bool reopen) {
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  m_lines.clear();
+  m_generation++;
+  m_reopen = m_reopen || reopen;
+}
+
+bool LinePrefetcher::is_idle() const {
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  return !m_job_running;
+}
+
+void LinePrefetcher::run_jobs(const CancellationToken& token) {
+  while (true) {
+    Request request;
+    {
+      std::scoped_lock<std::mutex> lock(m_mutex);
+      if (!m_pending || *token) {
+        m_pending.reset();
+        m_job_running = false;
+        return;
+      }
+
+      request = *m_pending;
+      m_pending.reset();
+    }
+
+    try {
+      prefetch(request, token);
+    } catch (std::exception const&) {
+      // Prefetching is best effort: the window reads the lines itself and reports errors
+      std::scoped_lock<std::mutex> lock(m_mutex);
+      m_pending.reset();
+      m_job_running = false;
+      return;
+    }
+  }
+}
+
+void LinePrefetcher::prefetch(const Request& request, const CancellationToken& token) {
+  uint64_t generation = 0;
+  bool reopen = false;
+  FileSourceOptions options;
+  {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    generation = m_generation;
+    reopen = m_reopen;
+    m_reopen = false;
+    options = m_options;
+  }
+
+  if (m_extractor == nullptr || reopen) {
+    m_extractor = std::make_unique<FileLineExtractor>(m_fpath, options);
+  } else if (generation != m_extractor_generation) {
+    m_extractor->refresh();
+  }
+  m_extractor_generation = generation;
+
+  const std::streampos file_end = m_extractor->get_end();
+
+  // Lines that are already loaded are skipped, so a window moving by a few rows only reads the
+  // few lines newly in range
+  std::streampos down = request.end;
+  for (int64_t i = 0; i < request.lines_down && down < file_end; i++) {
+    if (*token) {
+      return;
+    }
+
+    {
+      std::scoped_lock<std::mutex> lock(m_mutex);
+      if (auto it = find_line_from(down); it != m_lines.end()) {
+        down = it->second.end;
+        continue;
+      }
+    }
+
+    FileSegment line = m_extractor->get_segment_containing(down);
+    if (!add_line(generation, line.begin_pos, line.end_pos, line.content)) {
+      return;
+    }
+    down = line.end_pos;
+  }
+
+  std::streampos up = request.begin;
+  for (int64_t i = 0; i < request.lines_up && up > 0; i++) {
+    if (*token) {
+      return;
+    }
+
+    {
+      std::scoped_lock<std::mutex> lock(m_mutex);
+      if (auto it = find_line_before(up); it != m_lines.end()) {
+        up = it->first;
+        continue;
+      }
+    }
+
+    FileSegment line = m_extractor->get_segment_containing(up - static_cast<std::streamoff>(1));
+    if (!add_line(generation, line.begin_pos, line.end_pos, line.content)) {
+      return;
+    }
+    up = line.begin_pos;
+  }
+
+  // Drop what has gone out of range, which keeps the memory to a few screens of lines
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  if (generation != m_generation) {
+    return;
+  }
+  m_lines.erase(m_lines.begin(), m_lines.lower_bound(up));
+  m_lines.erase(m_lines.lower_bound(down), m_lines.end());
+}
+
+bool LinePrefetcher::add_line(uint64_t generation, std::streamoff begin, std::streampos end,
+                              std::string_view content) {
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  if (generation != m_generation) {
+    // The request was for the file as it was, and the window has sent a new one
+    return false;
+  }
+
+  m_lines[begin] = {end, std::string(content)};
+  return true;
+}
+
+LinePrefetcher::LineMap::const_iterator LinePrefetcher::find_line_from(
+    std::streampos begin) const {
+  return m_lines.find(begin);
+}
+
+LinePrefetcher::LineMap::const_iterator LinePrefetcher::find_line_before(
+    std::streampos end) const {
+  // Lines do not overlap, so only the last one beginning before end can end there
+  auto it = m_lines.lower_bound(end);
+  if (it == m_lines.begin() || std::prev(it)->second.end != end) {
+    return m_lines.end();
+  }
+
+  return std::prev(it);
+}
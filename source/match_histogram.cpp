@@ -0,0 +1,51 @@
+#include <LFV/match_histogram.hpp>
+#include <algorithm>
+
+MatchHistogram::MatchHistogram(std::streampos file_end, size_t num_buckets)
+    : m_num_buckets(std::max<size_t>(num_buckets, 1)),
+      m_buckets(std::make_unique<std::atomic<uint64_t>[]>(m_num_buckets)) {
+  // Rounded up so that the last bucket ends at or after the file end
+  const auto num = static_cast<std::streamoff>(m_num_buckets);
+  m_bucket_size = std::max<std::streamoff>((std::streamoff(file_end) + num - 1) / num, 1);
+}
+
+void MatchHistogram::extend(std::streampos file_end) {
+  const auto num = static_cast<std::streamoff>(m_num_buckets);
+  if (m_bucket_size * num >= file_end) {
+    return;
+  }
+
+  if (m_num_buckets == 1) {
+    m_bucket_size = file_end;
+    return;
+  }
+
+  // Doubling keeps the bounds of the old buckets, so that each count goes to a single new one
+  while (m_bucket_size * num < file_end) {
+    for (size_t bucket = 0; bucket < m_num_buckets; bucket++) {
+      uint64_t count = 0;
+      for (size_t old = 2 * bucket; old < std::min(2 * bucket + 2, m_num_buckets); old++) {
+        count += get_count(old);
+      }
+      m_buckets[bucket].store(count, std::memory_order_relaxed);
+    }
+
+    m_bucket_size *= 2;
+  }
+}
+
+std::vector<uint64_t> MatchHistogram::get_rows(size_t num_rows) const {
+  std::vector<uint64_t> rows(num_rows, 0);
+
+  for (size_t row = 0; row < num_rows; row++) {
+    size_t first = row * m_num_buckets / num_rows;
+    // With more rows than buckets, neighbouring rows show the same bucket
+    size_t last = std::max((row + 1) * m_num_buckets / num_rows, first + 1);
+
+    for (size_t bucket = first; bucket < last; bucket++) {
+      rows[row] += get_count(bucket);
+    }
+  }
+
+  return rows;
+}
@@ -0,0 +1,270 @@
+#include <LFV/lfv_exception.hpp>
+#include <LFV/match_store.hpp>
+#include <algorithm>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#  define LFV_HAS_PREAD 1
+#endif
+
+namespace {
+  void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+      out.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+  }
+
+  uint64_t get_varint(const uint8_t*& in) {
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      uint8_t byte = *in++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+  }
+
+  // Maps small negative deltas to small values too
+  uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  }
+
+  int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+}  // namespace
+
+MatchStore::MatchStore(size_t memory_budget)
+    : m_memory_budget(memory_budget), m_open(std::make_unique<RawMatch[]>(BLOCK_MATCHES)) {}
+
+MatchStore::~MatchStore() {
+  if (m_spill_file != nullptr) {
+    std::fclose(m_spill_file);
+  }
+}
+
+void MatchStore::add(std::streamoff pos, int32_t pattern) {
+  int64_t size = m_size.load(std::memory_order_relaxed);
+  size_t offset = static_cast<size_t>(size) % BLOCK_MATCHES;
+
+  m_open[offset].pos.store(pos, std::memory_order_relaxed);
+  m_open[offset].pattern.store(pattern, std::memory_order_relaxed);
+
+  if (offset + 1 == BLOCK_MATCHES) {
+    seal();
+  }
+
+  m_size.store(size + 1, std::memory_order_release);
+}
+
+std::pair<std::streamoff, int32_t> MatchStore::get(int64_t index) const {
+  if (index < 0 || index >= size()) {
+    throw LFVException("Match index out of range: " + std::to_string(index));
+  }
+
+  size_t block_index = static_cast<size_t>(index) / BLOCK_MATCHES;
+  size_t offset = static_cast<size_t>(index) % BLOCK_MATCHES;
+
+  size_t num_blocks = m_num_blocks.load(std::memory_order_acquire);
+  if (block_index == num_blocks) {
+    const RawMatch& raw = m_open[offset];
+    std::pair<std::streamoff, int32_t> match{raw.pos.load(std::memory_order_relaxed),
+                                             raw.pattern.load(std::memory_order_relaxed)};
+
+    // If the writer sealed the block meanwhile, the entry may have been reused: the fence pairs
+    // with the one in seal() so that the new block count is seen then. The count is loaded with
+    // acquire, so that a sealed block seen here is also complete for decode().
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_num_blocks.load(std::memory_order_acquire) == num_blocks) {
+      return match;
+    }
+  }
+
+  std::scoped_lock<std::mutex> lock(m_decode_mutex);
+  if (m_decoded_block != static_cast<int64_t>(block_index)) {
+    decode(block_index);
+  }
+
+  return m_decoded[offset];
+}
+
+int64_t MatchStore::lower_bound(std::streamoff pos) const {
+  const int64_t num_matches = size();
+  const size_t num_sealed = std::min(m_num_blocks.load(std::memory_order_acquire),
+                                     static_cast<size_t>(num_matches) / BLOCK_MATCHES);
+
+  // The last sealed block starting before pos holds the match, or the next block starts with it
+  size_t first_block = 0;
+  size_t last_block = num_sealed;
+  while (last_block - first_block > 1) {
+    size_t mid = first_block + (last_block - first_block) / 2;
+    if (get_block_begin(mid) < pos) {
+      first_block = mid;
+    } else {
+      last_block = mid;
+    }
+  }
+
+  int64_t first = static_cast<int64_t>(first_block * BLOCK_MATCHES);
+  int64_t last = first_block + 1 < num_sealed
+                     ? static_cast<int64_t>((first_block + 1) * BLOCK_MATCHES)
+                     : num_matches;
+  while (first < last) {
+    int64_t mid = first + (last - first) / 2;
+    if (get(mid).first < pos) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+
+  return first;
+}
+
+void MatchStore::seal() {
+  size_t block_index = m_num_blocks.load(std::memory_order_relaxed);
+  if (block_index == SEGMENT_BLOCKS * MAX_SEGMENTS) {
+    throw LFVException("Too many matches");
+  }
+
+  auto block = std::make_unique<Block>();
+
+  // The lowest bit says whether a pattern index follows
+  std::streamoff last_pos = 0;
+  for (size_t i = 0; i < BLOCK_MATCHES; i++) {
+    std::streamoff pos = m_open[i].pos.load(std::memory_order_relaxed);
+    int32_t pattern = m_open[i].pattern.load(std::memory_order_relaxed);
+
+    put_varint(block->data, zigzag(pos - last_pos) << 1 | static_cast<uint64_t>(pattern != 0));
+    if (pattern != 0) {
+      put_varint(block->data, static_cast<uint32_t>(pattern));
+    }
+
+    last_pos = pos;
+  }
+
+  block->data.shrink_to_fit();
+  if (get_memory_bytes() + block->data.size() > m_memory_budget && spill(*block)) {
+    m_spilled_bytes.fetch_add(block->spill_size, std::memory_order_relaxed);
+  } else {
+    m_memory_bytes.fetch_add(block->data.size(), std::memory_order_relaxed);
+  }
+
+  std::unique_ptr<Segment>& segment = m_directory[block_index / SEGMENT_BLOCKS];
+  if (segment == nullptr) {
+    segment = std::make_unique<Segment>();
+  }
+  (*segment)[block_index % SEGMENT_BLOCKS] = std::move(block);
+
+  m_num_blocks.store(block_index + 1, std::memory_order_release);
+
+  // Orders the new block count before the reuse of the raw entries
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+bool MatchStore::spill(Block& block) {
+#ifdef LFV_HAS_PREAD
+  if (m_spill_failed) {
+    return false;
+  }
+
+  if (m_spill_file == nullptr) {
+    // Deleted by the system once closed
+    m_spill_file = std::tmpfile();
+    if (m_spill_file == nullptr) {
+      m_spill_failed = true;
+      return false;
+    }
+  }
+
+  auto offset = static_cast<int64_t>(m_spilled_bytes.load(std::memory_order_relaxed));
+  size_t written = 0;
+  while (written < block.data.size()) {
+    ssize_t count = pwrite(fileno(m_spill_file), block.data.data() + written,
+                           block.data.size() - written,
+                           static_cast<off_t>(offset + static_cast<int64_t>(written)));
+    if (count <= 0) {
+      // Keep this block and the next ones in memory
+      m_spill_failed = true;
+      return false;
+    }
+    written += static_cast<size_t>(count);
+  }
+
+  block.spill_offset = offset;
+  block.spill_size = block.data.size();
+  block.data = std::vector<uint8_t>();
+  return true;
+#else
+  (void)block;
+  return false;
+#endif
+}
+
+std::streamoff MatchStore::get_block_begin(size_t block_index) const {
+  const Block& block = get_block(block_index);
+
+  // The first position is a delta from 0, so it is the first varint
+  uint8_t first_bytes[10] = {};
+#ifdef LFV_HAS_PREAD
+  if (block.spill_offset != -1) {
+    size_t loaded = 0;
+    size_t wanted = std::min(sizeof(first_bytes), block.spill_size);
+    while (loaded < wanted) {
+      ssize_t count = pread(fileno(m_spill_file), first_bytes + loaded, wanted - loaded,
+                            static_cast<off_t>(block.spill_offset + static_cast<int64_t>(loaded)));
+      if (count <= 0) {
+        throw LFVException("Cannot read spilled matches");
+      }
+      loaded += static_cast<size_t>(count);
+    }
+  }
+#endif
+  const uint8_t* in = block.spill_offset == -1 ? block.data.data() : first_bytes;
+
+  return unzigzag(get_varint(in) >> 1);
+}
+
+void MatchStore::decode(size_t block_index) const {
+  const Block& block = get_block(block_index);
+
+  std::vector<uint8_t> spilled;
+#ifdef LFV_HAS_PREAD
+  if (block.spill_offset != -1) {
+    spilled.resize(block.spill_size);
+    size_t loaded = 0;
+    while (loaded < spilled.size()) {
+      ssize_t count = pread(fileno(m_spill_file), spilled.data() + loaded, spilled.size() - loaded,
+                            static_cast<off_t>(block.spill_offset + static_cast<int64_t>(loaded)));
+      if (count <= 0) {
+        throw LFVException("Cannot read spilled matches");
+      }
+      loaded += static_cast<size_t>(count);
+    }
+  }
+#endif
+  const std::vector<uint8_t>& data = block.spill_offset == -1 ? block.data : spilled;
+
+  m_decoded.clear();
+
+  std::streamoff pos = 0;
+  const uint8_t* in = data.data();
+  const uint8_t* end = data.data() + data.size();
+  while (in < end) {
+    uint64_t header = get_varint(in);
+    pos += unzigzag(header >> 1);
+
+    int32_t pattern = 0;
+    if ((header & 1) != 0) {
+      pattern = static_cast<int32_t>(get_varint(in));
+    }
+
+    m_decoded.emplace_back(pos, pattern);
+  }
+
+  m_decoded_block = static_cast<int64_t>(block_index);
+}
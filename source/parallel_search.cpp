@@ -0,0 +1,340 @@
+#include <LFV/file_extractor.hpp>
+#include <LFV/gzip_source.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/parallel_search.hpp>
+#include <LFV/substring_search.hpp>
+#include <LFV/tracer.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+  // Matches a chunk holds before they are published, once the chunks before it are, rather than
+  // buffered until the chunk is done
+  constexpr size_t MAX_BUFFERED_MATCHES = 1 << 16;
+
+  // Matches found in a chunk. Count-only results keep no positions, only the number of matches in
+  // each run that falls in one histogram bucket.
+  struct ChunkMatches {
+    std::vector<std::streamoff> positions;
+    // Where each run starts, and how many matches it holds
+    std::vector<std::pair<std::streamoff, int64_t>> counts;
+  };
+
+  // Hands out chunks to the workers and publishes their matches in chunk order
+  class ChunkScheduler {
+  public:
+    // Chunk i covers [boundaries[i], boundaries[i + 1])
+    ChunkScheduler(std::vector<std::streamoff> boundaries, size_t max_pending,
+                   int64_t match_limit, std::shared_ptr<SearchResult> result)
+        : m_boundaries(std::move(boundaries)),
+          m_num_chunks(static_cast<std::streamoff>(m_boundaries.size()) - 1),
+          m_max_pending(static_cast<std::streamoff>(max_pending)),
+          m_match_limit(match_limit),
+          m_result(std::move(result)) {}
+
+    std::streamoff get_chunk_begin(std::streamoff chunk) const {
+      return m_boundaries[static_cast<size_t>(chunk)];
+    }
+
+    std::streamoff get_chunk_end(std::streamoff chunk) const {
+      return m_boundaries[static_cast<size_t>(chunk) + 1];
+    }
+
+    // Returns the next chunk to scan, or -1 if there is none left. Blocks while too many
+    // finished chunks are waiting for an earlier one, which bounds the buffered matches.
+    std::streamoff take_chunk(const std::atomic<bool>& aborted) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] {
+        return m_stopped || m_next_chunk < m_next_published + m_max_pending;
+      });
+
+      if (m_stopped || aborted || m_next_chunk >= m_num_chunks) {
+        return -1;
+      }
+
+      return m_next_chunk++;
+    }
+
+    // Publishes the matches found so far in a chunk that is still being scanned, once every
+    // chunk before it is published. The chunk first in line never waits, so the others always
+    // get their turn. Returns false if the search stopped.
+    bool publish_early(std::streamoff chunk, ChunkMatches& matches) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this, chunk] { return m_stopped || m_next_published == chunk; });
+
+      if (!m_stopped) {
+        publish(matches);
+      }
+      matches.positions.clear();
+      matches.counts.clear();
+
+      return !m_stopped;
+    }
+
+    void finish_chunk(std::streamoff chunk, ChunkMatches matches) {
+      const std::scoped_lock<std::mutex> lock(m_mutex);
+      m_finished[chunk] = std::move(matches);
+
+      // Publish every chunk that is no longer waiting for an earlier one
+      for (auto it = m_finished.begin();
+           !m_stopped && it != m_finished.end() && it->first == m_next_published;
+           it = m_finished.erase(it)) {
+        publish(it->second);
+
+        if (!m_stopped) {
+          m_result->set_current_pos(get_chunk_end(m_next_published));
+          m_next_published++;
+        }
+      }
+
+      m_cv.notify_all();
+    }
+
+    void stop() {
+      const std::scoped_lock<std::mutex> lock(m_mutex);
+      m_stopped = true;
+      m_cv.notify_all();
+    }
+
+  private:
+    std::vector<std::streamoff> m_boundaries;
+    std::streamoff m_num_chunks;
+    std::streamoff m_max_pending;
+    int64_t m_match_limit;
+    std::shared_ptr<SearchResult> m_result;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::streamoff m_next_chunk = 0;
+    std::streamoff m_next_published = 0;
+    int64_t m_published_matches = 0;
+    bool m_stopped = false;
+    std::map<std::streamoff, ChunkMatches> m_finished;
+
+    // Adds matches of the chunk first in line to the result. Called with the lock held.
+    void publish(const ChunkMatches& matches) {
+      for (std::streamoff pos : matches.positions) {
+        if (m_published_matches >= m_match_limit) {
+          // Progress stops at the last match that made it in
+          m_stopped = true;
+          return;
+        }
+
+        m_result->add_match(pos);
+        m_result->set_current_pos(pos);
+        m_published_matches++;
+      }
+
+      for (auto [pos, count] : matches.counts) {
+        const int64_t room = m_match_limit - m_published_matches;
+        m_result->add_match_count(pos, std::min(count, room));
+        m_result->set_current_pos(pos);
+        m_published_matches += std::min(count, room);
+
+        if (count > room) {
+          m_stopped = true;
+          return;
+        }
+      }
+    }
+  };
+
+  // Cuts [begin, end) into chunks of chunk_size. A gzip file is cut at its checkpoints instead,
+  // so that each chunk starts decompressing where it begins.
+  std::vector<std::streamoff> get_chunk_boundaries(std::streamoff begin, std::streamoff end,
+                                                   std::streamoff chunk_size,
+                                                   const FileSourceOptions& source_options) {
+    std::vector<std::streamoff> boundaries{begin};
+
+    if (source_options.gzip_index != nullptr) {
+      for (std::streamoff pos : source_options.gzip_index->get_checkpoint_positions()) {
+        if (pos > begin && pos < end) {
+          boundaries.push_back(pos);
+        }
+      }
+    } else {
+      for (std::streamoff pos = begin + chunk_size; pos < end; pos += chunk_size) {
+        boundaries.push_back(pos);
+      }
+    }
+
+    if (end > begin) {
+      boundaries.push_back(end);
+    }
+
+    return boundaries;
+  }
+
+  // What the workers of a search share. Helpers on the task pool may only start after the search
+  // ended, so they share it with the caller.
+  class ParallelSearch {
+  public:
+    ParallelSearch(const std::string& fpath, const std::string& pattern, std::streamoff end,
+                   std::vector<std::streamoff> boundaries, size_t max_pending,
+                   int64_t match_limit, std::shared_ptr<SearchResult> result,
+                   std::shared_ptr<std::atomic<bool>> aborted,
+                   const FileSourceOptions& source_options)
+        : m_fpath(fpath),
+          m_searcher(pattern),
+          m_overlap(static_cast<std::streamoff>(pattern.size()) - 1),
+          m_end(end),
+          m_scheduler(std::move(boundaries), max_pending, match_limit, result),
+          m_result(std::move(result)),
+          m_aborted(std::move(aborted)),
+          m_source_options(source_options) {}
+
+    // Run by a task pool worker, unless the search is over by then
+    void help() {
+      {
+        const std::scoped_lock<std::mutex> lock(m_mutex);
+        if (m_closed) {
+          return;
+        }
+        m_num_helping++;
+      }
+
+      work();
+
+      {
+        const std::scoped_lock<std::mutex> lock(m_mutex);
+        m_num_helping--;
+      }
+      m_cv.notify_all();
+    }
+
+    // Scans chunks until there are none left
+    void work() {
+      try {
+        // Each worker reads through its own extractor, as extractors are not thread-safe
+        FileExtractor extractor(m_fpath, m_source_options);
+
+        for (std::streamoff chunk = m_scheduler.take_chunk(*m_aborted); chunk != -1;
+             chunk = m_scheduler.take_chunk(*m_aborted)) {
+          TraceSpan span("search chunk");
+          m_scheduler.finish_chunk(chunk, search_chunk(extractor, chunk));
+        }
+      } catch (...) {
+        {
+          const std::scoped_lock<std::mutex> lock(m_mutex);
+          m_error = std::current_exception();
+        }
+        m_scheduler.stop();
+      }
+    }
+
+    // Called by the caller once it is done working: helpers that did not start are turned away,
+    // and the others waited for. Rethrows what a worker threw.
+    void finish() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_closed = true;
+      m_cv.wait(lock, [this] { return m_num_helping == 0; });
+
+      if (m_error) {
+        std::rethrow_exception(m_error);
+      }
+    }
+
+  private:
+    std::string m_fpath;
+    const SubstringSearcher m_searcher;
+    std::streamoff m_overlap;
+    std::streamoff m_end;
+    ChunkScheduler m_scheduler;
+    std::shared_ptr<SearchResult> m_result;
+    std::shared_ptr<std::atomic<bool>> m_aborted;
+    FileSourceOptions m_source_options;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    int m_num_helping = 0;
+    bool m_closed = false;
+    std::exception_ptr m_error;
+
+    // The chunk's matches that were not published early
+    ChunkMatches search_chunk(FileExtractor& extractor, std::streamoff chunk) {
+      std::streamoff chunk_begin = m_scheduler.get_chunk_begin(chunk);
+      std::streamoff chunk_end = m_scheduler.get_chunk_end(chunk);
+
+      // Read past the chunk end so that matches starting inside the chunk are complete, but
+      // never past the end of the searched range
+      std::string_view data
+          = extractor.view(chunk_begin, std::min<std::streamoff>(chunk_end + m_overlap, m_end));
+
+      const bool count_only = m_result->is_count_only();
+      const std::shared_ptr<const MatchHistogram> histogram = m_result->get_histogram();
+
+      ChunkMatches matches;
+      m_searcher.find_all(data, [&](size_t offset) {
+        std::streamoff pos = chunk_begin + static_cast<std::streamoff>(offset);
+        if (pos >= chunk_end) {
+          return false;
+        }
+
+        if (count_only) {
+          if (matches.counts.empty()
+              || (histogram != nullptr
+                  && histogram->get_bucket(pos)
+                         != histogram->get_bucket(matches.counts.back().first))) {
+            matches.counts.emplace_back(pos, 0);
+          }
+          matches.counts.back().second++;
+          return true;
+        }
+
+        matches.positions.push_back(pos);
+        if (matches.positions.size() >= MAX_BUFFERED_MATCHES) {
+          return m_scheduler.publish_early(chunk, matches);
+        }
+
+        return true;
+      });
+
+      return matches;
+    }
+  };
+}  // namespace
+
+void search_in_file_parallel(const std::string& fpath, const std::string& pattern,
+                             std::streampos begin, std::streampos end, int64_t match_limit,
+                             std::shared_ptr<SearchResult> result,
+                             std::shared_ptr<std::atomic<bool>> aborted, unsigned num_workers,
+                             std::streamoff chunk_size, const FileSourceOptions& source_options,
+                             std::shared_ptr<TaskPool> task_pool) {
+  num_workers = std::max(num_workers, 1U);
+  chunk_size = std::max<std::streamoff>(chunk_size, 1);
+
+  auto search = std::make_shared<ParallelSearch>(
+      fpath, pattern, end, get_chunk_boundaries(begin, end, chunk_size, source_options),
+      4 * static_cast<size_t>(num_workers), match_limit, result, aborted, source_options);
+
+  result->start(begin);
+
+  // The calling thread is a worker, and helpers join it from the task pool as its threads free up
+  if (task_pool == nullptr && num_workers > 1) {
+    task_pool = std::make_shared<TaskPool>(num_workers - 1);
+  }
+
+  if (task_pool != nullptr) {
+    const size_t num_helpers = std::min<size_t>(num_workers - 1, task_pool->get_num_threads());
+    for (size_t i = 0; i < num_helpers; i++) {
+      try {
+        task_pool->submit([search](const CancellationToken&) { search->help(); },
+                          TaskPriority::HIGH);
+      } catch (LFVException const&) {
+        // The queue is full or shut down: the search goes on with fewer workers
+        break;
+      }
+    }
+  }
+
+  search->work();
+  search->finish();
+
+  result->set_status(*aborted ? BackgroundTaskStatus::ABORTED : BackgroundTaskStatus::FINISHED);
+}
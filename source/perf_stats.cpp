@@ -0,0 +1,110 @@
+#include <LFV/perf_stats.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#endif
+
+namespace {
+  constexpr uint64_t SUB_BUCKETS = uint64_t{1} << LatencyHistogram::SUB_BUCKET_BITS;
+
+  // Index of the highest set bit of a non-zero value
+  int get_highest_bit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+      if (value >> shift != 0) {
+        value >>= shift;
+        bit += shift;
+      }
+    }
+
+    return bit;
+  }
+
+  // Durations under SUB_BUCKETS ns have a bucket each. Above, each power of two is split into
+  // SUB_BUCKETS buckets by the bits after the highest one.
+  size_t get_bucket(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+      return static_cast<size_t>(ns);
+    }
+
+    const int exponent = get_highest_bit(ns);
+    const int shift = exponent - LatencyHistogram::SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = (ns >> shift) & (SUB_BUCKETS - 1);
+    return static_cast<size_t>(static_cast<uint64_t>(shift + 1) * SUB_BUCKETS + sub_bucket);
+  }
+
+  uint64_t get_bucket_begin(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+
+    const uint64_t shift = bucket / SUB_BUCKETS - 1;
+    return (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+  }
+
+  uint64_t get_bucket_width(size_t bucket) {
+    return bucket < SUB_BUCKETS ? 1 : uint64_t{1} << (bucket / SUB_BUCKETS - 1);
+  }
+}  // namespace
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration duration) {
+  const auto ns = static_cast<uint64_t>(
+      std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0));
+  m_buckets[get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_total_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::get_percentile(double fraction) const {
+  // Buckets are read one at a time, so the total is taken from them rather than from m_count
+  std::array<uint64_t, NUM_BUCKETS> counts{};
+  uint64_t total = 0;
+  for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+    counts[bucket] = m_buckets[bucket].load(std::memory_order_relaxed);
+    total += counts[bucket];
+  }
+
+  if (total == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+
+  const auto rank = std::max<uint64_t>(
+      static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(total))),
+      1);
+
+  // Interpolates within the bucket holding the rank
+  uint64_t below = 0;
+  for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+    if (below + counts[bucket] >= rank) {
+      const double within
+          = static_cast<double>(rank - below) / static_cast<double>(counts[bucket]);
+      return std::chrono::nanoseconds(
+          get_bucket_begin(bucket)
+          + static_cast<uint64_t>(within * static_cast<double>(get_bucket_width(bucket) - 1)));
+    }
+    below += counts[bucket];
+  }
+
+  return std::chrono::nanoseconds(0);
+}
+
+PerfStats& get_perf_stats() {
+  static PerfStats stats;
+  return stats;
+}
+
+uint64_t get_resident_bytes() {
+#if defined(__linux__)
+  // Total and resident pages
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  if (statm >> size >> resident) {
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,774 @@
+#include <LFV/lfv_exception.hpp>
+#include <LFV/regex.hpp>
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <set>
+#include <string>
+
+namespace {
+  constexpr int MAX_REPEAT = 1000;
+  constexpr size_t MAX_NFA_NODES = 100'000;
+
+  struct RegexNode {
+    enum class Kind { BYTES, CONCAT, ALTERNATE, REPEAT, LINE_START, LINE_END, EMPTY };
+
+    Kind kind = Kind::EMPTY;
+    std::bitset<256> bytes;
+    std::vector<std::unique_ptr<RegexNode>> children;
+    // For REPEAT. A negative max means unbounded.
+    int min = 0;
+    int max = -1;
+  };
+
+  std::unique_ptr<RegexNode> make_node(RegexNode::Kind kind) {
+    auto node = std::make_unique<RegexNode>();
+    node->kind = kind;
+    return node;
+  }
+
+  std::bitset<256> byte_range(int first, int last) {
+    std::bitset<256> bytes;
+    for (int c = first; c <= last; c++) {
+      bytes.set(static_cast<size_t>(c));
+    }
+
+    return bytes;
+  }
+
+  int lowest_byte(const std::bitset<256>& bytes) {
+    for (int c = 0; c < 256; c++) {
+      if (bytes.test(static_cast<size_t>(c))) {
+        return c;
+      }
+    }
+
+    return -1;
+  }
+
+  // Recursive descent parser for the syntax described on Regex
+  class RegexParser {
+  public:
+    RegexParser(const std::string& pattern) : m_pattern(pattern) {}
+
+    std::unique_ptr<RegexNode> parse() {
+      auto node = parse_alternate();
+      if (m_pos != m_pattern.size()) {
+        fail("unmatched ')'");
+      }
+
+      return node;
+    }
+
+  private:
+    const std::string& m_pattern;
+    size_t m_pos = 0;
+
+    [[noreturn]] void fail(const std::string& reason) const {
+      throw LFVException("Invalid regex at " + std::to_string(m_pos) + ": " + reason);
+    }
+
+    bool at_end() const { return m_pos >= m_pattern.size(); }
+
+    char peek() const { return m_pattern[m_pos]; }
+
+    bool consume(char c) {
+      if (!at_end() && peek() == c) {
+        m_pos++;
+        return true;
+      }
+
+      return false;
+    }
+
+    std::unique_ptr<RegexNode> parse_alternate() {
+      auto first = parse_concat();
+      if (at_end() || peek() != '|') {
+        return first;
+      }
+
+      auto node = make_node(RegexNode::Kind::ALTERNATE);
+      node->children.push_back(std::move(first));
+      while (consume('|')) {
+        node->children.push_back(parse_concat());
+      }
+
+      return node;
+    }
+
+    std::unique_ptr<RegexNode> parse_concat() {
+      auto node = make_node(RegexNode::Kind::CONCAT);
+      while (!at_end() && peek() != '|' && peek() != ')') {
+        node->children.push_back(parse_repeat());
+      }
+
+      if (node->children.empty()) {
+        return make_node(RegexNode::Kind::EMPTY);
+      }
+
+      if (node->children.size() == 1) {
+        return std::move(node->children.front());
+      }
+
+      return node;
+    }
+
+    std::unique_ptr<RegexNode> parse_repeat() {
+      auto node = parse_atom();
+
+      while (!at_end()) {
+        int min = 0;
+        int max = -1;
+
+        if (consume('*')) {
+          // Zero or more
+        } else if (consume('+')) {
+          min = 1;
+        } else if (consume('?')) {
+          max = 1;
+        } else if (!parse_braces(min, max)) {
+          break;
+        }
+
+        // Lazy quantifiers find the same matches with a DFA
+        consume('?');
+
+        if (node->kind == RegexNode::Kind::LINE_START || node->kind == RegexNode::Kind::LINE_END) {
+          fail("anchors cannot be repeated");
+        }
+
+        auto repeat = make_node(RegexNode::Kind::REPEAT);
+        repeat->min = min;
+        repeat->max = max;
+        repeat->children.push_back(std::move(node));
+        node = std::move(repeat);
+      }
+
+      return node;
+    }
+
+    // Parses {n}, {n,} or {n,m}. Leaves the input untouched if it is not one.
+    bool parse_braces(int& min, int& max) {
+      if (at_end() || peek() != '{') {
+        return false;
+      }
+
+      size_t start = m_pos;
+      m_pos++;
+
+      auto parse_number = [this](int& value) {
+        size_t digits_start = m_pos;
+        value = 0;
+        while (!at_end() && std::isdigit(static_cast<unsigned char>(peek())) != 0) {
+          value = std::min(value * 10 + (peek() - '0'), MAX_REPEAT + 1);
+          m_pos++;
+        }
+
+        return m_pos != digits_start;
+      };
+
+      bool valid = parse_number(min);
+      max = min;
+      if (valid && consume(',')) {
+        max = -1;
+        if (!at_end() && peek() != '}') {
+          valid = parse_number(max);
+        }
+      }
+
+      if (!valid || !consume('}')) {
+        // Not a quantifier, so '{' is a literal
+        m_pos = start;
+        return false;
+      }
+
+      if (min > MAX_REPEAT || max > MAX_REPEAT) {
+        fail("repetition count over " + std::to_string(MAX_REPEAT));
+      }
+
+      if (max != -1 && max < min) {
+        fail("invalid repetition range");
+      }
+
+      return true;
+    }
+
+    std::unique_ptr<RegexNode> parse_atom() {
+      char c = m_pattern[m_pos++];
+
+      switch (c) {
+        case '(': {
+          // Groups don't capture anyway
+          if (consume('?') && !consume(':')) {
+            fail("unsupported group type");
+          }
+
+          auto node = parse_alternate();
+          if (!consume(')')) {
+            fail("missing ')'");
+          }
+
+          return node;
+        }
+        case '[': {
+          auto node = make_node(RegexNode::Kind::BYTES);
+          node->bytes = parse_class();
+          return node;
+        }
+        case '.': {
+          auto node = make_node(RegexNode::Kind::BYTES);
+          node->bytes.set();
+          node->bytes.reset('\n');
+          return node;
+        }
+        case '^':
+          return make_node(RegexNode::Kind::LINE_START);
+        case '$':
+          return make_node(RegexNode::Kind::LINE_END);
+        case '*':
+        case '+':
+        case '?':
+          m_pos--;
+          fail("nothing to repeat");
+        case '\\': {
+          auto node = make_node(RegexNode::Kind::BYTES);
+          node->bytes = parse_escape();
+          return node;
+        }
+        default: {
+          auto node = make_node(RegexNode::Kind::BYTES);
+          node->bytes.set(static_cast<unsigned char>(c));
+          return node;
+        }
+      }
+    }
+
+    // Parses what follows a backslash
+    std::bitset<256> parse_escape() {
+      if (at_end()) {
+        fail("trailing backslash");
+      }
+
+      char c = m_pattern[m_pos++];
+      std::bitset<256> bytes;
+
+      switch (c) {
+        case 'd':
+        case 'D':
+          bytes = byte_range('0', '9');
+          break;
+        case 'w':
+        case 'W':
+          bytes = byte_range('a', 'z') | byte_range('A', 'Z') | byte_range('0', '9');
+          bytes.set('_');
+          break;
+        case 's':
+        case 'S':
+          for (char space : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+            bytes.set(static_cast<unsigned char>(space));
+          }
+          break;
+        case 'n':
+          bytes.set('\n');
+          break;
+        case 't':
+          bytes.set('\t');
+          break;
+        case 'r':
+          bytes.set('\r');
+          break;
+        case 'f':
+          bytes.set('\f');
+          break;
+        case 'v':
+          bytes.set('\v');
+          break;
+        case 'x': {
+          if (m_pos + 2 > m_pattern.size()
+              || std::isxdigit(static_cast<unsigned char>(m_pattern[m_pos])) == 0
+              || std::isxdigit(static_cast<unsigned char>(m_pattern[m_pos + 1])) == 0) {
+            fail("\\x needs two hex digits");
+          }
+
+          bytes.set(std::stoul(m_pattern.substr(m_pos, 2), nullptr, 16));
+          m_pos += 2;
+          break;
+        }
+        default:
+          if (std::isalnum(static_cast<unsigned char>(c)) != 0) {
+            fail(std::string("unknown escape \\") + c);
+          }
+
+          // Escaped punctuation stands for itself
+          bytes.set(static_cast<unsigned char>(c));
+      }
+
+      if (c == 'D' || c == 'W' || c == 'S') {
+        bytes.flip();
+      }
+
+      return bytes;
+    }
+
+    // Parses a class after its '['
+    std::bitset<256> parse_class() {
+      bool negated = consume('^');
+      std::bitset<256> bytes;
+      bool first = true;
+
+      while (true) {
+        if (at_end()) {
+          fail("missing ']'");
+        }
+
+        // A ']' right after the '[' or '[^' is a literal
+        if (peek() == ']' && !first) {
+          m_pos++;
+          break;
+        }
+
+        first = false;
+
+        std::bitset<256> item;
+        int low = -1;
+        if (consume('\\')) {
+          item = parse_escape();
+          if (item.count() == 1) {
+            low = lowest_byte(item);
+          }
+        } else {
+          low = static_cast<unsigned char>(m_pattern[m_pos++]);
+          item.set(static_cast<size_t>(low));
+        }
+
+        // A range, unless the '-' is the last character of the class
+        if (low != -1 && m_pos + 1 < m_pattern.size() && peek() == '-'
+            && m_pattern[m_pos + 1] != ']') {
+          m_pos++;
+          int high = static_cast<unsigned char>(m_pattern[m_pos++]);
+          if (high == '\\') {
+            auto escaped = parse_escape();
+            if (escaped.count() != 1) {
+              fail("invalid class range");
+            }
+            high = lowest_byte(escaped);
+          }
+
+          if (high < low) {
+            fail("invalid class range");
+          }
+
+          item = byte_range(low, high);
+        }
+
+        bytes |= item;
+      }
+
+      if (negated) {
+        bytes.flip();
+      }
+
+      return bytes;
+    }
+  };
+
+  // Thompson construction. Each node is compiled in front of its continuation, so no patch lists
+  // are needed. The reversed NFA matches the reversed strings, with the anchors swapped.
+  class NfaCompiler {
+  public:
+    NfaCompiler(Nfa& nfa, bool reversed) : m_nfa(nfa), m_reversed(reversed) {}
+
+    int32_t add(Nfa::NodeType type, int32_t next, int32_t alt = -1) {
+      if (m_nfa.nodes.size() >= MAX_NFA_NODES) {
+        throw LFVException("Regex is too large");
+      }
+
+      m_nfa.nodes.push_back({type, next, alt, {}});
+      return static_cast<int32_t>(m_nfa.nodes.size() - 1);
+    }
+
+    int32_t compile(const RegexNode& node, int32_t next) {
+      switch (node.kind) {
+        case RegexNode::Kind::EMPTY:
+          return next;
+        case RegexNode::Kind::BYTES: {
+          int32_t id = add(Nfa::NodeType::BYTES, next);
+          m_nfa.nodes[static_cast<size_t>(id)].bytes = node.bytes;
+          return id;
+        }
+        case RegexNode::Kind::LINE_START:
+          return add(m_reversed ? Nfa::NodeType::BEFORE_NEWLINE : Nfa::NodeType::AFTER_NEWLINE,
+                     next);
+        case RegexNode::Kind::LINE_END:
+          return add(m_reversed ? Nfa::NodeType::AFTER_NEWLINE : Nfa::NodeType::BEFORE_NEWLINE,
+                     next);
+        case RegexNode::Kind::CONCAT:
+          if (m_reversed) {
+            for (const auto& child : node.children) {
+              next = compile(*child, next);
+            }
+          } else {
+            for (auto it = node.children.rbegin(); it != node.children.rend(); it++) {
+              next = compile(**it, next);
+            }
+          }
+          return next;
+        case RegexNode::Kind::ALTERNATE: {
+          int32_t entry = compile(*node.children.back(), next);
+          for (size_t i = node.children.size() - 1; i-- > 0;) {
+            int32_t branch = compile(*node.children[i], next);
+            entry = add(Nfa::NodeType::SPLIT, branch, entry);
+          }
+          return entry;
+        }
+        case RegexNode::Kind::REPEAT: {
+          const RegexNode& body = *node.children.front();
+          int32_t cont = next;
+
+          if (node.max < 0) {
+            int32_t loop = add(Nfa::NodeType::SPLIT, -1, next);
+            m_nfa.nodes[static_cast<size_t>(loop)].next = compile(body, loop);
+            cont = loop;
+          } else {
+            for (int i = node.min; i < node.max; i++) {
+              int32_t optional = compile(body, cont);
+              cont = add(Nfa::NodeType::SPLIT, optional, cont);
+            }
+          }
+
+          for (int i = 0; i < node.min; i++) {
+            cont = compile(body, cont);
+          }
+
+          return cont;
+        }
+      }
+
+      return next;
+    }
+
+  private:
+    Nfa& m_nfa;
+    bool m_reversed;
+  };
+
+  std::shared_ptr<const Nfa> compile_nfa(const RegexNode& root, bool reversed) {
+    auto nfa = std::make_shared<Nfa>();
+    NfaCompiler compiler(*nfa, reversed);
+    int32_t match = compiler.add(Nfa::NodeType::MATCH, -1);
+    nfa->start = compiler.compile(root, match);
+    return nfa;
+  }
+
+  // Returns the literal every match of node starts with, and whether node only ever matches
+  // exactly that literal, in which case whatever follows it extends the prefix.
+  std::pair<std::string, bool> literal_prefix(const RegexNode& node) {
+    switch (node.kind) {
+      case RegexNode::Kind::EMPTY:
+      case RegexNode::Kind::LINE_START:
+      case RegexNode::Kind::LINE_END:
+        return {"", true};
+      case RegexNode::Kind::BYTES:
+        if (node.bytes.count() == 1) {
+          return {std::string(1, static_cast<char>(lowest_byte(node.bytes))), true};
+        }
+        return {"", false};
+      case RegexNode::Kind::CONCAT: {
+        std::string prefix;
+        for (const auto& child : node.children) {
+          auto [child_prefix, exact] = literal_prefix(*child);
+          prefix += child_prefix;
+          if (!exact) {
+            return {prefix, false};
+          }
+        }
+        return {prefix, true};
+      }
+      case RegexNode::Kind::REPEAT:
+        if (node.min == 0) {
+          return {"", false};
+        }
+        return {literal_prefix(*node.children.front()).first, false};
+      case RegexNode::Kind::ALTERNATE: {
+        std::string common = literal_prefix(*node.children.front()).first;
+        for (const auto& child : node.children) {
+          std::string prefix = literal_prefix(*child).first;
+          auto mismatch = std::mismatch(common.begin(), common.end(), prefix.begin(), prefix.end());
+          common.erase(mismatch.first, common.end());
+        }
+        return {common, false};
+      }
+    }
+
+    return {"", false};
+  }
+
+  // Returns the bytes a match of node can start with, and whether node can match nothing
+  std::pair<std::bitset<256>, bool> first_bytes(const RegexNode& node) {
+    switch (node.kind) {
+      case RegexNode::Kind::EMPTY:
+      case RegexNode::Kind::LINE_START:
+      case RegexNode::Kind::LINE_END:
+        return {{}, true};
+      case RegexNode::Kind::BYTES:
+        return {node.bytes, false};
+      case RegexNode::Kind::CONCAT: {
+        std::bitset<256> bytes;
+        for (const auto& child : node.children) {
+          auto [child_bytes, nullable] = first_bytes(*child);
+          bytes |= child_bytes;
+          if (!nullable) {
+            return {bytes, false};
+          }
+        }
+        return {bytes, true};
+      }
+      case RegexNode::Kind::ALTERNATE: {
+        std::bitset<256> bytes;
+        bool any_nullable = false;
+        for (const auto& child : node.children) {
+          auto [child_bytes, nullable] = first_bytes(*child);
+          bytes |= child_bytes;
+          any_nullable = any_nullable || nullable;
+        }
+        return {bytes, any_nullable};
+      }
+      case RegexNode::Kind::REPEAT: {
+        auto [bytes, nullable] = first_bytes(*node.children.front());
+        return {bytes, nullable || node.min == 0};
+      }
+    }
+
+    return {std::bitset<256>().set(), true};
+  }
+}  // namespace
+
+LazyDfa::LazyDfa(std::shared_ptr<const Nfa> nfa, bool unanchored, size_t max_states)
+    : m_nfa(std::move(nfa)),
+      m_unanchored(unanchored),
+      m_max_states(std::max<size_t>(max_states, 4)) {
+  // Bytes that every node treats alike share a column. Newlines get their own, as the anchors
+  // depend on them.
+  std::set<std::string> seen;
+  std::vector<std::bitset<256>> distinct_sets{std::bitset<256>().set('\n')};
+  for (const auto& node : m_nfa->nodes) {
+    if (node.type == Nfa::NodeType::BYTES && seen.insert(node.bytes.to_string()).second) {
+      distinct_sets.push_back(node.bytes);
+    }
+  }
+
+  std::array<int, 256> classes{};
+  int num_classes = 1;
+  for (const auto& bytes : distinct_sets) {
+    // Split every class by membership of the set
+    std::map<std::pair<int, bool>, int> renumbered;
+    for (size_t c = 0; c < 256; c++) {
+      auto key = std::make_pair(classes[c], bytes.test(c));
+      auto it = renumbered.try_emplace(key, static_cast<int>(renumbered.size())).first;
+      classes[c] = it->second;
+    }
+    num_classes = static_cast<int>(renumbered.size());
+  }
+
+  for (size_t c = 0; c < 256; c++) {
+    m_byte_classes[c] = static_cast<uint8_t>(classes[c]);
+  }
+  m_num_classes = static_cast<size_t>(num_classes);
+}
+
+int32_t LazyDfa::compute_start(bool after_newline) {
+  return intern({closure({m_nfa->start}, after_newline, false), after_newline, false}, true);
+}
+
+int32_t LazyDfa::compute_next(int32_t state, unsigned char byte) {
+  // Copied, as interning may flush the cache
+  StateKey key = m_states[static_cast<size_t>(state) / m_num_classes];
+  const bool is_newline = byte == '\n';
+
+  // A node reached by several groups stays in the earliest one
+  StateKey next_key{{}, is_newline, key.matched};
+  std::vector<char> seen(m_nfa->nodes.size(), 0);
+  auto add_group = [&](const std::vector<int32_t>& group) {
+    bool is_first = true;
+    for (int32_t id : group) {
+      if (seen[static_cast<size_t>(id)] != 0) {
+        continue;
+      }
+      seen[static_cast<size_t>(id)] = 1;
+
+      if (is_first && !next_key.nodes.empty()) {
+        next_key.nodes.push_back(MARK);
+      }
+      is_first = false;
+      next_key.nodes.push_back(id);
+    }
+  };
+
+  for (auto group_begin = key.nodes.begin(); group_begin != key.nodes.end();) {
+    auto group_end = std::find(group_begin, key.nodes.end(), MARK);
+    std::vector<int32_t> group(group_begin, group_end);
+    group_begin = group_end == key.nodes.end() ? group_end : group_end + 1;
+
+    if (is_newline) {
+      // Assertions waiting for a newline pass now
+      group = closure(group, key.after_newline, true);
+    }
+
+    bool group_matched = false;
+    std::vector<int32_t> next_nodes;
+    for (int32_t id : group) {
+      const auto& node = m_nfa->nodes[static_cast<size_t>(id)];
+      if (node.type == Nfa::NodeType::MATCH) {
+        group_matched = true;
+      } else if (node.type == Nfa::NodeType::BYTES && node.bytes.test(byte)) {
+        next_nodes.push_back(node.next);
+      }
+    }
+
+    add_group(closure(next_nodes, is_newline, false));
+
+    // The groups after a match started later, so they cannot make the leftmost one
+    if (group_matched && m_unanchored) {
+      next_key.matched = true;
+      break;
+    }
+  }
+
+  if (m_unanchored && !next_key.matched) {
+    add_group(closure({m_nfa->start}, is_newline, false));
+  }
+
+  // An unanchored DFA waiting for a line start is not dead, as a match may start after a newline
+  if (next_key.nodes.empty() && (!m_unanchored || next_key.matched)) {
+    m_table[static_cast<size_t>(state) + m_byte_classes[byte]] = DEAD;
+    return DEAD;
+  }
+
+  size_t flushes = m_num_flushes;
+  int32_t next_state = intern(std::move(next_key), false);
+
+  // After a flush the old state id means nothing
+  if (flushes == m_num_flushes) {
+    m_table[static_cast<size_t>(state) + m_byte_classes[byte]] = next_state;
+  }
+
+  return next_state;
+}
+
+int32_t LazyDfa::intern(StateKey key, bool is_start) {
+  auto it = m_state_ids.find(key);
+  if (it != m_state_ids.end()) {
+    return it->second;
+  }
+
+  if (m_states.size() >= m_max_states) {
+    flush();
+  }
+
+  std::vector<int32_t> nodes;
+  std::copy_if(key.nodes.begin(), key.nodes.end(), std::back_inserter(nodes),
+               [](int32_t id) { return id != MARK; });
+
+  uint8_t flags = 0;
+  for (int32_t id : closure(nodes, key.after_newline, true)) {
+    if (m_nfa->nodes[static_cast<size_t>(id)].type == Nfa::NodeType::MATCH) {
+      flags |= MATCH_BEFORE_NEWLINE;
+    }
+  }
+
+  for (int32_t id : nodes) {
+    if (m_nfa->nodes[static_cast<size_t>(id)].type == Nfa::NodeType::MATCH) {
+      flags |= MATCH;
+    }
+  }
+
+  if (is_start
+      || (m_unanchored && !key.matched
+          && key.nodes == closure({m_nfa->start}, key.after_newline, false))) {
+    flags |= START;
+  }
+
+  auto id = static_cast<int32_t>(m_table.size());
+  m_states.push_back(key);
+  m_state_ids.emplace(std::move(key), id);
+  m_table.resize(m_table.size() + m_num_classes, UNKNOWN);
+  m_flags.resize(m_table.size(), 0);
+  m_flags[static_cast<size_t>(id)] = flags;
+
+  return id;
+}
+
+void LazyDfa::flush() {
+  m_states.clear();
+  m_state_ids.clear();
+  m_table.clear();
+  m_flags.clear();
+  m_start_states = {UNKNOWN, UNKNOWN};
+  m_num_flushes++;
+}
+
+std::vector<int32_t> LazyDfa::closure(const std::vector<int32_t>& nodes, bool after_newline,
+                                      bool before_newline) const {
+  std::vector<char> visited(m_nfa->nodes.size(), 0);
+  std::vector<int32_t> stack(nodes.begin(), nodes.end());
+  std::vector<int32_t> result;
+
+  while (!stack.empty()) {
+    int32_t id = stack.back();
+    stack.pop_back();
+
+    if (visited[static_cast<size_t>(id)] != 0) {
+      continue;
+    }
+    visited[static_cast<size_t>(id)] = 1;
+
+    const auto& node = m_nfa->nodes[static_cast<size_t>(id)];
+    switch (node.type) {
+      case Nfa::NodeType::BYTES:
+      case Nfa::NodeType::MATCH:
+        result.push_back(id);
+        break;
+      case Nfa::NodeType::SPLIT:
+        stack.push_back(node.alt);
+        stack.push_back(node.next);
+        break;
+      case Nfa::NodeType::AFTER_NEWLINE:
+        if (after_newline) {
+          stack.push_back(node.next);
+        }
+        break;
+      case Nfa::NodeType::BEFORE_NEWLINE:
+        if (before_newline) {
+          stack.push_back(node.next);
+        } else {
+          // Decided by the next byte
+          result.push_back(id);
+        }
+        break;
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+Regex::Regex(const std::string& pattern) : m_pattern(pattern) {
+  if (pattern.empty()) {
+    throw LFVException("Pattern cannot be empty");
+  }
+
+  auto root = RegexParser(pattern).parse();
+
+  m_forward = compile_nfa(*root, false);
+  m_reverse = compile_nfa(*root, true);
+  m_literal_prefix = literal_prefix(*root).first;
+  m_first_bytes = first_bytes(*root).first;
+
+  // With every assertion passing, reaching the match from the start without consuming anything
+  // means the pattern can match nothing, which would never make progress
+  LazyDfa probe(m_forward, false, 4);
+  int32_t start = probe.get_start(true);
+  if (probe.is_match_before_newline(start)) {
+    throw LFVException("Pattern matches the empty string");
+  }
+}
@@ -1,19 +1,84 @@
+#include <LFV/perf_stats.hpp>
 #include <LFV/search_result.hpp>
+#include <algorithm>
+#include <chrono>
 #include <ios>
-#include <mutex>
 
-SearchResult::SearchResult() : m_status(BackgroundTaskStatus::NOT_STARTED) {}
+SearchResult::SearchResult(std::shared_ptr<MatchHistogram> histogram, bool count_only)
+    : m_status(BackgroundTaskStatus::NOT_STARTED),
+      m_histogram(std::move(histogram)),
+      m_count_only(count_only) {}
 
-int SearchResult::get_num_matches() const { return static_cast<int>(m_matches.size()); }
+int64_t SearchResult::get_num_matches() const { return m_matches.size(); }
 
-std::streampos SearchResult::get_match(int index) const {
-  std::scoped_lock<std::mutex> lock(m_mutex);
+std::streampos SearchResult::get_match(int64_t index) const { return m_matches.get(index).first; }
 
-  return m_matches[index];
+void SearchResult::add_match(std::streampos pos) {
+  m_last_match.store(pos, std::memory_order_relaxed);
+  if (!count_match(pos)) {
+    return;
+  }
+
+  m_matches.add(pos, 0);
 }
 
-void SearchResult::add_match(std::streampos pos) {
-  const std::scoped_lock<std::mutex> lock(m_mutex);
+void SearchResult::add_match(std::streampos pos, int32_t pattern) {
+  m_last_match.store(pos, std::memory_order_relaxed);
+  if (!count_match(pos)) {
+    return;
+  }
+
+  m_matches.add(pos, pattern);
+}
+
+void SearchResult::add_match_count(std::streampos pos, int64_t count) {
+  if (count > 0) {
+    count_match(pos, count);
+  }
+}
+
+int32_t SearchResult::get_match_pattern(int64_t index) const {
+  return m_matches.get(index).second;
+}
 
-  m_matches.push_back(pos);
-}
\ No newline at end of file
+namespace {
+  int64_t get_steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+}  // namespace
+
+void SearchResult::start(std::streampos begin) {
+  m_start_pos = begin;
+  m_start_ns = get_steady_ns();
+  set_status(BackgroundTaskStatus::ONGOING);
+}
+
+bool SearchResult::count_match(std::streampos pos, int64_t count) {
+  if (m_num_found.fetch_add(count, std::memory_order_relaxed) == 0) {
+    if (int64_t start_ns = m_start_ns.load(std::memory_order_relaxed); start_ns != -1) {
+      get_perf_stats().first_match.record(std::chrono::nanoseconds(get_steady_ns() - start_ns));
+    }
+  }
+  if (m_histogram != nullptr) {
+    m_histogram->add_to_bucket(m_histogram->get_bucket(pos), static_cast<uint64_t>(count));
+  }
+
+  return !m_count_only;
+}
+
+void SearchResult::stop_timing() {
+  int64_t start_ns = m_start_ns.exchange(-1);
+  if (start_ns == -1) {
+    return;
+  }
+
+  PerfStats& stats = get_perf_stats();
+  stats.num_searches.fetch_add(1, std::memory_order_relaxed);
+  stats.searched_bytes.fetch_add(
+      static_cast<uint64_t>(std::max<std::streamoff>(m_current_pos - m_start_pos, 0)),
+      std::memory_order_relaxed);
+  stats.search_ns.fetch_add(static_cast<uint64_t>(get_steady_ns() - start_ns),
+                            std::memory_order_relaxed);
+}
@@ -0,0 +1,460 @@
+#include <LFV/aho_corasick.hpp>
+#include <LFV/file_extractor.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/search_stream.hpp>
+#include <LFV/substring_search.hpp>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <string>
+#include <utility>
+
+void search_in_stream(std::ifstream&& in, const std::string& pattern, std::streampos begin,
+                      std::streampos end, int64_t match_limit, std::shared_ptr<SearchResult> result,
+                      std::shared_ptr<std::atomic<bool>> aborted) {
+  constexpr std::streamoff BLOCK_SIZE = 1 << 20;
+
+  const SubstringSearcher searcher(pattern);
+
+  // The buffer holds the bytes from buffer_begin on. The last pattern length - 1 bytes of a block
+  // are kept for the next one, so that matches across block borders are found.
+  std::string buffer;
+  std::streamoff buffer_begin = begin;
+  std::streamoff read_pos = begin;
+  const std::streamoff read_end = end;
+
+  in.seekg(begin);
+
+  int64_t count_match = 0;
+
+  result->start(begin);
+
+  while (read_pos < read_end && count_match < match_limit) {
+    if (*aborted) {
+      result->set_status(BackgroundTaskStatus::ABORTED);
+
+      // Exit as we have handled all cleaning up.
+      return;
+    }
+
+    const size_t kept = buffer.size();
+    const auto to_read = static_cast<size_t>(std::min(BLOCK_SIZE, read_end - read_pos));
+
+    buffer.resize(kept + to_read);
+    in.read(buffer.data() + kept, static_cast<std::streamsize>(to_read));
+    buffer.resize(kept + static_cast<size_t>(in.gcount()));
+
+    if (buffer.size() == kept) {
+      // The file is shorter than expected
+      break;
+    }
+
+    read_pos = buffer_begin + static_cast<std::streamoff>(buffer.size());
+
+    searcher.find_all(buffer, [&](size_t offset) {
+      if (count_match >= match_limit) {
+        return false;
+      }
+
+      result->add_match(buffer_begin + static_cast<std::streamoff>(offset));
+      count_match++;
+      return true;
+    });
+
+    result->set_current_pos(read_pos);
+
+    const size_t keep = std::min(pattern.size() - 1, buffer.size());
+    buffer.erase(0, buffer.size() - keep);
+    buffer_begin = read_pos - static_cast<std::streamoff>(keep);
+  }
+
+  result->set_status(BackgroundTaskStatus::FINISHED);
+}
+
+namespace {
+  // Multi-pattern search over blocks handed out by read_block(pos, size), which returns the bytes
+  // from pos on, fewer than size only at the end of the data
+  template <class ReadBlock>
+  void search_any(ReadBlock&& read_block, const std::vector<std::string>& patterns,
+                  std::streamoff begin, std::streamoff end, int64_t match_limit,
+                  const std::shared_ptr<SearchResult>& result, const std::atomic<bool>& aborted,
+                  std::streamoff min_match_end) {
+    constexpr std::streamoff BLOCK_SIZE = 1 << 20;
+
+    const AhoCorasick automaton(patterns);
+    const auto max_len = static_cast<std::streamoff>(automaton.get_max_pattern_length());
+
+    // The automaton reports matches by where they end, and a long match can start before a short
+    // one that ends first. Matches wait in a min-heap until no later match can start before them,
+    // which holds at most max_len positions' worth of matches.
+    using Match = std::pair<std::streamoff, int32_t>;
+    std::priority_queue<Match, std::vector<Match>, std::greater<>> pending;
+
+    int64_t count_match = 0;
+    auto publish_until = [&](std::streamoff limit) {
+      while (!pending.empty() && pending.top().first < limit && count_match < match_limit) {
+        result->add_match(pending.top().first, pending.top().second);
+        pending.pop();
+        count_match++;
+      }
+    };
+
+    std::streamoff read_pos = begin;
+    AhoCorasick::State state = AhoCorasick::INITIAL_STATE;
+
+    result->start(begin);
+
+    while (read_pos < end && count_match < match_limit) {
+      if (aborted) {
+        result->set_status(BackgroundTaskStatus::ABORTED);
+        return;
+      }
+
+      const std::string_view data = read_block(read_pos, std::min(BLOCK_SIZE, end - read_pos));
+      if (data.empty()) {
+        break;
+      }
+
+      state = automaton.feed(state, data, read_pos, [&](std::streamoff match_end, int32_t pattern) {
+        auto length = static_cast<std::streamoff>(
+            automaton.get_pattern_length(static_cast<size_t>(pattern)));
+        if (match_end > min_match_end) {
+          pending.emplace(match_end - length, pattern);
+        }
+
+        // Later matches end after match_end, so they start after match_end - max_len
+        publish_until(match_end - max_len + 1);
+      });
+
+      read_pos += static_cast<std::streamoff>(data.size());
+      result->set_current_pos(read_pos);
+    }
+
+    publish_until(end);
+
+    result->set_status(BackgroundTaskStatus::FINISHED);
+  }
+}  // namespace
+
+void search_any_in_stream(std::ifstream&& in, const std::vector<std::string>& patterns,
+                          std::streampos begin, std::streampos end, int64_t match_limit,
+                          std::shared_ptr<SearchResult> result,
+                          std::shared_ptr<std::atomic<bool>> aborted,
+                          std::streamoff min_match_end) {
+  std::string buffer;
+  in.seekg(begin);
+
+  auto read_block = [&](std::streamoff, std::streamoff size) {
+    buffer.resize(static_cast<size_t>(size));
+    in.read(buffer.data(), static_cast<std::streamsize>(size));
+    return std::string_view(buffer.data(), static_cast<size_t>(in.gcount()));
+  };
+
+  search_any(read_block, patterns, begin, end, match_limit, result, *aborted, min_match_end);
+}
+
+void search_any_in_file(const std::string& fpath, const FileSourceOptions& source_options,
+                        const std::vector<std::string>& patterns, std::streampos begin,
+                        std::streampos end, int64_t match_limit,
+                        std::shared_ptr<SearchResult> result,
+                        std::shared_ptr<std::atomic<bool>> aborted, std::streamoff min_match_end) {
+  FileExtractor extractor(fpath, source_options);
+
+  auto read_block = [&](std::streamoff pos, std::streamoff size) {
+    return extractor.view(pos, pos + size);
+  };
+
+  search_any(read_block, patterns, begin, end, match_limit, result, *aborted, min_match_end);
+}
+
+namespace {
+  // Scans back from match_end with the reverse DFA and returns the leftmost position not before
+  // search_begin where a match ending at match_end starts
+  std::streamoff find_match_begin(FileExtractor& extractor, LazyDfa& reverse,
+                                  std::streamoff search_begin, std::streamoff match_end) {
+    constexpr std::streamoff BLOCK_SIZE = 1 << 16;
+
+    const std::streamoff file_end = extractor.get_end();
+
+    // Going backward, the byte consumed before is the one at match_end
+    int32_t state = reverse.get_start(match_end == file_end || extractor.getc(match_end) == '\n');
+
+    std::streamoff match_begin = match_end;
+    std::streamoff cur = match_end;
+
+    while (cur > search_begin) {
+      const std::streamoff block_begin = std::max(search_begin, cur - BLOCK_SIZE);
+      const std::string_view data = extractor.view(block_begin, cur);
+
+      for (size_t i = data.size(); i-- > 0;) {
+        state = reverse.next(state, static_cast<unsigned char>(data[i]));
+        cur--;
+
+        if (state == LazyDfa::DEAD) {
+          return match_begin;
+        }
+
+        if (reverse.is_special(state)) {
+          bool before_newline = i > 0 ? data[i - 1] == '\n'
+                                      : cur == 0 || extractor.getc(cur - 1) == '\n';
+          if (reverse.is_match(state)
+              || (reverse.is_match_before_newline(state) && before_newline)) {
+            match_begin = cur;
+          }
+        }
+      }
+    }
+
+    return match_begin;
+  }
+}  // namespace
+
+void search_regex_in_file(const std::string& fpath, const Regex& regex, std::streampos begin,
+                          std::streampos end, int64_t match_limit,
+                          std::shared_ptr<SearchResult> result,
+                          std::shared_ptr<std::atomic<bool>> aborted,
+                          const FileSourceOptions& source_options,
+                          std::streampos min_match_begin) {
+  constexpr std::streamoff BLOCK_SIZE = 1 << 20;
+
+  // Separate extractors, so that the reverse scans leave the forward block alone
+  FileExtractor extractor(fpath, source_options);
+  FileExtractor reverse_extractor(fpath, source_options);
+
+  LazyDfa forward = regex.make_forward_dfa();
+  LazyDfa reverse = regex.make_reverse_dfa();
+
+  // While no match is in progress, the DFA is skipped over bytes that cannot start one: with the
+  // substring kernel for a literal prefix, or else by looking up each byte
+  const std::string& prefix = regex.get_literal_prefix();
+  std::optional<SubstringSearcher> prefilter;
+  if (!prefix.empty()) {
+    prefilter.emplace(prefix);
+  }
+
+  const bool use_first_bytes = prefix.empty() && !regex.get_first_bytes().all();
+  std::array<bool, 256> is_first_byte{};
+  for (size_t c = 0; c < 256; c++) {
+    is_first_byte[c] = regex.get_first_bytes().test(c);
+  }
+
+  auto skip = [&](std::string_view data, size_t i) {
+    if (prefilter) {
+      // Without an occurrence, the tail that may hold the beginning of one is kept
+      const char* found = prefilter->find(data.data() + i, data.data() + data.size());
+      return found != nullptr ? static_cast<size_t>(found - data.data())
+                              : data.size() - std::min(data.size() - i, prefix.size() - 1);
+    }
+
+    while (i < data.size() && !is_first_byte[static_cast<unsigned char>(data[i])]) {
+      i++;
+    }
+
+    return i;
+  };
+
+  const std::streamoff file_end = extractor.get_end();
+  const std::streamoff range_begin = begin;
+  const std::streamoff range_end = std::min<std::streamoff>(end, file_end);
+
+  auto after_newline = [&](std::streamoff pos) {
+    return pos == 0 || reverse_extractor.getc(pos - 1) == '\n';
+  };
+
+  int64_t count_match = 0;
+  std::streamoff pos = range_begin;
+  // Where the current match, if any, may start: matches do not overlap
+  std::streamoff search_begin = range_begin;
+  // Where the longest match so far ends, while the DFA runs on to find a longer one
+  std::optional<std::streamoff> match_end;
+  int32_t state = forward.get_start(after_newline(pos));
+
+  auto report_match = [&] {
+    const std::streamoff match_begin
+        = find_match_begin(reverse_extractor, reverse, search_begin, *match_end);
+    if (match_begin >= min_match_begin) {
+      result->add_match(match_begin);
+      count_match++;
+    }
+
+    pos = *match_end;
+    search_begin = pos;
+    match_end.reset();
+    state = forward.get_start(after_newline(pos));
+  };
+
+  result->start(range_begin);
+
+  while (pos < range_end && count_match < match_limit) {
+    if (*aborted) {
+      result->set_status(BackgroundTaskStatus::ABORTED);
+      return;
+    }
+
+    const std::streamoff block_begin = pos;
+    const std::string_view data
+        = extractor.view(block_begin, std::min(block_begin + BLOCK_SIZE, range_end));
+    if (data.empty()) {
+      break;
+    }
+
+    bool is_dead = false;
+    size_t i = 0;
+
+    while (i < data.size()) {
+      if (forward.is_special(state)) {
+        if ((prefilter || use_first_bytes) && forward.is_start(state)) {
+          size_t target = skip(data, i);
+          if (target > i) {
+            i = target;
+            state = forward.get_start(data[i - 1] == '\n');
+            continue;
+          }
+        }
+
+        if (forward.is_match(state)
+            || (forward.is_match_before_newline(state) && data[i] == '\n')) {
+          match_end = block_begin + static_cast<std::streamoff>(i);
+        }
+      }
+
+      // The DFA only dies once the leftmost match can grow no further
+      state = forward.next(state, static_cast<unsigned char>(data[i]));
+      if (state == LazyDfa::DEAD) {
+        is_dead = true;
+        break;
+      }
+      i++;
+    }
+
+    if (is_dead) {
+      report_match();
+    } else {
+      pos = block_begin + static_cast<std::streamoff>(data.size());
+
+      if (pos == range_end) {
+        if (forward.is_match(state)
+            || (forward.is_match_before_newline(state)
+                && (pos == file_end || extractor.getc(pos) == '\n'))) {
+          match_end = pos;
+        }
+
+        if (match_end) {
+          report_match();
+        }
+      }
+    }
+
+    result->set_current_pos(pos);
+  }
+
+  result->set_status(BackgroundTaskStatus::FINISHED);
+}
+
+// NOLINTBEGIN
+void search_in_stream_bmh(std::ifstream&& in, const std::string& pattern_str,
+                          std::streampos begin, std::streampos end, int64_t match_limit,
+                          std::shared_ptr<SearchResult> result,
+                          std::shared_ptr<std::atomic<bool>> aborted) {
+  constexpr int MAX_ALPHABET = 1 << 8;
+  constexpr int MAX_PAT_LEN = 1 << 8;
+
+  const size_t pat_len = pattern_str.size();
+
+  if (pat_len > MAX_PAT_LEN) {
+    throw LFVException("Pattern length exceeded max pattern length");
+  }
+
+  // Copy to array on stack to speed up
+  std::array<int, MAX_PAT_LEN> pattern = {};
+  for (size_t i = 0; i < pat_len; i++) {
+    pattern[i] = static_cast<unsigned char>(pattern_str[i]);
+  }
+
+  // Calculate BMH table
+  std::array<int, MAX_ALPHABET> table = {};
+  for (size_t i = 0; i < MAX_ALPHABET; i++) {
+    table[i] = static_cast<int>(pat_len);
+  }
+
+  for (size_t i = 0; i + 2 <= pat_len; i++) {
+    int ascii = pattern[i];
+
+    table[ascii] = static_cast<int>(pat_len - 1 - i);
+  }
+
+  // Consistent state: buffer always contain file content from in.tellg - patlen to in.tellg - 1
+  // buffer_index always points to the starting point
+  in.seekg(begin);
+
+  std::array<int, MAX_PAT_LEN> buffer = {};
+  size_t buffer_index = 0;
+
+  for (size_t k = 0; k < pat_len; k++) {
+    buffer[k] = in.get();
+  }
+
+  constexpr int32_t HEAVY_CYCLE = 1000;
+  // Run string matching until
+  // - match limit exceeded OR
+  // - reaches EOF
+  int64_t count_match = 0;
+  int update_countdown = HEAVY_CYCLE;
+
+  result->start(begin);
+
+  while (in.tellg() < end && count_match < match_limit) {
+    // We update progress and check exit condition
+    // every cycle/whenever a match is found to avoid overhead.
+    update_countdown--;
+    if (update_countdown == 0) {
+      result->set_current_pos(in.tellg());
+      update_countdown = HEAVY_CYCLE;
+      if (*aborted) {
+        result->set_status(BackgroundTaskStatus::ABORTED);
+
+        // Exit as we have handled all cleaning up.
+        return;
+      }
+    }
+
+    bool same = true;
+    for (size_t j = 0, k = buffer_index; same && j < pat_len; j++, k++) {
+      if (k >= pat_len) {
+        k -= pat_len;
+      }
+
+      same &= pattern[j] == buffer[k];
+    }
+
+    int forward_steps = 1;
+
+    if (same) {
+      result->add_match(in.tellg() - (std::streampos)pat_len);
+      count_match++;
+
+      forward_steps = std::min(1, (int)(end - in.tellg()));
+    } else {
+      int last_char = buffer_index == 0 ? buffer[pat_len - 1] : buffer[buffer_index - 1];
+      forward_steps = std::min(table[last_char], (int)(end - in.tellg()));
+    }
+
+    if (forward_steps == 0) {
+      break;
+    }
+
+    // Read some amount forward
+    for (int k = 0; k < forward_steps; k++) {
+      buffer[buffer_index] = in.get();
+      buffer_index++;
+      if (buffer_index == pat_len) {
+        buffer_index = 0;
+      }
+    }
+  }
+
+  result->set_status(BackgroundTaskStatus::FINISHED);
+}
+// NOLINTEND
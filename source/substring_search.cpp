@@ -0,0 +1,131 @@
+#include <LFV/byte_scan.hpp>
+#include <LFV/simd.hpp>
+#include <LFV/substring_search.hpp>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+  const char* find_scalar(const char* first, const char* last, const char* pattern,
+                          size_t pat_len) {
+    const char first_byte = pattern[0];
+    const char last_byte = pattern[pat_len - 1];
+
+    for (; last - first >= static_cast<std::ptrdiff_t>(pat_len); first++) {
+      if (first[0] == first_byte && first[pat_len - 1] == last_byte
+          && std::memcmp(first + 1, pattern + 1, pat_len - 2) == 0) {
+        return first;
+      }
+    }
+
+    return nullptr;
+  }
+
+#ifdef LFV_HAS_X86_SIMD
+  // NOLINTBEGIN
+  // Verifies the candidates flagged in mask, lowest offset first
+  const char* verify_candidates(const char* block, uint32_t mask, const char* pattern,
+                                size_t pat_len) {
+    while (mask != 0) {
+      int offset = __builtin_ctz(mask);
+      if (std::memcmp(block + offset + 1, pattern + 1, pat_len - 2) == 0) {
+        return block + offset;
+      }
+
+      mask &= mask - 1;
+    }
+
+    return nullptr;
+  }
+
+  const char* find_sse2(const char* first, const char* last, const char* pattern,
+                        size_t pat_len) {
+    const __m128i first_byte = _mm_set1_epi8(pattern[0]);
+    const __m128i last_byte = _mm_set1_epi8(pattern[pat_len - 1]);
+
+    // Candidates start before candidates_end, and a whole vector of them is available while
+    // first + 16 <= candidates_end
+    const char* candidates_end = last - pat_len + 1;
+
+    for (; candidates_end - first >= 16; first += 16) {
+      __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+      __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + pat_len - 1));
+      __m128i both
+          = _mm_and_si128(_mm_cmpeq_epi8(head, first_byte), _mm_cmpeq_epi8(tail, last_byte));
+
+      auto mask = static_cast<uint32_t>(_mm_movemask_epi8(both));
+      if (mask != 0) {
+        if (const char* found = verify_candidates(first, mask, pattern, pat_len)) {
+          return found;
+        }
+      }
+    }
+
+    return find_scalar(first, last, pattern, pat_len);
+  }
+
+  LFV_TARGET_AVX2 const char* find_avx2(const char* first, const char* last, const char* pattern,
+                                        size_t pat_len) {
+    const __m256i first_byte = _mm256_set1_epi8(pattern[0]);
+    const __m256i last_byte = _mm256_set1_epi8(pattern[pat_len - 1]);
+    const char* candidates_end = last - pat_len + 1;
+
+    for (; candidates_end - first >= 32; first += 32) {
+      __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+      __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + pat_len - 1));
+      __m256i both = _mm256_and_si256(_mm256_cmpeq_epi8(head, first_byte),
+                                      _mm256_cmpeq_epi8(tail, last_byte));
+
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(both));
+      if (mask != 0) {
+        if (const char* found = verify_candidates(first, mask, pattern, pat_len)) {
+          return found;
+        }
+      }
+    }
+
+    return find_sse2(first, last, pattern, pat_len);
+  }
+  // NOLINTEND
+#endif
+
+  std::vector<SubstringKernel> detect_kernels() {
+    std::vector<SubstringKernel> kernels{{"scalar", find_scalar}};
+
+#ifdef LFV_HAS_X86_SIMD
+    kernels.push_back({"sse2", find_sse2});
+
+    if (__builtin_cpu_supports("avx2")) {
+      kernels.push_back({"avx2", find_avx2});
+    }
+#endif
+
+    return kernels;
+  }
+}  // namespace
+
+const std::vector<SubstringKernel>& available_substring_kernels() {
+  static const std::vector<SubstringKernel> kernels = detect_kernels();
+  return kernels;
+}
+
+const SubstringKernel& substring_kernel() {
+  static const SubstringKernel& kernel = available_substring_kernels().back();
+  return kernel;
+}
+
+SubstringSearcher::SubstringSearcher(std::string pattern, const SubstringKernel& kernel)
+    : m_pattern(std::move(pattern)), m_kernel(&kernel) {}
+
+const char* SubstringSearcher::find(const char* first, const char* last) const {
+  const size_t pat_len = m_pattern.size();
+
+  if (pat_len == 0 || last - first < static_cast<std::ptrdiff_t>(pat_len)) {
+    return nullptr;
+  }
+
+  if (pat_len == 1) {
+    return find_byte(first, last, m_pattern[0]);
+  }
+
+  return m_kernel->find(first, last, m_pattern.data(), pat_len);
+}
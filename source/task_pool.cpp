@@ -0,0 +1,168 @@
+#include <LFV/lfv_exception.hpp>
+#include <LFV/task_pool.hpp>
+#include <LFV/tracer.hpp>
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <utility>
+
+const CancellationToken& TaskHandle::get_token() const {
+  static const CancellationToken no_task = std::make_shared<std::atomic<bool>>(true);
+  return m_state != nullptr ? m_state->token : no_task;
+}
+
+void TaskHandle::wait() const {
+  if (m_state == nullptr) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_state->mutex);
+  m_state->done_cv.wait(lock, [this] { return is_done(); });
+}
+
+std::string TaskHandle::get_error() const {
+  if (m_state == nullptr) {
+    return "";
+  }
+
+  std::scoped_lock<std::mutex> lock(m_state->mutex);
+  return m_state->error;
+}
+
+void TaskHandle::finish(BackgroundTaskStatus status, std::string error) const {
+  {
+    std::scoped_lock<std::mutex> lock(m_state->mutex);
+    m_state->error = std::move(error);
+    m_state->status = status;
+  }
+  m_state->done_cv.notify_all();
+}
+
+TaskPool::TaskPool(size_t num_threads, size_t queue_capacity)
+    : m_queue_capacity(std::max<size_t>(queue_capacity, 1)) {
+  if (num_threads == 0) {
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  m_workers.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    m_workers.emplace_back([this, i] {
+      get_tracer().set_thread_name("Task pool worker " + std::to_string(i + 1));
+      work();
+    });
+  }
+}
+
+TaskPool::~TaskPool() { shutdown(); }
+
+TaskHandle TaskPool::submit(Task task, TaskPriority priority) {
+  TaskHandle handle(std::make_shared<TaskHandle::State>());
+
+  {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+
+    if (m_stopping) {
+      throw LFVException("The task pool is shut down");
+    }
+
+    if (m_queue.size() >= m_queue_capacity) {
+      throw LFVException("Too many background tasks queued");
+    }
+
+    m_queue.push({priority, m_next_sequence++, std::move(task), handle});
+  }
+
+  m_cv.notify_one();
+  return handle;
+}
+
+size_t TaskPool::get_num_queued() const {
+  std::scoped_lock<std::mutex> lock(m_mutex);
+  return m_queue.size();
+}
+
+void TaskPool::shutdown() {
+  {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    if (m_stopping) {
+      return;
+    }
+    m_stopping = true;
+
+    for (const TaskHandle& handle : m_running) {
+      handle.cancel();
+    }
+  }
+
+  // Workers drop what is left in the queue on their way out
+  m_cv.notify_all();
+
+  for (std::thread& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void TaskPool::work() {
+  while (true) {
+    QueuedTask queued;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+
+      if (m_queue.empty()) {
+        // Stopping with nothing left
+        return;
+      }
+
+      // The queue only hands out const references
+      queued = std::move(const_cast<QueuedTask&>(m_queue.top()));  // NOLINT
+      m_queue.pop();
+
+      if (m_stopping) {
+        queued.handle.cancel();
+      }
+
+      if (*queued.handle.get_token()) {
+        lock.unlock();
+        finish(queued.handle, BackgroundTaskStatus::ABORTED);
+        continue;
+      }
+
+      m_running.push_back(queued.handle);
+      queued.handle.m_state->status = BackgroundTaskStatus::ONGOING;
+    }
+
+    BackgroundTaskStatus status = BackgroundTaskStatus::FINISHED;
+    std::string error;
+    try {
+      queued.task(queued.handle.get_token());
+    } catch (std::exception const& e) {
+      status = BackgroundTaskStatus::ABORTED;
+      error = e.what();
+    } catch (...) {
+      status = BackgroundTaskStatus::ABORTED;
+      error = "Unknown error";
+    }
+
+    if (*queued.handle.get_token()) {
+      status = BackgroundTaskStatus::ABORTED;
+    }
+
+    {
+      std::scoped_lock<std::mutex> lock(m_mutex);
+      m_running.erase(std::find_if(m_running.begin(), m_running.end(),
+                                   [&](const TaskHandle& handle) {
+                                     return handle.m_state == queued.handle.m_state;
+                                   }));
+    }
+
+    finish(queued.handle, status, std::move(error));
+  }
+}
+
+void TaskPool::finish(const TaskHandle& handle, BackgroundTaskStatus status, std::string error) {
+  handle.finish(status, std::move(error));
+  if (m_notifier != nullptr) {
+    m_notifier->notify();
+  }
+}
@@ -0,0 +1,162 @@
+#include <LFV/json.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <LFV/tracer.hpp>
+#include <cstdio>
+#include <functional>
+
+namespace {
+  std::atomic<uint64_t> g_next_tracer_id = 1;
+
+  // The buffer of the calling thread and the tracer it belongs to. The buffer is handed back when
+  // the thread exits or records for another tracer.
+  struct ThreadSlot {
+    uint64_t tracer_id = 0;
+    void* buffer = nullptr;
+    std::function<void()> release;
+
+    ThreadSlot() = default;
+    ThreadSlot(const ThreadSlot&) = delete;
+    ThreadSlot& operator=(const ThreadSlot&) = delete;
+
+    ~ThreadSlot() { reset(); }
+
+    void reset() {
+      if (release) {
+        release();
+      }
+      tracer_id = 0;
+      buffer = nullptr;
+      release = nullptr;
+    }
+  };
+
+  thread_local ThreadSlot t_slot;
+  thread_local std::string t_thread_name;
+
+  double get_micros(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  }
+}  // namespace
+
+Tracer::Tracer()
+    : m_id(g_next_tracer_id.fetch_add(1)), m_registry(std::make_shared<Registry>()) {}
+
+void Tracer::start() {
+  m_origin = std::chrono::steady_clock::now();
+  m_enabled = true;
+}
+
+void Tracer::set_thread_name(const std::string& name) {
+  t_thread_name = name;
+
+  // Registering the buffer now keeps its allocation out of the first span
+  if (is_enabled() || t_slot.tracer_id == m_id) {
+    ThreadBuffer& buffer = get_thread_buffer();
+    const std::scoped_lock<std::mutex> lock(m_registry->mutex);
+    buffer.name = name;
+  }
+}
+
+void Tracer::record(const char* name, std::chrono::steady_clock::time_point begin,
+                    std::chrono::steady_clock::time_point end) {
+  ThreadBuffer& buffer = get_thread_buffer();
+  const uint64_t index = buffer.num_recorded.load(std::memory_order_relaxed);
+  buffer.events[index % EVENTS_PER_THREAD] = {name, begin, end};
+  buffer.num_recorded.store(index + 1, std::memory_order_release);
+}
+
+Tracer::ThreadBuffer& Tracer::get_thread_buffer() {
+  if (t_slot.tracer_id == m_id) {
+    return *static_cast<ThreadBuffer*>(t_slot.buffer);
+  }
+
+  t_slot.reset();
+
+  ThreadBuffer* buffer = nullptr;
+  {
+    const std::scoped_lock<std::mutex> lock(m_registry->mutex);
+    if (!m_registry->free_buffers.empty()) {
+      buffer = m_registry->free_buffers.back();
+      m_registry->free_buffers.pop_back();
+      buffer->name = t_thread_name;
+    }
+  }
+
+  if (buffer == nullptr) {
+    auto new_buffer = std::make_unique<ThreadBuffer>();
+    new_buffer->name = t_thread_name;
+    new_buffer->events.resize(EVENTS_PER_THREAD);
+
+    const std::scoped_lock<std::mutex> lock(m_registry->mutex);
+    new_buffer->tid = m_registry->buffers.size() + 1;
+    buffer = new_buffer.get();
+    m_registry->buffers.push_back(std::move(new_buffer));
+  }
+
+  t_slot.tracer_id = m_id;
+  t_slot.buffer = buffer;
+  t_slot.release = [registry = std::weak_ptr<Registry>(m_registry), buffer] {
+    if (auto owner = registry.lock(); owner != nullptr) {
+      const std::scoped_lock<std::mutex> lock(owner->mutex);
+      owner->free_buffers.push_back(buffer);
+    }
+  };
+
+  return *buffer;
+}
+
+void Tracer::write(const std::string& fpath) const {
+  std::FILE* out = std::fopen(fpath.c_str(), "w");
+  if (out == nullptr) {
+    throw LFVException("Cannot write the trace to " + fpath);
+  }
+
+  const std::scoped_lock<std::mutex> lock(m_registry->mutex);
+  bool first = true;
+  auto begin_event = [&] {
+    std::fprintf(out, "%s\n", first ? "" : ",");
+    first = false;
+  };
+
+  std::fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  for (const auto& buffer : m_registry->buffers) {
+    const auto tid = static_cast<unsigned long long>(buffer->tid);
+    if (!buffer->name.empty()) {
+      begin_event();
+      std::fprintf(out, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %llu, "
+                   "\"args\": {\"name\": ", tid);
+      print_json_string(out, buffer->name);
+      std::fprintf(out, "}}");
+    }
+
+    // Older spans were overwritten when the ring buffer wrapped
+    const uint64_t num_recorded = buffer->num_recorded.load(std::memory_order_acquire);
+    const uint64_t first_kept = num_recorded > EVENTS_PER_THREAD
+                                    ? num_recorded - EVENTS_PER_THREAD
+                                    : 0;
+    for (uint64_t index = first_kept; index < num_recorded; index++) {
+      const Event& event = buffer->events[index % EVENTS_PER_THREAD];
+      begin_event();
+      std::fprintf(out, "{\"name\": ");
+      print_json_string(out, event.name);
+      std::fprintf(out, ", \"cat\": \"lfv\", \"ph\": \"X\", \"pid\": 1, \"tid\": %llu, "
+                   "\"ts\": %.3f, \"dur\": %.3f}", tid,
+                   get_micros(event.begin - m_origin), get_micros(event.end - event.begin));
+    }
+  }
+  std::fprintf(out, "\n]}\n");
+
+  if (std::fclose(out) != 0) {
+    throw LFVException("Cannot write the trace to " + fpath);
+  }
+}
+
+size_t Tracer::get_num_buffers() const {
+  const std::scoped_lock<std::mutex> lock(m_registry->mutex);
+  return m_registry->buffers.size();
+}
+
+Tracer& get_tracer() {
+  static Tracer tracer;
+  return tracer;
+}
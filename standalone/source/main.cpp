@@ -1,17 +1,190 @@
 #include <LFV/app.hpp>
+#include <LFV/batch.hpp>
+#include <LFV/file_source.hpp>
+#include <LFV/lfv_exception.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cxxopts.hpp>
 #include <exception>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 
-int main(int argc, char** argv) {
-  if (argc < 2) {
-    std::cerr << "Missing file path";
+namespace {
+  void add_source_options(cxxopts::Options& options) {
+    options.add_options()("no-mmap", "Read through the page cache instead of mapping the file");
+  }
+
+  FileSourceOptions get_source_options(const cxxopts::ParseResult& parse_result) {
+    FileSourceOptions source_options;
+    source_options.use_mmap = parse_result.count("no-mmap") == 0;
+    return source_options;
+  }
+
+  // FIRST:LAST, FIRST: or a single line
+  std::pair<std::streamoff, std::optional<std::streamoff>> parse_line_range(
+      const std::string& range) {
+    try {
+      size_t colon = range.find(':');
+      std::streamoff first = std::stoll(range.substr(0, colon));
+      if (colon == std::string::npos) {
+        return {first, first};
+      }
+      if (colon + 1 == range.size()) {
+        return {first, std::nullopt};
+      }
+      return {first, std::stoll(range.substr(colon + 1))};
+    } catch (std::logic_error const&) {
+      throw LFVException("Invalid line range: " + range);
+    }
+  }
+
+  // Exits with 0 if there are matches, or 1 if there are none, as grep does
+  int run_search(int argc, char** argv) {
+    cxxopts::Options options("LFV search", "Print where a pattern is found");
+    options.add_options()("pattern", "Pattern to search", cxxopts::value<std::string>())(
+        "file", "File to search", cxxopts::value<std::string>())(
+        "f,from", "Starting position in bytes", cxxopts::value<long long>()->default_value("0"))(
+        "t,to", "Ending position in bytes, the end of the file by default",
+        cxxopts::value<long long>())(
+        "j,jobs", "Number of threads to search with",
+        cxxopts::value<unsigned>()->default_value(
+            std::to_string(std::max(1U, std::thread::hardware_concurrency()))))(
+        "r,regex", "Treat the pattern as a regular expression")(
+        "c,count", "Only print the number of matches");
+    add_source_options(options);
+    options.parse_positional({"pattern", "file"});
+
+    auto parse_result = options.parse(argc, argv);
+    if (parse_result.count("pattern") == 0 || parse_result.count("file") == 0) {
+      throw LFVException("Usage: LFV search PATTERN FILE [-f FROM] [-t TO] [-r] [-c] [-j JOBS]");
+    }
+
+    BatchSearch search;
+    search.pattern = parse_result["pattern"].as<std::string>();
+    search.regex = parse_result.count("regex") != 0;
+    search.from = parse_result["from"].as<long long>();
+    if (parse_result.count("to") != 0) {
+      search.to = parse_result["to"].as<long long>();
+    }
+    search.count_only = parse_result.count("count") != 0;
+    search.jobs = parse_result["jobs"].as<unsigned>();
+
+    int64_t num_found = run_batch_search(parse_result["file"].as<std::string>(),
+                                         get_source_options(parse_result), search, stdout);
+    return num_found > 0 ? 0 : 1;
+  }
+
+  int run_lines(int argc, char** argv) {
+    cxxopts::Options options("LFV lines", "Print a range of lines, counting from 1");
+    options.add_options()("file", "File to read", cxxopts::value<std::string>())(
+        "range", "FIRST:LAST, FIRST: or LINE", cxxopts::value<std::string>())(
+        "no-index-cache", "Do not use the line index saved by the viewer");
+    add_source_options(options);
+    options.parse_positional({"file", "range"});
+
+    auto parse_result = options.parse(argc, argv);
+    if (parse_result.count("file") == 0 || parse_result.count("range") == 0) {
+      throw LFVException("Usage: LFV lines FILE FIRST:LAST");
+    }
+
+    auto [first, last] = parse_line_range(parse_result["range"].as<std::string>());
+    run_batch_lines(parse_result["file"].as<std::string>(), get_source_options(parse_result),
+                    first, last, stdout,
+                    parse_result.count("no-index-cache") != 0 ? ""
+                                                              : get_default_index_cache_dir());
     return 0;
   }
 
-  const std::string fpath(argv[1]);
+  int run_slice(int argc, char** argv) {
+    cxxopts::Options options("LFV slice", "Print a range of bytes");
+    options.add_options()("file", "File to read", cxxopts::value<std::string>())(
+        "offset", "Position of the first byte", cxxopts::value<long long>())(
+        "length", "Number of bytes", cxxopts::value<long long>());
+    add_source_options(options);
+    options.parse_positional({"file", "offset", "length"});
+
+    auto parse_result = options.parse(argc, argv);
+    if (parse_result.count("file") == 0 || parse_result.count("offset") == 0
+        || parse_result.count("length") == 0) {
+      throw LFVException("Usage: LFV slice FILE OFFSET LENGTH");
+    }
+
+    run_batch_slice(parse_result["file"].as<std::string>(), get_source_options(parse_result),
+                    parse_result["offset"].as<long long>(),
+                    parse_result["length"].as<long long>(), stdout);
+    return 0;
+  }
+
+  // Commands run without the viewer, or nothing if argv does not start with one. Exits with 2 on
+  // errors.
+  std::optional<int> run_batch_command(int argc, char** argv) {
+    if (argc < 2) {
+      return std::nullopt;
+    }
+
+    const std::string command = argv[1];
+    int (*run)(int, char**) = command == "search"  ? run_search
+                              : command == "lines" ? run_lines
+                              : command == "slice" ? run_slice
+                                                   : nullptr;
+    if (run == nullptr) {
+      return std::nullopt;
+    }
+
+    try {
+      return run(argc - 1, argv + 1);
+    } catch (std::exception const& e) {
+      std::cerr << e.what() << '\n';
+      return 2;
+    }
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (auto exit_code = run_batch_command(argc, argv); exit_code) {
+    return *exit_code;
+  }
+
+  cxxopts::Options options("LFV", "Large file viewer");
+  options.add_options()("file", "File to view", cxxopts::value<std::string>())(
+      "no-mmap", "Read through the page cache instead of mapping the file")(
+      "page-size", "Page size of the page cache in bytes",
+      cxxopts::value<size_t>()->default_value("65536"))(
+      "cache-pages", "Number of pages kept by the page cache",
+      cxxopts::value<size_t>()->default_value("64"))(
+      "max-fps", "Maximum redraws per second while background tasks progress",
+      cxxopts::value<int32_t>()->default_value(std::to_string(ChangeNotifier::DEFAULT_MAX_RATE)))(
+      "f,follow", "Show the end of the file and follow it as it grows")(
+      "no-index-cache", "Neither read nor save the line index and searches of the file")(
+      "trace", "Write a Chrome trace of the work of each thread to this file on exit",
+      cxxopts::value<std::string>());
+  options.parse_positional({"file"});
 
   try {
-    run_app(fpath);
+    auto parse_result = options.parse(argc, argv);
+
+    if (parse_result.count("file") == 0) {
+      std::cerr << "Missing file path";
+      return 0;
+    }
+
+    const auto fpath = parse_result["file"].as<std::string>();
+
+    FileSourceOptions source_options;
+    source_options.use_mmap = parse_result.count("no-mmap") == 0;
+    source_options.page_size = parse_result["page-size"].as<size_t>();
+    source_options.cache_pages = parse_result["cache-pages"].as<size_t>();
+
+    const std::string trace_fpath
+        = parse_result.count("trace") != 0 ? parse_result["trace"].as<std::string>() : "";
+
+    run_app(fpath, source_options, parse_result["max-fps"].as<int32_t>(),
+            parse_result.count("follow") != 0, parse_result.count("no-index-cache") == 0,
+            trace_fpath);
   } catch (std::exception const& e) {
     std::cerr << e.what();
   } catch (...) {
@@ -0,0 +1,194 @@
+#include <doctest/doctest.h>
+#include <zlib.h>
+
+#include <LFV/batch.hpp>
+#include <LFV/file_extractor.hpp>
+#include <LFV/line_index.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+  // Lines of 0 to 199 letters, numbered so that each is different
+  std::string make_batch_content(int num_lines) {
+    std::mt19937 rng(21);
+    std::string content;
+    for (int line = 0; line < num_lines; line++) {
+      content += std::to_string(line) + ":";
+      content += std::string(rng() % 200, "xyz"[rng() % 3]);
+      content += '\n';
+    }
+
+    return content;
+  }
+
+  // What a command printed
+  template <typename Run> std::string capture(Run&& run) {
+    std::FILE* out = std::tmpfile();
+    if (out == nullptr) {
+      throw std::runtime_error("Cannot create a temporary file");
+    }
+    run(out);
+
+    std::string printed;
+    std::rewind(out);
+    char buffer[4096];
+    for (size_t count; (count = std::fread(buffer, 1, sizeof(buffer), out)) > 0;) {
+      printed.append(buffer, count);
+    }
+    std::fclose(out);
+
+    return printed;
+  }
+
+  // The lines from first to last, counting from 1
+  std::string get_lines(const std::string& content, size_t first, size_t last) {
+    size_t begin = 0;
+    for (size_t line = 1; line < first && begin != std::string::npos; line++) {
+      begin = content.find('\n', begin);
+      begin = begin == std::string::npos ? begin : begin + 1;
+    }
+    if (begin == std::string::npos) {
+      return "";
+    }
+
+    size_t end = begin;
+    for (size_t line = first; line <= last && end < content.size(); line++) {
+      end = content.find('\n', end);
+      end = end == std::string::npos ? content.size() : end + 1;
+    }
+
+    return content.substr(begin, end - begin);
+  }
+}  // namespace
+
+TEST_CASE("Test batch search") {
+  const std::string content = make_batch_content(100000);
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_batch_search.txt";
+  std::ofstream(fpath, std::ios_base::binary) << content;
+
+  BatchSearch search;
+  search.pattern = "zz\n1";
+  search.jobs = 4;
+
+  std::string expected;
+  int64_t num_expected = 0;
+  for (size_t pos = content.find(search.pattern); pos != std::string::npos;
+       pos = content.find(search.pattern, pos + 1)) {
+    expected += std::to_string(pos) + "\n";
+    num_expected++;
+  }
+  REQUIRE(num_expected > 0);
+
+  int64_t num_found = 0;
+  CHECK(capture([&](std::FILE* out) { num_found = run_batch_search(fpath, {}, search, out); })
+        == expected);
+  CHECK(num_found == num_expected);
+
+  search.count_only = true;
+  CHECK(capture([&](std::FILE* out) { run_batch_search(fpath, {}, search, out); })
+        == std::to_string(num_expected) + "\n");
+
+  // A regex, within a range
+  search.pattern = "^4242:";
+  search.regex = true;
+  search.count_only = false;
+  search.from = 1000;
+  search.to = static_cast<std::streamoff>(content.size());
+  CHECK(capture([&](std::FILE* out) { run_batch_search(fpath, {}, search, out); })
+        == std::to_string(content.find("\n4242:") + 1) + "\n");
+
+  search.pattern = "no such line";
+  search.regex = false;
+  CHECK(capture([&](std::FILE* out) { CHECK(run_batch_search(fpath, {}, search, out) == 0); })
+        .empty());
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test batch lines and slices") {
+  const std::string content = make_batch_content(50000) + "unterminated";
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_batch_lines.txt";
+  std::ofstream(fpath, std::ios_base::binary) << content;
+  const auto dir = std::filesystem::temp_directory_path() / "lfv_batch_index_cache";
+  std::filesystem::remove_all(dir);
+
+  auto check_lines = [&](const std::string& cache_dir) {
+    for (auto [first, last] : {std::pair{1, 1}, std::pair{1, 10}, std::pair{12345, 12400},
+                               std::pair{49990, 50001}, std::pair{50001, 50001},
+                               std::pair{50002, 50010}}) {
+      CHECK(capture([&](std::FILE* out) {
+              run_batch_lines(fpath, {}, first, last, out, cache_dir);
+            })
+            == get_lines(content, first, last));
+    }
+
+    CHECK(capture([&](std::FILE* out) {
+            run_batch_lines(fpath, {}, 49999, std::nullopt, out, cache_dir);
+          })
+          == get_lines(content, 49999, 50001));
+  };
+
+  check_lines("");
+
+  // The same through a saved line index
+  {
+    FileExtractor extractor(fpath);
+    LineIndex index(64);
+    std::atomic<bool> aborted = false;
+    index.build(extractor, aborted);
+    IndexCache(fpath, dir.string()).save(index, {});
+  }
+  check_lines(dir.string());
+
+  CHECK_THROWS_AS(run_batch_lines(fpath, {}, 10, 9, stdout, ""), LFVException);
+
+  // Slices larger than a write go out whole, and stop at the end of the file
+  FileSourceOptions paged;
+  paged.use_mmap = false;
+  for (const FileSourceOptions& options : {FileSourceOptions{}, paged}) {
+    CHECK(capture([&](std::FILE* out) { run_batch_slice(fpath, options, 100, 50, out); })
+          == content.substr(100, 50));
+    CHECK(capture([&](std::FILE* out) {
+            run_batch_slice(fpath, options, 10, static_cast<std::streamoff>(content.size()), out);
+          })
+          == content.substr(10));
+    CHECK(capture([&](std::FILE* out) {
+            run_batch_slice(fpath, options, static_cast<std::streamoff>(content.size()) + 5, 5,
+                            out);
+          })
+          .empty());
+  }
+
+  // A gzip file is read decompressed
+  const std::string gzip_fpath = fpath + ".gz";
+  gzFile gzip_out = gzopen(gzip_fpath.c_str(), "wb");
+  REQUIRE(gzip_out != nullptr);
+  gzwrite(gzip_out, content.data(), static_cast<unsigned>(content.size()));
+  gzclose(gzip_out);
+  for (auto [first, last] : {std::pair{1, 1}, std::pair{300, 310}, std::pair{49990, 50001},
+                             std::pair{50002, 50010}}) {
+    CHECK(capture([&](std::FILE* out) {
+            run_batch_lines(gzip_fpath, {}, first, last, out, "");
+          })
+          == get_lines(content, first, last));
+  }
+  CHECK(capture([&](std::FILE* out) {
+          run_batch_lines(gzip_fpath, {}, 49999, std::nullopt, out, "");
+        })
+        == get_lines(content, 49999, 50001));
+  CHECK(capture([&](std::FILE* out) { run_batch_slice(gzip_fpath, {}, 100, 50, out); })
+        == content.substr(100, 50));
+  CHECK(capture([&](std::FILE* out) {
+          run_batch_slice(gzip_fpath, {}, 10, static_cast<std::streamoff>(content.size()), out);
+        })
+        == content.substr(10));
+
+  std::filesystem::remove(gzip_fpath);
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(fpath);
+}
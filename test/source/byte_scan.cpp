@@ -0,0 +1,47 @@
+#include <doctest/doctest.h>
+
+#include <LFV/byte_scan.hpp>
+#include <random>
+#include <string>
+
+TEST_CASE("Test byte scan kernels agree with a plain scan") {
+  std::mt19937 rng(42);
+  // Long enough for the count kernels to flush their byte lanes
+  std::string data(20000, 'x');
+  for (char& c : data) {
+    c = static_cast<char>('a' + rng() % 26);
+  }
+
+  const char* base = data.data();
+
+  for (const ByteScanKernel& kernel : available_byte_scan_kernels()) {
+    // Every alignment and length around the vector widths
+    for (size_t begin = 0; begin < 70; begin++) {
+      for (size_t end = begin; end <= data.size(); end += 997) {
+        for (char target : {'a', 'q', '#'}) {
+          size_t expected_first = data.find(target, begin);
+          if (expected_first >= end) {
+            expected_first = std::string::npos;
+          }
+
+          size_t expected_last = end == begin ? std::string::npos : data.rfind(target, end - 1);
+          if (expected_last != std::string::npos && expected_last < begin) {
+            expected_last = std::string::npos;
+          }
+
+          const char* first = kernel.find_first(base + begin, base + end, target);
+          const char* last = kernel.find_last(base + begin, base + end, target);
+
+          CHECK((first == nullptr ? std::string::npos : first - base) == expected_first);
+          CHECK((last == nullptr ? std::string::npos : last - base) == expected_last);
+
+          size_t expected_count = 0;
+          for (size_t i = begin; i < end; i++) {
+            expected_count += static_cast<size_t>(data[i] == target);
+          }
+          CHECK(kernel.count(base + begin, base + end, target) == expected_count);
+        }
+      }
+    }
+  }
+}
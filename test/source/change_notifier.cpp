@@ -0,0 +1,53 @@
+#include <doctest/doctest.h>
+
+#include <LFV/change_notifier.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST_CASE("Test change notifier coalesces notifications") {
+  ChangeNotifier notifier(20);
+  std::atomic<int> deliveries = 0;
+  std::thread consumer([&] { notifier.run([&] { deliveries++; }); });
+
+  // Nothing is delivered while nothing changes
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CHECK(deliveries == 0);
+
+  // A burst is delivered at most once per 50 ms
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(300)) {
+    notifier.notify();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // The last notification is still delivered
+  while (notifier.get_num_deliveries() == 0 || deliveries < notifier.get_num_deliveries()) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  CHECK(deliveries >= 2);
+  CHECK(deliveries <= elapsed / std::chrono::milliseconds(50) + 2);
+
+  notifier.stop();
+  consumer.join();
+}
+
+TEST_CASE("Test change notifier stops while waiting") {
+  ChangeNotifier notifier(1);
+  std::atomic<int> deliveries = 0;
+  std::thread consumer([&] { notifier.run([&] { deliveries++; }); });
+
+  notifier.notify();
+  while (deliveries == 0) {
+    std::this_thread::yield();
+  }
+
+  // The next delivery is a second away, but stopping does not wait for it
+  notifier.notify();
+  auto start = std::chrono::steady_clock::now();
+  notifier.stop();
+  consumer.join();
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+  CHECK(deliveries == 1);
+}
@@ -1,8 +1,14 @@
 #include <doctest/doctest.h>
 
 #include <LFV/file_extractor.hpp>
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #ifdef LOCAL  // Needed to avoid running during github workflows
 TEST_CASE("Test file extractor") {
@@ -25,4 +31,595 @@ TEST_CASE("Test file extractor") {
   CHECK(file_extractor.getc(file_extractor.find_last_of('h', 1000)) == 'h');
   CHECK(file_extractor.slice(5, 9) == "is t");
 }
-#endif
\ No newline at end of file
+#endif
+TEST_CASE("Test mapped, paged and stream sources agree") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_file_source_test.txt";
+  std::string content;
+  for (int line = 0; line < 20000; line++) {
+    content += "line " + std::to_string(line) + (line % 7 == 0 ? " with some more words" : "");
+    content += '\n';
+  }
+  content += "no trailing newline";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  FileExtractor mapped(std::make_unique<MappedFileSource>(fpath));
+  FileExtractor streamed(std::make_unique<StreamFileSource>(fpath));
+  FileExtractor paged(std::make_unique<PagedFileSource>(fpath, 4096, 4));
+  CHECK(mapped.is_mapped());
+  CHECK_FALSE(streamed.is_mapped());
+  CHECK_FALSE(paged.is_mapped());
+
+  for (FileExtractor* extractor : {&mapped, &streamed, &paged}) {
+    CHECK(extractor->get_end() == static_cast<std::streamoff>(content.size()));
+    CHECK(extractor->getc(0) == 'l');
+    CHECK(extractor->getc(extractor->get_end()) == std::char_traits<char>::eof());
+
+    // Scans crossing the stream source's block boundaries
+    for (std::streamoff pos : {0L, 65530L, 65536L, 131071L}) {
+      auto expected_next = static_cast<std::streamoff>(content.find('\n', pos));
+      auto expected_prev = static_cast<std::streamoff>(content.rfind('\n', pos));
+      CHECK(extractor->find_first_of('\n', pos) == expected_next);
+      CHECK(extractor->find_last_of('\n', pos) == expected_prev);
+      CHECK(extractor->slice(pos, pos + 100) == content.substr(pos, 100));
+    }
+
+    CHECK(extractor->find_first_of('\n', extractor->get_end() - (std::streamoff)5) == -1);
+    CHECK(extractor->find_last_of('#', extractor->get_end()) == -1);
+    CHECK(extractor->view(65000, 70000) == std::string_view(content).substr(65000, 5000));
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test page cache eviction and counters") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_page_cache_test.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << std::string(10 * 1024, 'a');
+  }
+
+  PagedFileSource source(fpath, 1024, 2);
+  CHECK(source.get_end() == 10 * 1024);
+
+  FileBlock block = source.fetch(1500);
+  CHECK(block.begin == 1024);
+  CHECK(block.data.size() == 1024);
+
+  source.fetch(1024);  // hit
+  source.fetch(0);     // miss
+  source.fetch(2000);  // hit, page 0 becomes the least recently used
+  source.fetch(5000);  // miss, evicts page 0
+  source.fetch(100);   // miss
+
+  CacheStats stats = source.get_cache_stats();
+  CHECK(stats.hits == 2);
+  CHECK(stats.misses == 4);
+
+  // Options without mmap go through the page cache
+  FileSourceOptions options;
+  options.use_mmap = false;
+  CHECK_FALSE(FileExtractor(fpath, options).is_mapped());
+  CHECK(FileExtractor(fpath).is_mapped());
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test reads of a file truncated under the extractor") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_truncated_test.txt";
+  std::string content;
+  while (content.size() < 200'000) {
+    content += "line " + std::to_string(content.size()) + '\n';
+  }
+  const auto write_content = [&] {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  };
+  write_content();
+
+  FileExtractor streamed(std::make_unique<StreamFileSource>(fpath));
+  FileExtractor paged(std::make_unique<PagedFileSource>(fpath, 1 << 16, 4));
+  FileSourceOptions options;
+  options.use_mmap = false;
+  EditWindowExtractor window(fpath, options);
+  window.set_size(80, 10);
+
+  // As by copytruncate, before the watcher notices and the file is opened again
+  std::filesystem::resize_file(fpath, 70'000);
+
+  for (FileExtractor* extractor : {&streamed, &paged}) {
+    CHECK(extractor->get_end() == static_cast<std::streamoff>(content.size()));
+    CHECK(extractor->getc(69'999) == content[69'999]);
+    CHECK(extractor->getc(100'000) == std::char_traits<char>::eof());
+    CHECK(extractor->find_first_of('\n', 100'000) == -1);
+    CHECK(extractor->find_first_of('#', 60'000) == -1);
+    CHECK(extractor->find_last_of('\n', 100'000) == -1);
+    CHECK(extractor->find_nth('\n', 60'000, 1'000'000) == -1);
+    CHECK(extractor->count('\n', 0, extractor->get_end())
+          == std::count(content.begin(), content.begin() + 70'000, '\n'));
+    CHECK(extractor->view(69'990, 100'000) == std::string_view(content).substr(69'990, 10));
+  }
+
+  window.move_to(100'000);
+  window.move_to_end();
+  window.move_up();
+
+  // Pages read short are read again once the file has its bytes back
+  write_content();
+  for (FileExtractor* extractor : {&streamed, &paged}) {
+    CHECK(extractor->getc(100'000) == content[100'000]);
+    CHECK(extractor->find_first_of('\n', 100'000)
+          == static_cast<std::streamoff>(content.find('\n', 100'000)));
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+namespace {
+  // Wraps at the last space that fits, or mid-word if there is none
+  std::vector<std::string> wrap_lines(const std::string& content, size_t width) {
+    std::vector<std::string> rows;
+    for (size_t begin = 0; begin < content.size();) {
+      size_t end = std::min(content.find('\n', begin), content.size() - 1) + 1;
+      for (size_t i = begin; i < end;) {
+        size_t row_width = end - i;
+        if (i + width < end) {
+          size_t space = content.rfind(' ', i + width - 1);
+          row_width = space == std::string::npos || space < i ? width : space + 1 - i;
+        }
+        rows.push_back(content.substr(i, row_width));
+        i += row_width;
+      }
+      begin = end;
+    }
+
+    return rows;
+  }
+
+  std::vector<std::string> visible_rows(const EditWindowExtractor& extractor) {
+    std::vector<std::string> rows;
+    for (std::string_view row : extractor.get_lines()) {
+      rows.emplace_back(row);
+    }
+
+    return rows;
+  }
+}  // namespace
+
+TEST_CASE("Test edit window scrolling") {
+  std::mt19937 rng(5);
+  std::string content;
+  for (int line = 0; line < 300; line++) {
+    // Short lines, wrapped lines with and without spaces, and empty lines
+    size_t length = rng() % 4 == 0 ? rng() % 100 : rng() % 12;
+    for (size_t i = 0; i < length; i++) {
+      content += line % 3 == 0 ? 'x' : "abc "[rng() % 4];
+    }
+    content += '\n';
+  }
+  content += "no trailing newline";
+
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_edit_window.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  constexpr int WIDTH = 10;
+  constexpr int HEIGHT = 7;
+  const std::vector<std::string> rows = wrap_lines(content, WIDTH);
+
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(WIDTH, HEIGHT);
+
+  // A random walk, which crosses raw lines in both directions
+  size_t top = 0;
+  for (int step = 0; step < 5000; step++) {
+    if (rng() % 3 != 0) {
+      CHECK(extractor.can_move_down() == (top + HEIGHT < rows.size()));
+      if (extractor.can_move_down()) {
+        extractor.move_down();
+        top++;
+      }
+    } else {
+      CHECK(extractor.can_move_up() == (top > 0));
+      if (extractor.can_move_up()) {
+        extractor.move_up();
+        top--;
+      }
+    }
+
+    size_t bottom = std::min(top + HEIGHT, rows.size());
+    REQUIRE(visible_rows(extractor)
+            == std::vector<std::string>(rows.begin() + static_cast<std::ptrdiff_t>(top),
+                                        rows.begin() + static_cast<std::ptrdiff_t>(bottom)));
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test edit window paging") {
+  std::mt19937 rng(7);
+  std::string content;
+  for (int line = 0; line < 500; line++) {
+    size_t length = rng() % 5 == 0 ? rng() % 60 : rng() % 12;
+    for (size_t i = 0; i < length; i++) {
+      content += "xy "[rng() % 3];
+    }
+    content += '\n';
+  }
+
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_edit_window_paging.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  constexpr int WIDTH = 12;
+  constexpr int HEIGHT = 9;
+  const std::vector<std::string> rows = wrap_lines(content, WIDTH);
+  const size_t last_top = rows.size() - HEIGHT;
+
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(WIDTH, HEIGHT);
+
+  auto check_top = [&](size_t top) {
+    REQUIRE(visible_rows(extractor)
+            == std::vector<std::string>(rows.begin() + static_cast<std::ptrdiff_t>(top),
+                                        rows.begin() + static_cast<std::ptrdiff_t>(top + HEIGHT)));
+  };
+
+  // Paging mixed with single steps, which leaves the window off page boundaries
+  size_t top = 0;
+  for (int step = 0; step < 3000; step++) {
+    switch (rng() % 4) {
+      case 0:
+        extractor.page_down();
+        top = std::min(top + HEIGHT, std::max(top, last_top));
+        break;
+      case 1:
+        extractor.page_up();
+        top = top < HEIGHT ? 0 : top - HEIGHT;
+        break;
+      case 2:
+        if (extractor.can_move_down()) {
+          extractor.move_down();
+          top++;
+        }
+        break;
+      default:
+        if (extractor.can_move_up()) {
+          extractor.move_up();
+          top--;
+        }
+        break;
+    }
+
+    check_top(top);
+  }
+
+  extractor.move_to_end();
+  check_top(last_top);
+  CHECK_FALSE(extractor.can_move_down());
+
+  extractor.move_to(0);
+  check_top(0);
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test gigantic lines are read in segments") {
+  constexpr std::streamoff SEGMENT = FileLineExtractor::MAX_SEGMENT_BYTES;
+
+  // Short lines, one of which crosses a segment boundary, then a line of several segments
+  std::mt19937 rng(9);
+  std::string content;
+  while (content.size() < SEGMENT - 20) {
+    content += std::string(rng() % 50, 'a') + '\n';
+  }
+  content += std::string(40, 'b') + '\n';
+  while (content.size() < 5 * SEGMENT / 2) {
+    content += "word" + std::string(rng() % 30, 'c') + ' ';
+  }
+  content += "\nlast";
+
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_long_line.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  FileLineExtractor line_extractor(fpath);
+
+  // Segments tile the file, and are the same from any position inside them
+  std::vector<std::string> rows;
+  std::streamoff pos = 0;
+  while (pos < static_cast<std::streamoff>(content.size())) {
+    FileSegment segment = line_extractor.get_segment_containing(pos);
+    REQUIRE(segment.begin_pos == pos);
+    REQUIRE(segment.end_pos > segment.begin_pos);
+    CHECK(segment.end_pos - segment.begin_pos <= SEGMENT);
+
+    std::string text(segment.content);
+    std::streamoff begin = segment.begin_pos;
+    std::streamoff end = segment.end_pos;
+    for (std::streamoff inside : {begin, (begin + end) / 2, end - 1}) {
+      FileSegment again = line_extractor.get_segment_containing(inside);
+      CHECK(again.begin_pos == segment.begin_pos);
+      CHECK(again.end_pos == segment.end_pos);
+    }
+
+    // Short lines stay whole, even across a boundary
+    if (text.size() < 100 && end < static_cast<std::streamoff>(content.size())) {
+      CHECK(text.back() == '\n');
+    }
+
+    for (const std::string& row : wrap_lines(text, 16)) {
+      rows.push_back(row);
+    }
+    pos = segment.end_pos;
+  }
+
+  // The window wraps the same segments, in either direction
+  constexpr int HEIGHT = 20;
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(16, HEIGHT);
+
+  size_t top = 0;
+  while (extractor.can_move_down()) {
+    extractor.move_down();
+    top++;
+  }
+  CHECK(top == rows.size() - HEIGHT);
+
+  while (top > rows.size() / 2) {
+    extractor.move_up();
+    top--;
+  }
+  CHECK(visible_rows(extractor)
+        == std::vector<std::string>(rows.begin() + static_cast<std::ptrdiff_t>(top),
+                                    rows.begin() + static_cast<std::ptrdiff_t>(top + HEIGHT)));
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test edit window without wrapping") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_no_wrap.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << "0123456789\n" << std::string(1 << 20, 'x') << "yz\nab";
+  }
+
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(4, 2);
+  extractor.set_wrap(false);
+  CHECK(visible_rows(extractor) == std::vector<std::string>{"0123", "xxxx"});
+
+  extractor.move_columns(8);
+  CHECK(visible_rows(extractor) == std::vector<std::string>{"89\n", "xxxx"});
+
+  extractor.move_columns((1 << 20) - 8);
+  CHECK(visible_rows(extractor) == std::vector<std::string>{"", "yz\n"});
+
+  // Scrolling keeps the columns
+  extractor.move_down();
+  CHECK(visible_rows(extractor) == std::vector<std::string>{"yz\n", ""});
+  CHECK_FALSE(extractor.can_move_down());
+
+  extractor.set_wrap(true);
+  CHECK(extractor.get_column() == 0);
+  CHECK(visible_rows(extractor).front() == "xxxx");
+
+  // Scrolling sideways only reads the columns shown, not the long line around them
+  FileSourceOptions options;
+  options.use_mmap = false;
+  EditWindowExtractor paged(fpath, options);
+  paged.set_size(4, 2);
+  paged.set_wrap(false);
+  paged.move_columns(1 << 19);
+  const CacheStats before = paged.get_cache_stats();
+  paged.move_columns(4);
+  CHECK(visible_rows(paged) == std::vector<std::string>{"", "xxxx"});
+  paged.move_columns((1 << 19) - 4);
+  CHECK(visible_rows(paged) == std::vector<std::string>{"", "yz\n"});
+  paged.move_columns(-(1 << 20));
+  CHECK(visible_rows(paged) == std::vector<std::string>{"0123", "xxxx"});
+  const CacheStats after = paged.get_cache_stats();
+  CHECK(after.hits + after.misses - before.hits - before.misses <= 6);
+
+  // Slices end where their line does, from wherever in the line they are read
+  FileLineExtractor lines(fpath);
+  const std::streamoff long_end = 11 + (1 << 20) + 3;
+  FileSegment slice = lines.get_line_slice(5, 8, 4);
+  CHECK((slice.begin_pos == 0 && slice.end_pos == 11 && slice.content == "89\n"));
+  slice = lines.get_line_slice(5, 20, 4);
+  CHECK((slice.end_pos == 11 && slice.content.empty()));
+  slice = lines.get_line_slice(1000, 2, 4);
+  CHECK((slice.begin_pos == 11 && slice.end_pos == long_end && slice.content == "xxxx"));
+  slice = lines.get_line_slice(long_end - 1, 1 << 20, 8);
+  CHECK((slice.end_pos == long_end && slice.content == "yz\n"));
+  slice = lines.get_line_slice(long_end + 1, 0, 8);
+  CHECK((slice.begin_pos == long_end && slice.end_pos == long_end + 2 && slice.content == "ab"));
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test following a growing file") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_follow.txt";
+  std::string content;
+  for (int line = 0; line < 50; line++) {
+    content += "line " + std::to_string(line) + "\n";
+  }
+  content += "partial";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  FileExtractor mapped(std::make_unique<MappedFileSource>(fpath));
+  FileExtractor streamed(std::make_unique<StreamFileSource>(fpath));
+  FileExtractor paged(std::make_unique<PagedFileSource>(fpath, 64, 2));
+  for (FileExtractor* extractor : {&mapped, &streamed, &paged}) {
+    // Loads the block holding the end, which is read short
+    CHECK(extractor->getc(extractor->get_end() - (std::streamoff)1) == 'l');
+  }
+
+  EditWindowExtractor at_end(fpath);
+  at_end.set_size(20, 3);
+  at_end.move_to_end();
+  EditWindowExtractor at_start(fpath);
+  at_start.set_size(20, 3);
+  CHECK(visible_rows(at_end) == std::vector<std::string>{"line 48\n", "line 49\n", "partial"});
+
+  const auto old_end = static_cast<std::streamoff>(content.size());
+  {
+    std::ofstream out(fpath, std::ios_base::binary | std::ios_base::app);
+    out << " line\nline 51\n";
+  }
+  content += " line\nline 51\n";
+  const auto new_end = static_cast<std::streamoff>(content.size());
+
+  for (FileExtractor* extractor : {&mapped, &streamed, &paged}) {
+    CHECK(extractor->refresh() == new_end);
+    CHECK(extractor->slice(old_end - 7, new_end) == "partial line\nline 51\n");
+  }
+
+  // The window showing the end follows it, and the other one stays where it was
+  CHECK(at_end.refresh());
+  CHECK(visible_rows(at_end)
+        == std::vector<std::string>{"line 49\n", "partial line\n", "line 51\n"});
+  CHECK(at_start.refresh());
+  CHECK(visible_rows(at_start) == std::vector<std::string>{"line 0\n", "line 1\n", "line 2\n"});
+  CHECK(at_start.get_size() == static_cast<std::uintmax_t>(new_end));
+  CHECK_FALSE(at_start.refresh());
+
+  // Reads switch to pread without moving the window
+  FileSourceOptions paged_options;
+  paged_options.use_mmap = false;
+  at_end.set_source_options(paged_options);
+  CHECK_FALSE(at_end.get_source_options().use_mmap);
+  CHECK(visible_rows(at_end)
+        == std::vector<std::string>{"line 49\n", "partial line\n", "line 51\n"});
+
+  // A truncated file keeps its old end until opened again
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << "fresh\n";
+  }
+  CHECK_FALSE(at_end.refresh());
+  at_end.reopen();
+  CHECK(at_end.get_end() == 6);
+  CHECK(visible_rows(at_end) == std::vector<std::string>{"fresh\n"});
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test edit window filtered by matches") {
+  std::mt19937 rng(11);
+  std::string content;
+  std::string filtered;
+  std::vector<std::streamoff> matches;
+  for (int line = 0; line < 400; line++) {
+    std::string text;
+    size_t length = rng() % 40;
+    for (size_t i = 0; i < length; i++) {
+      text += "ab "[rng() % 3];
+    }
+
+    // Some lines match once, some several times
+    if (rng() % 4 == 0) {
+      for (int i = 0, count = 1 + static_cast<int>(rng() % 3); i < count; i++) {
+        text.insert(rng() % (text.size() + 1), "ab");
+      }
+    }
+
+    text += '\n';
+    for (size_t pos = text.find("ab"); pos != std::string::npos; pos = text.find("ab", pos + 1)) {
+      matches.push_back(static_cast<std::streamoff>(content.size() + pos));
+    }
+    if (text.find("ab") != std::string::npos) {
+      filtered += text;
+    }
+    content += text;
+  }
+
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_edit_window_filter.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  constexpr int WIDTH = 11;
+  constexpr int HEIGHT = 6;
+  const std::vector<std::string> rows = wrap_lines(filtered, WIDTH);
+
+  // Half the matches are found at first
+  auto result = std::make_shared<SearchResult>();
+  const size_t num_early = matches.size() / 2;
+  for (size_t i = 0; i < num_early; i++) {
+    result->add_match(matches[i]);
+  }
+
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(WIDTH, HEIGHT);
+  extractor.set_filter(result);
+  CHECK(extractor.is_filtering());
+  CHECK(visible_rows(extractor) == std::vector<std::string>(rows.begin(), rows.begin() + HEIGHT));
+
+  // Scrolling stops at the last line found so far, and carries on once more are found
+  size_t top = 0;
+  while (extractor.can_move_down()) {
+    extractor.move_down();
+    top++;
+  }
+  const size_t early_top = top;
+  for (size_t i = num_early; i < matches.size(); i++) {
+    result->add_match(matches[i]);
+  }
+  extractor.refresh_filter();
+  CHECK(extractor.can_move_down());
+
+  // A random walk over every line with matches
+  for (int step = 0; step < 3000; step++) {
+    if (rng() % 3 != 0) {
+      CHECK(extractor.can_move_down() == (top + HEIGHT < rows.size()));
+      if (extractor.can_move_down()) {
+        extractor.move_down();
+        top++;
+      }
+    } else {
+      CHECK(extractor.can_move_up() == (top > 0));
+      if (extractor.can_move_up()) {
+        extractor.move_up();
+        top--;
+      }
+    }
+
+    size_t bottom = std::min(top + HEIGHT, rows.size());
+    REQUIRE(visible_rows(extractor)
+            == std::vector<std::string>(rows.begin() + static_cast<std::ptrdiff_t>(top),
+                                        rows.begin() + static_cast<std::ptrdiff_t>(bottom)));
+  }
+  CHECK(early_top > 0);
+
+  // Moving into a line with matches shows it from its start
+  const std::streamoff match = matches[matches.size() / 3];
+  const size_t line_begin = content.rfind('\n', static_cast<size_t>(match)) + 1;
+  const std::vector<std::string> rows_from_match = wrap_lines(content.substr(line_begin), WIDTH);
+  extractor.move_to(match + 1);
+  CHECK(visible_rows(extractor).front() == rows_from_match.front());
+
+  extractor.move_to_end();
+  CHECK(visible_rows(extractor) == std::vector<std::string>(rows.end() - HEIGHT, rows.end()));
+
+  // Without the filter, every line is shown from the same place
+  extractor.move_to(match);
+  extractor.set_filter(nullptr);
+  CHECK_FALSE(extractor.is_filtering());
+  CHECK(visible_rows(extractor)
+        == std::vector<std::string>(rows_from_match.begin(), rows_from_match.begin() + HEIGHT));
+
+  std::filesystem::remove(fpath);
+}
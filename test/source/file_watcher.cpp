@@ -0,0 +1,62 @@
+#include <doctest/doctest.h>
+
+#include <LFV/file_watcher.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+TEST_CASE("Test file watcher sees appends, truncation and replacement") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_watched.txt";
+  const std::string other_fpath = std::filesystem::temp_directory_path() / "lfv_watched.new";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << "a\n";
+  }
+
+  auto original = stat_file(fpath);
+  REQUIRE(original.has_value());
+  CHECK(original->size == 2);
+
+  auto notifier = std::make_shared<ChangeNotifier>();
+  FileWatcher watcher(fpath, notifier);
+
+  auto wait_for_change = [&](uint64_t seen) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (watcher.get_generation() == seen && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return watcher.get_generation() != seen;
+  };
+
+  {
+    std::ofstream out(fpath, std::ios_base::binary | std::ios_base::app);
+    out << "b\n";
+  }
+  REQUIRE(wait_for_change(0));
+  CHECK(stat_file(fpath)->size == 4);
+  CHECK(stat_file(fpath)->is_same_file(*original));
+
+  uint64_t seen = watcher.get_generation();
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << "c";
+  }
+  REQUIRE(wait_for_change(seen));
+  CHECK(stat_file(fpath)->size == 1);
+
+  // Rotation moves a new file in under the name
+  seen = watcher.get_generation();
+  {
+    std::ofstream out(other_fpath, std::ios_base::binary);
+    out << "rotated\n";
+  }
+  std::filesystem::rename(other_fpath, fpath);
+  REQUIRE(wait_for_change(seen));
+  CHECK_FALSE(stat_file(fpath)->is_same_file(*original));
+
+  std::filesystem::remove(fpath);
+  CHECK_FALSE(stat_file(fpath).has_value());
+}
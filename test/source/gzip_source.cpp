@@ -0,0 +1,192 @@
+#include <doctest/doctest.h>
+#include <zlib.h>
+
+#include <LFV/file_extractor.hpp>
+#include <LFV/gzip_source.hpp>
+#include <LFV/parallel_search.hpp>
+#include <LFV/search_stream.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <tuple>
+#include <string>
+#include <vector>
+
+namespace {
+  std::string make_gzip_content() {
+    std::mt19937 rng(11);
+    std::string content;
+    while (content.size() < (3 << 20)) {
+      content += "line " + std::to_string(rng() % 100000);
+      for (unsigned words = rng() % 12; words > 0; words--) {
+        content += ' ';
+        content += "abcdefgh"[rng() % 8];
+        content += "xyz"[rng() % 3];
+      }
+      content += '\n';
+    }
+
+    return content;
+  }
+
+  // Written as two gzip members, as cat a.gz b.gz would
+  void write_gzip(const std::string& fpath, const std::string& content) {
+    const size_t half = content.size() / 2;
+    for (auto [mode, begin, end] :
+         {std::tuple{"wb6", size_t{0}, half}, std::tuple{"ab6", half, content.size()}}) {
+      gzFile out = gzopen(fpath.c_str(), mode);
+      REQUIRE(out != nullptr);
+      CHECK(gzwrite(out, content.data() + begin, static_cast<unsigned>(end - begin))
+            == static_cast<int>(end - begin));
+      gzclose(out);
+    }
+  }
+
+  std::vector<std::streamoff> find_all_naive(const std::string& content,
+                                             const std::string& pattern) {
+    std::vector<std::streamoff> matches;
+    for (size_t pos = content.find(pattern); pos != std::string::npos;
+         pos = content.find(pattern, pos + 1)) {
+      matches.push_back(static_cast<std::streamoff>(pos));
+    }
+
+    return matches;
+  }
+}  // namespace
+
+TEST_CASE("Test random access into a gzip file") {
+  const std::string content = make_gzip_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_gzip_source.txt.gz";
+  write_gzip(fpath, content);
+  CHECK(is_gzip_file(fpath));
+
+  auto index = std::make_shared<GzipIndex>(fpath, 256 << 10);
+  std::atomic<bool> aborted = false;
+  index->build(aborted);
+  CHECK(index->get_status() == BackgroundTaskStatus::FINISHED);
+  CHECK(index->get_end() == static_cast<std::streamoff>(content.size()));
+  CHECK(index->get_num_checkpoints() >= 8);
+
+  FileSourceOptions options;
+  options.gzip_index = index;
+  options.page_size = 4096;
+  options.cache_pages = 8;
+  FileExtractor extractor(fpath, options);
+  REQUIRE(extractor.get_end() == static_cast<std::streamoff>(content.size()));
+
+  // Jumps all over the file, around checkpoints and across the border between members
+  std::mt19937 rng(3);
+  std::vector<std::streamoff> positions = index->get_checkpoint_positions();
+  positions.push_back(static_cast<std::streamoff>(content.size() / 2));
+  for (int i = 0; i < 200; i++) {
+    positions.push_back(static_cast<std::streamoff>(rng() % content.size()));
+  }
+
+  for (std::streamoff pos : positions) {
+    std::streamoff begin = std::max<std::streamoff>(pos - 5000, 0);
+    std::streamoff end = std::min<std::streamoff>(pos + 5000, extractor.get_end());
+    REQUIRE(extractor.slice(begin, end)
+            == content.substr(static_cast<size_t>(begin), static_cast<size_t>(end - begin)));
+  }
+
+  // Scrolling backward a line at a time
+  std::streamoff pos = extractor.get_end();
+  pos--;
+  for (int i = 0; i < 2000; i++) {
+    std::streamoff line_begin = extractor.find_last_of('\n', pos - 1);
+    line_begin++;
+    CHECK(line_begin == static_cast<std::streamoff>(content.rfind('\n', pos - 1) + 1));
+    pos = line_begin - 1;
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test reading a gzip file while it is indexed") {
+  const std::string content = make_gzip_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_gzip_progress.txt.gz";
+  write_gzip(fpath, content);
+
+  auto index = std::make_shared<GzipIndex>(fpath, 64 << 10);
+  std::atomic<bool> aborted = false;
+  std::thread builder([&] { index->build(aborted); });
+
+  FileSourceOptions options;
+  options.gzip_index = index;
+  options.page_size = 4096;
+  FileExtractor extractor(fpath, options);
+
+  // Whatever has been decompressed can be read, up to its end
+  bool finished = false;
+  while (!finished) {
+    finished = index->get_status() == BackgroundTaskStatus::FINISHED;
+    std::streamoff end = extractor.refresh();
+    std::streamoff begin = std::max<std::streamoff>(end - 10000, 0);
+    REQUIRE(extractor.slice(begin, end)
+            == content.substr(static_cast<size_t>(begin), static_cast<size_t>(end - begin)));
+  }
+
+  builder.join();
+  CHECK(extractor.get_end() == static_cast<std::streamoff>(content.size()));
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test searches over a gzip file") {
+  const std::string content = make_gzip_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_gzip_search.txt.gz";
+  write_gzip(fpath, content);
+
+  auto index = std::make_shared<GzipIndex>(fpath, 128 << 10);
+  std::atomic<bool> aborted = false;
+  index->build(aborted);
+
+  FileSourceOptions options;
+  options.gzip_index = index;
+  const auto end = static_cast<std::streamoff>(content.size());
+
+  for (const std::string pattern : {"line 4242", "ax by\n", "z\nline 1"}) {
+    auto result = std::make_shared<SearchResult>();
+    search_in_file_parallel(fpath, pattern, 0, end, 1'000'000, result,
+                            std::make_shared<std::atomic<bool>>(false), 4,
+                            DEFAULT_SEARCH_CHUNK_SIZE, options);
+    CHECK(result->get_status() == BackgroundTaskStatus::FINISHED);
+
+    std::vector<std::streamoff> matches;
+    for (int i = 0; i < result->get_num_matches(); i++) {
+      matches.push_back(result->get_match(i));
+    }
+    CHECK(matches == find_all_naive(content, pattern));
+  }
+
+  auto any_result = std::make_shared<SearchResult>();
+  search_any_in_file(fpath, options, {"line 4242", "hz hz"}, 0, end, 1'000'000, any_result,
+                     std::make_shared<std::atomic<bool>>(false));
+  CHECK(any_result->get_num_matches()
+        == static_cast<int>(find_all_naive(content, "line 4242").size()
+                            + find_all_naive(content, "hz hz").size()));
+
+  // The regex search reads the decompressed bytes as it would the plain file
+  const std::string plain_fpath = std::filesystem::temp_directory_path() / "lfv_gzip_search.txt";
+  {
+    std::ofstream out(plain_fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  const Regex regex("^line 4242\\d* [a-h]x");
+  auto plain_result = std::make_shared<SearchResult>();
+  search_regex_in_file(plain_fpath, regex, 0, end, 1'000'000, plain_result,
+                       std::make_shared<std::atomic<bool>>(false));
+  auto regex_result = std::make_shared<SearchResult>();
+  search_regex_in_file(fpath, regex, 0, end, 1'000'000, regex_result,
+                       std::make_shared<std::atomic<bool>>(false), options);
+  CHECK(regex_result->get_status() == BackgroundTaskStatus::FINISHED);
+  CHECK(plain_result->get_num_matches() > 0);
+  REQUIRE(regex_result->get_num_matches() == plain_result->get_num_matches());
+  for (int i = 0; i < regex_result->get_num_matches(); i++) {
+    CHECK(regex_result->get_match(i) == plain_result->get_match(i));
+  }
+
+  std::filesystem::remove(plain_fpath);
+  std::filesystem::remove(fpath);
+}
@@ -0,0 +1,278 @@
+#include <doctest/doctest.h>
+
+#include <LFV/file_extractor.hpp>
+#include <LFV/index_cache.hpp>
+#include <LFV/regex.hpp>
+#include <LFV/search_stream.hpp>
+#include <LFV/task_pool.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  std::string make_cache_content(unsigned seed, int num_lines) {
+    std::mt19937 rng(seed);
+    std::string content;
+    for (int line = 0; line < num_lines; line++) {
+      content += std::string(rng() % 40, "abc"[rng() % 3]);
+      content += '\n';
+    }
+
+    return content;
+  }
+
+  void write_file(const std::string& fpath, const std::string& content,
+                  std::ios_base::openmode mode = std::ios_base::trunc) {
+    std::ofstream out(fpath, std::ios_base::binary | std::ios_base::out | mode);
+    out << content;
+  }
+
+  std::vector<std::pair<std::streamoff, int32_t>> get_matches(const SearchResult& result) {
+    std::vector<std::pair<std::streamoff, int32_t>> matches;
+    for (int64_t i = 0; i < result.get_num_matches(); i++) {
+      matches.emplace_back(result.get_match(i), result.get_match_pattern(i));
+    }
+
+    return matches;
+  }
+
+  SavedSearch make_search(std::vector<std::string> patterns, bool any, bool count_only,
+                          std::streamoff end) {
+    auto result = std::make_shared<SearchResult>(std::make_shared<MatchHistogram>(end, 64),
+                                                 count_only);
+    for (std::streamoff pos = 3; pos < end; pos += 97) {
+      result->add_match(pos, any ? static_cast<int32_t>(pos % 2) : 0);
+    }
+    result->set_current_pos(end);
+    result->set_status(BackgroundTaskStatus::FINISHED);
+
+    return {std::move(patterns), false, any, 0, end, true, result};
+  }
+
+  // The checksum the cache ends with
+  uint64_t fnv1a(const std::string& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : data) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+
+    return hash;
+  }
+}  // namespace
+
+TEST_CASE("Test index cache round trip") {
+  const auto dir = std::filesystem::temp_directory_path() / "lfv_index_cache_test";
+  std::filesystem::remove_all(dir);
+  const std::string fpath
+      = (std::filesystem::temp_directory_path() / "lfv_index_cache.txt").string();
+  const std::string content = make_cache_content(5, 50000);
+  write_file(fpath, content);
+  const auto end = static_cast<std::streamoff>(content.size());
+
+  FileExtractor extractor(fpath);
+  LineIndex index(64);
+  std::atomic<bool> aborted = false;
+  index.build(extractor, aborted);
+
+  std::vector<SavedSearch> searches{make_search({"abc"}, false, false, end),
+                                    make_search({"a", "bb"}, true, false, end),
+                                    make_search({"c"}, false, true, end)};
+
+  CHECK_FALSE(IndexCache(fpath, dir.string()).load().has_value());
+  IndexCache(fpath, dir.string()).save(index, searches);
+
+  auto state = IndexCache(fpath, dir.string()).load();
+  REQUIRE(state.has_value());
+  CHECK(state->line_index->get_interval() == 64);
+  CHECK(state->line_index->get_checkpoints() == index.get_checkpoints());
+  CHECK(state->line_index->get_indexed_pos() == end);
+  CHECK(state->line_index->get_line_number(extractor, end - 1) == 49999);
+
+  REQUIRE(state->searches.size() == searches.size());
+  for (size_t i = 0; i < searches.size(); i++) {
+    const SearchResult& saved = *searches[i].result;
+    const SearchResult& loaded = *state->searches[i].result;
+    CHECK(state->searches[i].patterns == searches[i].patterns);
+    CHECK(state->searches[i].any == searches[i].any);
+    CHECK(state->searches[i].to == end);
+    CHECK(loaded.get_status() == BackgroundTaskStatus::FINISHED);
+    CHECK(loaded.is_count_only() == saved.is_count_only());
+    CHECK(loaded.get_num_found() == saved.get_num_found());
+    CHECK(get_matches(loaded) == get_matches(saved));
+    CHECK(loaded.get_last_match() == saved.get_last_match());
+    CHECK(loaded.get_histogram()->get_rows(64) == saved.get_histogram()->get_rows(64));
+  }
+
+  // A cache cut short is ignored
+  const std::string cache_path = IndexCache(fpath, dir.string()).get_cache_path();
+  std::filesystem::resize_file(cache_path, std::filesystem::file_size(cache_path) - 1);
+  CHECK_FALSE(IndexCache(fpath, dir.string()).load().has_value());
+
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test restored search status without a task") {
+  const auto dir = std::filesystem::temp_directory_path() / "lfv_index_cache_restore";
+  std::filesystem::remove_all(dir);
+  const std::string fpath
+      = (std::filesystem::temp_directory_path() / "lfv_index_cache_restore.txt").string();
+  const std::string content = make_cache_content(3, 1000);
+  write_file(fpath, content);
+  const auto end = static_cast<std::streamoff>(content.size());
+
+  FileExtractor extractor(fpath);
+  LineIndex index;
+  std::atomic<bool> aborted = false;
+  index.build(extractor, aborted);
+  IndexCache(fpath, dir.string()).save(index, {make_search({"abc"}, false, false, end)});
+
+  auto state = IndexCache(fpath, dir.string()).load();
+  REQUIRE(state.has_value());
+  REQUIRE(state->searches.size() == 1);
+
+  // As the viewer synchronises with a restored search, which no task fills
+  TaskHandle no_task;
+  CHECK(get_search_status(*state->searches[0].result, no_task) == BackgroundTaskStatus::FINISHED);
+  CHECK(no_task.get_error().empty());
+
+  // A task dropped from the queue shows as aborted, though it never touched its result
+  TaskPool pool(1);
+  auto result = std::make_shared<SearchResult>();
+  TaskHandle blocker = pool.submit([](const CancellationToken& token) {
+    while (!*token) {
+      std::this_thread::yield();
+    }
+  });
+  TaskHandle dropped = pool.submit([result](const CancellationToken&) { result->start(0); });
+  dropped.cancel();
+  blocker.cancel();
+  dropped.wait();
+  CHECK(get_search_status(*result, dropped) == BackgroundTaskStatus::ABORTED);
+  CHECK(result->get_status() == BackgroundTaskStatus::NOT_STARTED);
+
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test restored count-only regex search carried on over appended bytes") {
+  const auto dir = std::filesystem::temp_directory_path() / "lfv_index_cache_extend";
+  std::filesystem::remove_all(dir);
+  const std::string fpath
+      = (std::filesystem::temp_directory_path() / "lfv_index_cache_extend.txt").string();
+  const std::string old_content = "ab ab\nab ab";
+  write_file(fpath, old_content);
+  const auto old_end = static_cast<std::streamoff>(old_content.size());
+  auto aborted = std::make_shared<std::atomic<bool>>(false);
+
+  auto counted = std::make_shared<SearchResult>(std::make_shared<MatchHistogram>(old_end), true);
+  search_regex_in_file(fpath, Regex("ab"), 0, old_end, 1'000'000, counted, aborted);
+  REQUIRE(counted->get_num_found() == 4);
+
+  FileExtractor extractor(fpath);
+  LineIndex index;
+  std::atomic<bool> index_aborted = false;
+  index.build(extractor, index_aborted);
+  IndexCache(fpath, dir.string()).save(index, {{{"ab"}, true, false, 0, old_end, true, counted}});
+
+  write_file(fpath, " ab\n", std::ios_base::app);
+  auto state = IndexCache(fpath, dir.string()).load();
+  REQUIRE(state.has_value());
+  REQUIRE(state->searches.size() == 1);
+  std::shared_ptr<SearchResult> restored = state->searches[0].result;
+  CHECK(restored->get_last_match() == 9);
+
+  // From the last match, as the viewer carries on, leaving out the matches already counted
+  const std::streamoff last_match = restored->get_last_match();
+  const std::streamoff end = old_end + 4;
+  restored->extend_histogram(end);
+  search_regex_in_file(fpath, Regex("ab"), last_match, end, 1'000'000, restored, aborted, {},
+                       last_match + 1);
+  CHECK(restored->get_num_found() == 5);
+
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test index cache only revalidates an appended file") {
+  const auto dir = std::filesystem::temp_directory_path() / "lfv_index_cache_append";
+  std::filesystem::remove_all(dir);
+  const std::string fpath
+      = (std::filesystem::temp_directory_path() / "lfv_index_cache_append.txt").string();
+  const std::string content = make_cache_content(9, 20000);
+  write_file(fpath, content);
+
+  {
+    FileExtractor extractor(fpath);
+    LineIndex index(64);
+    std::atomic<bool> aborted = false;
+    index.build(extractor, aborted);
+    IndexCache(fpath, dir.string()).save(index, {});
+  }
+
+  // Appended bytes keep the cache, and the index carries on over them
+  const std::string appended = make_cache_content(10, 3000) + "unterminated";
+  write_file(fpath, appended, std::ios_base::app);
+
+  auto state = IndexCache(fpath, dir.string()).load();
+  REQUIRE(state.has_value());
+  CHECK(state->line_index->get_indexed_pos() == static_cast<std::streamoff>(content.size()));
+
+  FileExtractor extractor(fpath);
+  std::atomic<bool> aborted = false;
+  state->line_index->build(extractor, aborted);
+  CHECK(state->line_index->get_num_lines() == 23001);
+
+  LineIndex fresh(64);
+  fresh.build(extractor, aborted);
+  CHECK(state->line_index->get_checkpoints() == fresh.get_checkpoints());
+
+  // Content changed before the old end, or cut short, is not the file that was indexed
+  std::string changed = content + appended;
+  changed[0] = changed[0] == 'a' ? 'b' : 'a';
+  write_file(fpath, changed);
+  CHECK_FALSE(IndexCache(fpath, dir.string()).load().has_value());
+
+  write_file(fpath, content.substr(0, content.size() / 2));
+  CHECK_FALSE(IndexCache(fpath, dir.string()).load().has_value());
+
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test index cache rejects counts larger than the cache") {
+  const auto dir = std::filesystem::temp_directory_path() / "lfv_index_cache_counts";
+  std::filesystem::remove_all(dir);
+  const std::string fpath
+      = (std::filesystem::temp_directory_path() / "lfv_index_cache_counts.txt").string();
+  write_file(fpath, make_cache_content(3, 100));
+
+  // An empty index ends with its one checkpoint, at 0, and a search count of 0, then the checksum
+  IndexCache(fpath, dir.string()).save(LineIndex(64), {});
+  const std::string cache_path = IndexCache(fpath, dir.string()).get_cache_path();
+  std::string cache;
+  {
+    std::ifstream in(cache_path, std::ios_base::binary);
+    cache.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  REQUIRE(IndexCache(fpath, dir.string()).load().has_value());
+  REQUIRE(cache.size() > 11);
+  REQUIRE(cache.substr(cache.size() - 11, 3) == std::string("\x01\0\0", 3));
+
+  // A checkpoint count of 2^40 with a valid checksum is a miss, not an allocation
+  std::string corrupt
+      = cache.substr(0, cache.size() - 11) + "\x80\x80\x80\x80\x80\x20" + std::string(2, '\0');
+  const uint64_t checksum = fnv1a(corrupt);
+  for (int i = 0; i < 8; i++) {
+    corrupt += static_cast<char>((checksum >> (8 * i)) & 0xff);
+  }
+  write_file(cache_path, corrupt);
+  CHECK_FALSE(IndexCache(fpath, dir.string()).load().has_value());
+
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(fpath);
+}
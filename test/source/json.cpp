@@ -0,0 +1,30 @@
+#include <doctest/doctest.h>
+
+#include <LFV/json.hpp>
+#include <cstdio>
+#include <string>
+
+namespace {
+  std::string to_json_string(const std::string& str) {
+    std::FILE* out = std::tmpfile();
+    print_json_string(out, str);
+    std::rewind(out);
+
+    std::string written;
+    for (int c = std::fgetc(out); c != EOF; c = std::fgetc(out)) {
+      written += static_cast<char>(c);
+    }
+    std::fclose(out);
+
+    return written;
+  }
+}  // namespace
+
+TEST_CASE("Test JSON string escaping") {
+  CHECK(to_json_string("UI") == "\"UI\"");
+  CHECK(to_json_string("a\"b\\c") == "\"a\\\"b\\\\c\"");
+  CHECK(to_json_string("line\nnext\ttab\r") == "\"line\\nnext\\ttab\\r\"");
+  CHECK(to_json_string(std::string("\x01\x1f", 2) + '\0') == "\"\\u0001\\u001f\\u0000\"");
+  // Bytes of UTF-8 sequences are kept as they are
+  CHECK(to_json_string("caf\xc3\xa9") == "\"caf\xc3\xa9\"");
+}
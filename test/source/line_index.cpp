@@ -0,0 +1,102 @@
+#include <doctest/doctest.h>
+
+#include <LFV/file_extractor.hpp>
+#include <LFV/line_index.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("Test line index") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_line_index_test.txt";
+
+  for (bool trailing_newline : {true, false}) {
+    std::string content;
+    std::vector<std::streamoff> line_begins;
+    for (int line = 0; line < 1000; line++) {
+      line_begins.push_back(static_cast<std::streamoff>(content.size()));
+      content += std::string(static_cast<size_t>(line % 13), 'x');
+      if (line != 999 || trailing_newline) {
+        content += '\n';
+      }
+    }
+
+    {
+      std::ofstream out(fpath, std::ios_base::binary);
+      out << content;
+    }
+
+    FileExtractor extractor(fpath);
+    LineIndex index(7);
+    CHECK_FALSE(index.get_line_begin(extractor, 5).has_value());
+
+    std::atomic<bool> aborted = false;
+    index.build(extractor, aborted);
+    REQUIRE(index.get_status() == BackgroundTaskStatus::FINISHED);
+    CHECK(index.get_num_lines() == 1000);
+
+    for (std::streamoff line = 0; line < 1000; line++) {
+      auto begin = index.get_line_begin(extractor, line);
+      REQUIRE(begin.has_value());
+      CHECK(*begin == line_begins[static_cast<size_t>(line)]);
+
+      auto number = index.get_line_number(extractor, line_begins[static_cast<size_t>(line)]);
+      REQUIRE(number.has_value());
+      CHECK(*number == line);
+    }
+
+    CHECK(index.get_line_number(extractor, extractor.get_end() - (std::streamoff)1) == 999);
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test line index abort") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_line_index_abort.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << "a\nb\nc\n";
+  }
+
+  FileExtractor extractor(fpath);
+  LineIndex index;
+  std::atomic<bool> aborted = true;
+  index.build(extractor, aborted);
+
+  CHECK(index.get_status() == BackgroundTaskStatus::ABORTED);
+  CHECK_FALSE(index.get_line_number(extractor, 2).has_value());
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test line index resumes as the file grows") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_line_index_grow.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << "a\nb\nc";
+  }
+
+  FileExtractor extractor(fpath);
+  LineIndex index(2);
+  std::atomic<bool> aborted = false;
+  index.build(extractor, aborted);
+  CHECK(index.get_num_lines() == 3);
+
+  {
+    std::ofstream out(fpath, std::ios_base::binary | std::ios_base::app);
+    out << "c\nd\ne\n";
+  }
+  extractor.refresh();
+
+  // Picks up from the unterminated line
+  index.build(extractor, aborted);
+  REQUIRE(index.get_status() == BackgroundTaskStatus::FINISHED);
+  CHECK(index.get_end() == 11);
+  CHECK(index.get_num_lines() == 5);
+  CHECK(index.get_line_begin(extractor, 2) == std::streampos(4));
+  CHECK(index.get_line_begin(extractor, 4) == std::streampos(9));
+  CHECK(index.get_line_number(extractor, 5) == 2);
+  CHECK(index.get_line_number(extractor, 10) == 4);
+
+  std::filesystem::remove(fpath);
+}
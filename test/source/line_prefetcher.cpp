@@ -0,0 +1,88 @@
+#include <doctest/doctest.h>
+
+#include <LFV/file_extractor.hpp>
+#include <LFV/line_prefetcher.hpp>
+#include <LFV/task_pool.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+  std::vector<std::string> visible_rows(const EditWindowExtractor& extractor) {
+    std::vector<std::string> rows;
+    for (std::string_view row : extractor.get_lines()) {
+      rows.emplace_back(row);
+    }
+
+    return rows;
+  }
+
+  void wait_idle(const LinePrefetcher& prefetcher) {
+    while (!prefetcher.is_idle()) {
+      std::this_thread::yield();
+    }
+  }
+}  // namespace
+
+TEST_CASE("Test prefetch depth follows the scroll velocity") {
+  CHECK(LinePrefetcher::get_depth(0, 40) == 40);
+  CHECK(LinePrefetcher::get_depth(200, 40) == 100);
+  CHECK(LinePrefetcher::get_depth(1e6, 40) == 40 * LinePrefetcher::MAX_SCREENS);
+}
+
+TEST_CASE("Test scrolling from prefetched lines") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_prefetch.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    for (int line = 0; line < 2000; line++) {
+      out << std::string(static_cast<size_t>(line % 37), static_cast<char>('a' + line % 26))
+          << " line " << line << '\n';
+    }
+  }
+
+  constexpr int WIDTH = 20;
+  constexpr int HEIGHT = 10;
+
+  auto task_pool = std::make_shared<TaskPool>(1);
+  auto prefetcher = std::make_shared<LinePrefetcher>(fpath, FileSourceOptions{}, task_pool);
+
+  EditWindowExtractor extractor(fpath);
+  extractor.set_size(WIDTH, HEIGHT);
+  extractor.set_prefetcher(prefetcher);
+
+  EditWindowExtractor reference(fpath);
+  reference.set_size(WIDTH, HEIGHT);
+
+  // Down to well past the start, then back up past where it started
+  reference.move_to(8000);
+  extractor.move_to(8000);
+  wait_idle(*prefetcher);
+
+  // Jumping reads the new screen directly
+  const CacheStats initial_stats = prefetcher->get_stats();
+  for (int direction : {1, -1}) {
+    for (int step = 0; step < 300; step++) {
+      if (direction == 1) {
+        extractor.move_down();
+        reference.move_down();
+      } else {
+        extractor.move_up();
+        reference.move_up();
+      }
+
+      REQUIRE(visible_rows(extractor) == visible_rows(reference));
+      wait_idle(*prefetcher);
+    }
+  }
+
+  // Every line scrolled into view was read ahead
+  CacheStats stats = prefetcher->get_stats();
+  CHECK(stats.hits - initial_stats.hits > 100);
+  CHECK(stats.misses == initial_stats.misses);
+
+  task_pool->shutdown();
+  std::filesystem::remove(fpath);
+}
@@ -0,0 +1,153 @@
+#include <doctest/doctest.h>
+
+#include <LFV/match_store.hpp>
+#include <LFV/search_result.hpp>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Test match store round trip") {
+  std::mt19937 rng(5);
+
+  // Mostly ascending, with the odd step back and the odd pattern index
+  std::vector<std::pair<std::streamoff, int32_t>> matches;
+  std::streamoff pos = 0;
+  for (size_t i = 0; i < 3 * MatchStore::BLOCK_MATCHES + 17; i++) {
+    pos += rng() % 8 == 0 ? -static_cast<std::streamoff>(rng() % 100)
+                          : static_cast<std::streamoff>(rng() % 300);
+    if (i % 1000 == 0) {
+      pos += 1LL << 40;
+    }
+    matches.emplace_back(pos, rng() % 4 == 0 ? static_cast<int32_t>(rng() % 1000) : 0);
+  }
+
+  for (size_t budget : {size_t{0}, size_t{10'000}, MatchStore::DEFAULT_MEMORY_BUDGET}) {
+    MatchStore store(budget);
+    for (const auto& [match_pos, pattern] : matches) {
+      store.add(match_pos, pattern);
+    }
+
+    REQUIRE(store.size() == static_cast<int64_t>(matches.size()));
+
+    // Forward, backward, then jumping around
+    for (size_t i = 0; i < matches.size(); i++) {
+      CHECK(store.get(static_cast<int64_t>(i)) == matches[i]);
+    }
+    for (size_t i = matches.size(); i-- > 0;) {
+      CHECK(store.get(static_cast<int64_t>(i)) == matches[i]);
+    }
+    for (int i = 0; i < 100; i++) {
+      size_t index = rng() % matches.size();
+      CHECK(store.get(static_cast<int64_t>(index)) == matches[index]);
+    }
+
+    if (budget == MatchStore::DEFAULT_MEMORY_BUDGET) {
+      CHECK(store.get_spilled_bytes() == 0);
+    } else {
+      CHECK(store.get_spilled_bytes() > 0);
+      CHECK(store.get_memory_bytes() <= budget);
+    }
+  }
+}
+
+TEST_CASE("Test match store finds positions") {
+  std::mt19937 rng(9);
+
+  // Ascending, with repeats as when several patterns match at the same place
+  std::vector<std::streamoff> positions;
+  std::streamoff pos = 5;
+  for (size_t i = 0; i < 4 * MatchStore::BLOCK_MATCHES + 100; i++) {
+    pos += rng() % 4 == 0 ? 0 : static_cast<std::streamoff>(rng() % 50);
+    positions.push_back(pos);
+  }
+
+  for (size_t budget : {size_t{0}, MatchStore::DEFAULT_MEMORY_BUDGET}) {
+    MatchStore store(budget);
+    CHECK(store.lower_bound(0) == 0);
+
+    for (size_t i = 0; i < positions.size(); i++) {
+      store.add(positions[i], 0);
+
+      // Through sealed blocks and the one being filled
+      if (i % 1000 == 999 || i + 1 == positions.size()) {
+        for (int j = 0; j < 200; j++) {
+          std::streamoff target = static_cast<std::streamoff>(rng() % (positions[i] + 10));
+          auto expected = std::lower_bound(positions.begin(),
+                                           positions.begin() + static_cast<std::ptrdiff_t>(i + 1),
+                                           target)
+                          - positions.begin();
+          CHECK(store.lower_bound(target) == expected);
+        }
+      }
+    }
+
+    CHECK(store.lower_bound(positions.front()) == 0);
+    CHECK(store.lower_bound(positions.back() + 1) == store.size());
+  }
+}
+
+TEST_CASE("Test match store is compact") {
+  MatchStore store;
+  for (std::streamoff pos = 0; pos < 1'000'000 * 100LL; pos += 100) {
+    store.add(pos, 0);
+  }
+
+  CHECK(store.size() == 1'000'000);
+  // Two bytes per delta, and a full position at the start of each block
+  CHECK(store.get_memory_bytes() < static_cast<size_t>(store.size()) * 21 / 10);
+  CHECK(store.get(123'456).first == 12'345'600);
+}
+
+TEST_CASE("Test match store reads while adding") {
+  constexpr int64_t NUM_MATCHES = 1'000'000;
+  auto expected = [](int64_t index) {
+    return std::make_pair(static_cast<std::streamoff>(index * 3),
+                          static_cast<int32_t>(index % 5 == 0 ? index % 7 : 0));
+  };
+
+  // A small budget, so that reads also hit spilled blocks
+  MatchStore store(20'000);
+  std::atomic<bool> done = false;
+
+  std::thread writer([&] {
+    for (int64_t i = 0; i < NUM_MATCHES; i++) {
+      store.add(expected(i).first, expected(i).second);
+    }
+    done = true;
+  });
+
+  std::mt19937 rng(9);
+  int64_t mismatches = 0;
+  while (!done) {
+    int64_t size = store.size();
+    if (size == 0) {
+      continue;
+    }
+
+    // The newest match, most likely in the block being filled, and a random older one
+    for (int64_t index : {size - 1, static_cast<int64_t>(rng() % static_cast<uint64_t>(size))}) {
+      mismatches += static_cast<int64_t>(store.get(index) != expected(index));
+    }
+  }
+
+  writer.join();
+
+  CHECK(mismatches == 0);
+  CHECK(store.size() == NUM_MATCHES);
+  CHECK(store.get(NUM_MATCHES - 1) == expected(NUM_MATCHES - 1));
+}
+
+TEST_CASE("Test search result keeps matches past the old limit") {
+  SearchResult result;
+  for (std::streamoff pos = 0; pos < 6'000'000; pos++) {
+    result.add_match(pos * 3);
+  }
+
+  CHECK(result.get_num_matches() == 6'000'000);
+  CHECK(result.get_match(5'999'999) == 17'999'997);
+  CHECK(result.get_match(0) == 0);
+  CHECK(result.get_match_pattern(42) == 0);
+}
@@ -0,0 +1,94 @@
+#include <doctest/doctest.h>
+
+#include <LFV/perf_stats.hpp>
+#include <LFV/search_stream.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Test latency histogram percentiles") {
+  using std::chrono::nanoseconds;
+
+  LatencyHistogram histogram;
+  CHECK(histogram.get_percentile(0.5) == nanoseconds(0));
+
+  // 1 to 10000 us, once each
+  for (int us = 1; us <= 10000; us++) {
+    histogram.record(std::chrono::microseconds(us));
+  }
+
+  CHECK(histogram.get_count() == 10000);
+  CHECK(histogram.get_total() == std::chrono::microseconds(10000LL * 10001 / 2));
+
+  for (double fraction : {0.01, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    double expected = fraction * 1e7;
+    auto percentile = static_cast<double>(histogram.get_percentile(fraction).count());
+    CHECK(percentile >= expected * 0.75);
+    CHECK(percentile <= expected * 1.25);
+  }
+
+  // Small durations are exact, and negative ones count as 0
+  LatencyHistogram small;
+  small.record(nanoseconds(3));
+  small.record(nanoseconds(-5));
+  CHECK(small.get_percentile(1.0) == nanoseconds(3));
+  CHECK(small.get_percentile(0.5) == nanoseconds(0));
+
+  // Recording from several threads loses nothing
+  LatencyHistogram shared;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&shared] {
+      for (int j = 0; j < 10000; j++) {
+        shared.record(nanoseconds(j));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  CHECK(shared.get_count() == 40000);
+
+  // Each histogram samples its own scopes, however the scopes of several interleave
+  LatencyHistogram first;
+  LatencyHistogram second;
+  for (uint32_t i = 0; i < 4 * SampledTimer::SAMPLE_PERIOD; i++) {
+    SampledTimer timer(i % 2 == 0 ? first : second);
+  }
+  CHECK(first.get_count() == 2);
+  CHECK(second.get_count() == 2);
+}
+
+TEST_CASE("Test searches record their throughput and first match") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_perf_stats.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << std::string(100000, 'a') << "needle" << std::string(100000, 'b');
+  }
+
+  PerfStats& stats = get_perf_stats();
+  const uint64_t searches = stats.num_searches.load();
+  const uint64_t bytes = stats.searched_bytes.load();
+  const uint64_t first_matches = stats.first_match.get_count();
+
+  auto result = std::make_shared<SearchResult>();
+  search_in_stream(std::ifstream(fpath), "needle", 1000, 200006, 100, result,
+                   std::make_shared<std::atomic<bool>>(false));
+  REQUIRE(result->get_num_found() == 1);
+
+  CHECK(stats.num_searches.load() == searches + 1);
+  CHECK(stats.searched_bytes.load() == bytes + 199006);
+  CHECK(stats.first_match.get_count() == first_matches + 1);
+
+  // A result filled without a search, as when restored, is not timed
+  auto restored = std::make_shared<SearchResult>();
+  restored->add_match(5);
+  restored->set_status(BackgroundTaskStatus::FINISHED);
+  CHECK(stats.num_searches.load() == searches + 1);
+  CHECK(stats.first_match.get_count() == first_matches + 1);
+
+  std::filesystem::remove(fpath);
+}
@@ -0,0 +1,191 @@
+#include <doctest/doctest.h>
+
+#include <LFV/lfv_exception.hpp>
+#include <LFV/regex.hpp>
+#include <LFV/search_stream.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+  using Matches = std::vector<std::streamoff>;
+
+  Matches search_regex(const std::string& content, const std::string& pattern,
+                       std::streamoff begin = 0, std::streamoff end = -1,
+                       int64_t match_limit = 1'000'000) {
+    const std::string fpath = std::filesystem::temp_directory_path() / "lfv_regex_search.txt";
+    {
+      std::ofstream out(fpath, std::ios_base::binary);
+      out << content;
+    }
+
+    auto result = std::make_shared<SearchResult>();
+    search_regex_in_file(fpath, Regex(pattern), begin,
+                         end == -1 ? static_cast<std::streamoff>(content.size()) : end,
+                         match_limit, result, std::make_shared<std::atomic<bool>>(false));
+    CHECK(result->get_status() == BackgroundTaskStatus::FINISHED);
+
+    std::filesystem::remove(fpath);
+
+    Matches matches;
+    for (int i = 0; i < result->get_num_matches(); i++) {
+      matches.push_back(result->get_match(i));
+    }
+
+    return matches;
+  }
+
+  // Positions where a match ends, as seen by a forward DFA
+  std::vector<size_t> match_ends(LazyDfa& dfa, const std::string& text) {
+    std::vector<size_t> ends;
+    int32_t state = dfa.get_start(true);
+    for (size_t i = 0; i < text.size(); i++) {
+      state = dfa.next(state, static_cast<unsigned char>(text[i]));
+      if (state == LazyDfa::DEAD) {
+        // The longest match is over, so the next one starts afresh
+        state = dfa.get_start(text[i] == '\n');
+        continue;
+      }
+      if (dfa.is_match(state)) {
+        ends.push_back(i + 1);
+      }
+    }
+
+    return ends;
+  }
+}  // namespace
+
+TEST_CASE("Test regex search") {
+  CHECK(search_regex("xxabcbd abd ad acd", "a[bc]+d") == Matches{2, 8, 15});
+  CHECK(search_regex("call 555-1234 or 5555-12345", "\\d{3}-\\d{4}") == Matches{5, 18});
+  CHECK(search_regex("x.y xzy", "x\\.y") == Matches{0});
+  CHECK(search_regex("Ab ab AB", "[^a ]b|(?:A)B") == Matches{0, 6});
+
+  // Matches are leftmost-longest, and the next one starts after the end of the last
+  CHECK(search_regex("abcd", "abcd|bc") == Matches{0});
+  CHECK(search_regex("abcde", "ab|bcde") == Matches{0});
+  CHECK(search_regex("babbbab", "[ab]{1,3}") == Matches{0, 3, 6});
+  CHECK(search_regex("aaa baa", "a+") == Matches{0, 5});
+  CHECK(search_regex("abab", "a|ab") == Matches{0, 2});
+  CHECK(search_regex("aabb", "a+b?|b") == Matches{0, 3});
+  CHECK(search_regex("ab\nab", "b$|ab") == Matches{0, 3});
+  CHECK(search_regex("aaaa", "aa") == Matches{0, 2});
+
+  // Line anchors
+  CHECK(search_regex("foo\nxfoo\nfoo", "^foo") == Matches{0, 9});
+  CHECK(search_regex("foo\nxfoo\nfoo", "o$") == Matches{2, 7, 11});
+  CHECK(search_regex("ab\nab\n", "^ab$") == Matches{0, 3});
+  CHECK(search_regex("a.\n.b", ".\\n.") == Matches{1});
+
+  // Ranges and limits
+  CHECK(search_regex("xxabcbd abd ad acd", "a[bc]+d", 3) == Matches{8, 15});
+  CHECK(search_regex("xxabcbd abd ad acd", "a[bc]+d", 0, 11) == Matches{2, 8});
+  CHECK(search_regex("xxabcbd abd ad acd", "a[bc]+d", 0, -1, 1) == Matches{2});
+  CHECK(search_regex("afoo", "^foo", 1).empty());
+}
+
+TEST_CASE("Test regex search across blocks matches a plain search") {
+  std::mt19937 rng(11);
+  std::string content(3 << 20, ' ');
+  for (char& c : content) {
+    c = "ab\n"[rng() % 3];
+  }
+
+  // The pattern cannot overlap itself, so every occurrence is a match
+  Matches expected;
+  for (size_t pos = content.find("aab\nb"); pos != std::string::npos;
+       pos = content.find("aab\nb", pos + 1)) {
+    expected.push_back(static_cast<std::streamoff>(pos));
+  }
+
+  // With and without a literal prefix
+  CHECK(search_regex(content, "aab\\nb") == expected);
+  CHECK(search_regex(content, "(a|\\x01)ab\\nb") == expected);
+}
+
+TEST_CASE("Test regex search carried on over appended bytes") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_regex_append.txt";
+  auto aborted = std::make_shared<std::atomic<bool>>(false);
+
+  // Searches old to its end, then the appended bytes from where the viewer resumes
+  auto search_appended = [&](const std::string& old, const std::string& appended,
+                             const std::string& pattern) {
+    const auto old_end = static_cast<std::streamoff>(old.size());
+    auto result = std::make_shared<SearchResult>();
+    {
+      std::ofstream out(fpath, std::ios_base::binary);
+      out << old;
+    }
+    search_regex_in_file(fpath, Regex(pattern), 0, old_end, 1'000'000, result, aborted);
+
+    {
+      std::ofstream out(fpath, std::ios_base::binary | std::ios_base::app);
+      out << appended;
+    }
+    const std::streamoff last_match = result->get_last_match();
+    const std::streamoff floor = std::max<std::streamoff>(0, last_match);
+    const size_t newline = old_end > 0 ? old.rfind('\n', old.size() - 1) : std::string::npos;
+    const std::streamoff resume = newline != std::string::npos && std::streamoff(newline) >= floor
+                                      ? std::streamoff(newline) + 1
+                                      : floor;
+    search_regex_in_file(fpath, Regex(pattern), resume, old_end + std::streamoff(appended.size()),
+                         1'000'000, result, aborted, {}, last_match + 1);
+
+    Matches matches;
+    for (int i = 0; i < result->get_num_matches(); i++) {
+      matches.push_back(result->get_match(i));
+    }
+    return matches;
+  };
+
+  // A match growing over the old end is reported once
+  CHECK(search_appended("x aa", "aa b", "a+") == Matches{2});
+  CHECK(search_appended("x aa", "a aa", "a+") == Matches{2, 6});
+  // A match under way at the old end is found
+  CHECK(search_appended("abc\nxab", "c ab", "abc") == Matches{0, 5});
+  CHECK(search_appended("a\nfoo", "bar\n", "^foo.*r$") == Matches{2});
+  // Matches are not reported again
+  CHECK(search_appended("ab ab\nab", "ab", "ab") == Matches{0, 3, 6, 8});
+  CHECK(search_appended("", "ab", "ab") == Matches{0});
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test lazy DFA with a small cache") {
+  std::mt19937 rng(3);
+  std::string text(5000, ' ');
+  for (char& c : text) {
+    c = "ab"[rng() % 2];
+  }
+
+  // Needs 2^6 states
+  const Regex regex("a[ab]{5}");
+  LazyDfa small = regex.make_forward_dfa(8);
+  LazyDfa large = regex.make_forward_dfa();
+
+  CHECK(match_ends(small, text) == match_ends(large, text));
+  CHECK(small.get_num_states() <= 8);
+  CHECK(small.get_num_flushes() > 0);
+  CHECK(large.get_num_flushes() == 0);
+}
+
+TEST_CASE("Test regex literal prefix") {
+  CHECK(Regex("foo(bar|baz)").get_literal_prefix() == "fooba");
+  CHECK(Regex("(ab)+c").get_literal_prefix() == "ab");
+  CHECK(Regex("^x[y]z$").get_literal_prefix() == "xyz");
+  CHECK(Regex("a?b").get_literal_prefix().empty());
+  CHECK(Regex("\\d+").get_literal_prefix().empty());
+}
+
+TEST_CASE("Test invalid regexes") {
+  for (const std::string pattern :
+       {"", "(", "a)", "[a-", "*a", "a{3,2}", "a{1001}", "\\q", "\\x4", "a*", "^", "(a|)", "^$"}) {
+    CAPTURE(pattern);
+    CHECK_THROWS_AS(Regex{pattern}, LFVException);
+  }
+
+  // A brace that does not make a quantifier is a literal
+  CHECK(search_regex("a{x}", "a{x}") == Matches{0});
+}
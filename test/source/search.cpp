@@ -0,0 +1,343 @@
+#include <doctest/doctest.h>
+
+#include <LFV/aho_corasick.hpp>
+#include <LFV/match_histogram.hpp>
+#include <LFV/parallel_search.hpp>
+#include <LFV/search_stream.hpp>
+#include <LFV/substring_search.hpp>
+#include <LFV/task_pool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+  std::vector<std::streamoff> find_all_naive(const std::string& content, const std::string& pattern,
+                                             size_t begin, size_t end) {
+    std::vector<std::streamoff> matches;
+    for (size_t pos = content.find(pattern, begin);
+         pos != std::string::npos && pos + pattern.size() <= end;
+         pos = content.find(pattern, pos + 1)) {
+      matches.push_back(static_cast<std::streamoff>(pos));
+    }
+
+    return matches;
+  }
+
+  std::vector<std::streamoff> get_matches(const SearchResult& result) {
+    std::vector<std::streamoff> matches;
+    for (int i = 0; i < result.get_num_matches(); i++) {
+      matches.push_back(result.get_match(i));
+    }
+
+    return matches;
+  }
+
+  std::string make_search_content() {
+    std::mt19937 rng(7);
+    std::string content(20000, ' ');
+    for (char& c : content) {
+      c = "ab\n"[rng() % 3];
+    }
+
+    return content;
+  }
+}  // namespace
+
+TEST_CASE("Test parallel search matches a plain search") {
+  const std::string content = make_search_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_parallel_search.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  for (const std::string pattern : {"a", "ab", "aab\nb", "bbbbbb"}) {
+    for (std::streamoff chunk_size : {1, 37, 4096, 1 << 20}) {
+      auto result = std::make_shared<SearchResult>();
+      auto aborted = std::make_shared<std::atomic<bool>>(false);
+
+      search_in_file_parallel(fpath, pattern, 100, 19000, 1'000'000, result, aborted, 4,
+                              chunk_size);
+
+      CHECK(result->get_status() == BackgroundTaskStatus::FINISHED);
+      CHECK(get_matches(*result) == find_all_naive(content, pattern, 100, 19000));
+    }
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test parallel search limit and abort") {
+  const std::string content = make_search_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_parallel_limit.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  auto limited = std::make_shared<SearchResult>();
+  search_in_file_parallel(fpath, "ab", 0, 20000, 10, limited,
+                          std::make_shared<std::atomic<bool>>(false), 3, 64);
+  auto expected = find_all_naive(content, "ab", 0, 20000);
+  expected.resize(10);
+  CHECK(get_matches(*limited) == expected);
+
+  auto aborted_result = std::make_shared<SearchResult>();
+  search_in_file_parallel(fpath, "ab", 0, 20000, 10, aborted_result,
+                          std::make_shared<std::atomic<bool>>(true), 3, 64);
+  CHECK(aborted_result->get_status() == BackgroundTaskStatus::ABORTED);
+  CHECK(aborted_result->get_num_matches() == 0);
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test parallel search of chunks with many matches") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_parallel_dense.txt";
+  const std::streamoff size = 300000;
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << std::string(static_cast<size_t>(size), 'a');
+  }
+
+  // Chunks publish their matches as they go, on the workers of a shared pool
+  auto task_pool = std::make_shared<TaskPool>(2);
+  auto result = std::make_shared<SearchResult>();
+  search_in_file_parallel(fpath, "aa", 0, size, 1'000'000, result,
+                          std::make_shared<std::atomic<bool>>(false), 4, 100000, {}, task_pool);
+  CHECK(result->get_status() == BackgroundTaskStatus::FINISHED);
+  std::vector<std::streamoff> expected(static_cast<size_t>(size - 1));
+  std::iota(expected.begin(), expected.end(), 0);
+  CHECK(get_matches(*result) == expected);
+
+  // Count-only results stop counting at the limit
+  auto counted = std::make_shared<SearchResult>(std::make_shared<MatchHistogram>(size), true);
+  search_in_file_parallel(fpath, "aa", 0, size, 150000, counted,
+                          std::make_shared<std::atomic<bool>>(false), 4, 100000, {}, task_pool);
+  CHECK(counted->get_num_found() == 150000);
+  CHECK(counted->get_num_matches() == 0);
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test substring kernels agree with std::string::find") {
+  const std::string content = make_search_content();
+
+  for (const SubstringKernel& kernel : available_substring_kernels()) {
+    for (const std::string& pattern :
+         std::vector<std::string>{"a", "ab", "b\na", "abababa", std::string(40, 'a'), "zz"}) {
+      SubstringSearcher searcher(pattern, kernel);
+
+      std::vector<std::streamoff> found;
+      searcher.find_all(content, [&](size_t offset) {
+        found.push_back(static_cast<std::streamoff>(offset));
+        return true;
+      });
+
+      CHECK(found == find_all_naive(content, pattern, 0, content.size()));
+    }
+  }
+}
+
+TEST_CASE("Test stream searches match a plain search") {
+  const std::string content = make_search_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_stream_search.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  for (const std::string pattern : {"a", "ab", "aab\nb", "bbbbbb"}) {
+    auto expected = find_all_naive(content, pattern, 100, 19000);
+
+    auto result = std::make_shared<SearchResult>();
+    auto aborted = std::make_shared<std::atomic<bool>>(false);
+    search_in_stream(std::ifstream(fpath), pattern, 100, 19000, 1'000'000, result, aborted);
+    CHECK(result->get_status() == BackgroundTaskStatus::FINISHED);
+    CHECK(get_matches(*result) == expected);
+
+    auto bmh_result = std::make_shared<SearchResult>();
+    search_in_stream_bmh(std::ifstream(fpath), pattern, 100, 19000, 1'000'000, bmh_result,
+                         aborted);
+    CHECK(get_matches(*bmh_result) == expected);
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test multi-pattern search matches a plain search") {
+  const std::string content = make_search_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_search_any.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  // Overlapping patterns, patterns inside others, and one that never matches
+  const std::vector<std::string> patterns{"ab", "b", "aab\nb", "bab", "a\n\na", "zzz", "b"};
+
+  std::vector<std::pair<std::streamoff, int32_t>> expected;
+  for (size_t i = 0; i < patterns.size(); i++) {
+    for (std::streamoff pos : find_all_naive(content, patterns[i], 100, 19000)) {
+      expected.emplace_back(pos, static_cast<int32_t>(i));
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+
+  auto result = std::make_shared<SearchResult>();
+  search_any_in_stream(std::ifstream(fpath), patterns, 100, 19000, 1'000'000, result,
+                       std::make_shared<std::atomic<bool>>(false));
+  CHECK(result->get_status() == BackgroundTaskStatus::FINISHED);
+
+  REQUIRE(result->get_num_matches() == static_cast<int>(expected.size()));
+  for (int i = 0; i < result->get_num_matches(); i++) {
+    // Matches at the same position may come in any pattern order
+    CHECK(result->get_match(i) == expected[static_cast<size_t>(i)].first);
+  }
+
+  std::vector<std::pair<std::streamoff, int32_t>> found;
+  for (int i = 0; i < result->get_num_matches(); i++) {
+    found.emplace_back(result->get_match(i), result->get_match_pattern(i));
+  }
+  std::sort(found.begin(), found.end());
+  CHECK(found == expected);
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test multi-pattern search with every byte value") {
+  // Class 0 is for bytes in no pattern, so every byte in a pattern makes 257 classes
+  std::vector<std::string> patterns;
+  std::string content;
+  for (int byte = 0; byte < 256; byte++) {
+    patterns.push_back({static_cast<char>(byte), static_cast<char>(255 - byte)});
+    content += patterns.back();
+  }
+
+  const AhoCorasick automaton(patterns);
+  std::vector<std::pair<std::streamoff, int32_t>> found;
+  automaton.feed(AhoCorasick::INITIAL_STATE, content, 0,
+                 [&](std::streamoff end, int32_t pattern) { found.emplace_back(end, pattern); });
+
+  std::vector<std::pair<std::streamoff, int32_t>> expected;
+  for (size_t i = 0; i < patterns.size(); i++) {
+    for (std::streamoff pos : find_all_naive(content, patterns[i], 0, content.size())) {
+      expected.emplace_back(pos + 2, static_cast<int32_t>(i));
+    }
+  }
+  std::sort(found.begin(), found.end());
+  std::sort(expected.begin(), expected.end());
+  CHECK(found == expected);
+}
+
+TEST_CASE("Test multi-pattern search resumed over appended bytes") {
+  const std::string content = make_search_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_search_any_resume.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  const std::vector<std::string> patterns{"ab", "b", "aab\nb", "bab"};
+  auto aborted = std::make_shared<std::atomic<bool>>(false);
+
+  auto whole = std::make_shared<SearchResult>(nullptr, true);
+  search_any_in_stream(std::ifstream(fpath), patterns, 100, 19000, 1'000'000, whole, aborted);
+
+  // The second range starts a pattern length before the first one ends, to see the matches
+  // crossing the border, and skips those the first range found
+  for (std::streamoff border : {101L, 5000L, 12345L, 18999L}) {
+    auto resumed = std::make_shared<SearchResult>(nullptr, true);
+    search_any_in_stream(std::ifstream(fpath), patterns, 100, border, 1'000'000, resumed, aborted);
+    search_any_in_stream(std::ifstream(fpath), patterns, std::max<std::streamoff>(100, border - 4),
+                         19000, 1'000'000, resumed, aborted, border);
+    CHECK(resumed->get_num_found() == whole->get_num_found());
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test count-only search fills the histogram") {
+  const std::string content = make_search_content();
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_count_search.txt";
+  {
+    std::ofstream out(fpath, std::ios_base::binary);
+    out << content;
+  }
+
+  const auto expected = find_all_naive(content, "ab", 0, content.size());
+
+  for (unsigned jobs : {1, 4}) {
+    auto histogram = std::make_shared<MatchHistogram>(content.size(), 64);
+    auto result = std::make_shared<SearchResult>(histogram, true);
+    auto aborted = std::make_shared<std::atomic<bool>>(false);
+
+    if (jobs == 1) {
+      search_in_stream(std::ifstream(fpath), "ab", 0, content.size(), 1'000'000, result, aborted);
+    } else {
+      search_in_file_parallel(fpath, "ab", 0, content.size(), 1'000'000, result, aborted, jobs,
+                              1000);
+    }
+
+    CHECK(result->get_num_matches() == 0);
+    CHECK(result->get_num_found() == static_cast<int64_t>(expected.size()));
+
+    std::vector<uint64_t> expected_counts(histogram->get_num_buckets(), 0);
+    for (std::streamoff pos : expected) {
+      expected_counts[static_cast<size_t>(pos / histogram->get_bucket_size())]++;
+    }
+
+    for (size_t bucket = 0; bucket < histogram->get_num_buckets(); bucket++) {
+      CHECK(histogram->get_count(bucket) == expected_counts[bucket]);
+    }
+
+    // Rows merge buckets without losing any match
+    for (size_t num_rows : {1, 7, 64, 100}) {
+      auto rows = histogram->get_rows(num_rows);
+      CHECK(rows.size() == num_rows);
+      if (num_rows <= histogram->get_num_buckets()) {
+        CHECK(std::accumulate(rows.begin(), rows.end(), uint64_t{0}) == expected.size());
+      }
+    }
+  }
+
+  std::filesystem::remove(fpath);
+}
+
+TEST_CASE("Test histogram extended over a grown file") {
+  MatchHistogram histogram(100, 4);
+  CHECK(histogram.get_bucket_size() == 25);
+  for (std::streamoff pos : {0, 30, 60, 99}) {
+    histogram.add(pos);
+  }
+
+  // Already covered
+  histogram.extend(100);
+  CHECK(histogram.get_bucket_size() == 25);
+
+  // Neighbouring buckets merge, and matches past the old end go to new ones
+  histogram.extend(300);
+  CHECK(histogram.get_bucket_size() == 100);
+  CHECK(histogram.get_count(0) == 4);
+  for (size_t bucket = 1; bucket < 4; bucket++) {
+    CHECK(histogram.get_count(bucket) == 0);
+  }
+  histogram.add(250);
+  CHECK(histogram.get_count(2) == 1);
+
+  histogram.extend(401);
+  CHECK(histogram.get_bucket_size() == 200);
+  CHECK(histogram.get_count(0) == 4);
+  CHECK(histogram.get_count(1) == 1);
+
+  MatchHistogram single(10, 1);
+  single.add(5);
+  single.extend(1000);
+  CHECK(single.get_bucket_size() == 1000);
+  CHECK(single.get_count(0) == 1);
+}
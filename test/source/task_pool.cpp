@@ -0,0 +1,176 @@
+#include <doctest/doctest.h>
+
+#include <LFV/lfv_exception.hpp>
+#include <LFV/task_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+  // Keeps the single worker of a pool busy until opened
+  struct Gate {
+    std::atomic<bool> entered = false;
+    std::atomic<bool> open = false;
+
+    TaskPool::Task task() {
+      return [this](const CancellationToken&) {
+        entered = true;
+        while (!open) {
+          std::this_thread::yield();
+        }
+      };
+    }
+
+    void wait_entered() const {
+      while (!entered) {
+        std::this_thread::yield();
+      }
+    }
+  };
+}  // namespace
+
+TEST_CASE("Test task pool runs tasks concurrently") {
+  TaskPool pool(4);
+  CHECK(pool.get_num_threads() == 4);
+
+  // Each task waits for all the others to start
+  std::atomic<int> started = 0;
+  std::vector<TaskHandle> handles;
+  for (int i = 0; i < 4; i++) {
+    handles.push_back(pool.submit([&started](const CancellationToken&) {
+      started++;
+      while (started < 4) {
+        std::this_thread::yield();
+      }
+    }));
+  }
+
+  for (const TaskHandle& handle : handles) {
+    handle.wait();
+    CHECK(handle.get_status() == BackgroundTaskStatus::FINISHED);
+  }
+}
+
+TEST_CASE("Test task pool priority order") {
+  TaskPool pool(1);
+  Gate gate;
+  TaskHandle gate_handle = pool.submit(gate.task());
+  gate.wait_entered();
+
+  std::mutex mutex;
+  std::vector<int> order;
+  auto record = [&](int id) {
+    return [&, id](const CancellationToken&) {
+      std::scoped_lock<std::mutex> lock(mutex);
+      order.push_back(id);
+    };
+  };
+
+  pool.submit(record(0), TaskPriority::LOW);
+  pool.submit(record(1), TaskPriority::NORMAL);
+  pool.submit(record(2), TaskPriority::HIGH);
+  pool.submit(record(3), TaskPriority::NORMAL);
+  TaskHandle last = pool.submit(record(4), TaskPriority::LOW);
+  CHECK(pool.get_num_queued() == 5);
+
+  gate.open = true;
+  last.wait();
+  CHECK(order == std::vector<int>{2, 1, 3, 0, 4});
+}
+
+TEST_CASE("Test task pool cancellation") {
+  TaskPool pool(1);
+  Gate gate;
+  pool.submit(gate.task());
+  gate.wait_entered();
+
+  // A queued task is dropped without running
+  std::atomic<bool> ran = false;
+  TaskHandle queued = pool.submit([&ran](const CancellationToken&) { ran = true; });
+  CHECK(queued.get_status() == BackgroundTaskStatus::NOT_STARTED);
+  queued.cancel();
+
+  // A running task stops at its next check
+  TaskHandle running = pool.submit([](const CancellationToken& token) {
+    while (!*token) {
+      std::this_thread::yield();
+    }
+  });
+
+  gate.open = true;
+  queued.wait();
+  CHECK(queued.get_status() == BackgroundTaskStatus::ABORTED);
+  CHECK(!ran);
+
+  while (running.get_status() != BackgroundTaskStatus::ONGOING) {
+    std::this_thread::yield();
+  }
+  running.cancel();
+  running.wait();
+  CHECK(running.get_status() == BackgroundTaskStatus::ABORTED);
+}
+
+TEST_CASE("Test task pool errors") {
+  TaskPool pool(1, 2);
+  Gate gate;
+  pool.submit(gate.task());
+  gate.wait_entered();
+
+  TaskHandle failing
+      = pool.submit([](const CancellationToken&) { throw std::runtime_error("broken"); });
+  pool.submit([](const CancellationToken&) {});
+  CHECK_THROWS_AS(pool.submit([](const CancellationToken&) {}), LFVException);
+
+  gate.open = true;
+  failing.wait();
+  CHECK(failing.get_status() == BackgroundTaskStatus::ABORTED);
+  CHECK(failing.get_error() == "broken");
+
+  // Whatever is thrown, the worker carries on
+  TaskHandle odd = pool.submit([](const CancellationToken&) { throw 1; });
+  odd.wait();
+  CHECK(odd.get_status() == BackgroundTaskStatus::ABORTED);
+  CHECK(odd.get_error() == "Unknown error");
+  TaskHandle after = pool.submit([](const CancellationToken&) {});
+  after.wait();
+  CHECK(after.get_status() == BackgroundTaskStatus::FINISHED);
+
+  pool.shutdown();
+  CHECK_THROWS_AS(pool.submit([](const CancellationToken&) {}), LFVException);
+}
+
+TEST_CASE("Test default task handle") {
+  TaskHandle handle;
+  CHECK_FALSE(handle.is_valid());
+  CHECK(handle.get_status() == BackgroundTaskStatus::NOT_STARTED);
+  CHECK_FALSE(handle.is_done());
+  CHECK(handle.get_error().empty());
+  CHECK(*handle.get_token());
+  handle.cancel();
+  handle.wait();
+}
+
+TEST_CASE("Test task pool shutdown cancels and joins") {
+  TaskPool pool(2);
+
+  std::vector<TaskHandle> handles;
+  for (int i = 0; i < 8; i++) {
+    handles.push_back(pool.submit([](const CancellationToken& token) {
+      while (!*token) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }));
+  }
+
+  pool.shutdown();
+  for (const TaskHandle& handle : handles) {
+    CHECK(handle.is_done());
+    CHECK(handle.get_status() == BackgroundTaskStatus::ABORTED);
+  }
+
+  // Shutting down again does nothing
+  pool.shutdown();
+}
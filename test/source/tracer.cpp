@@ -0,0 +1,106 @@
+#include <doctest/doctest.h>
+
+#include <LFV/tracer.hpp>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  std::string read_file(const std::string& fpath) {
+    std::ifstream in(fpath, std::ios_base::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+  }
+
+  size_t count_occurrences(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos;
+         pos = text.find(pattern, pos + 1)) {
+      count++;
+    }
+
+    return count;
+  }
+}  // namespace
+
+TEST_CASE("Test tracer writes the spans of each thread") {
+  const std::string fpath = std::filesystem::temp_directory_path() / "lfv_tracer.json";
+
+  Tracer tracer;
+  tracer.start();
+  const auto origin = std::chrono::steady_clock::now();
+
+  // The threads run at once, so that none reuses the buffer of another
+  std::atomic<int> num_running = 0;
+  auto wait_for_all = [&num_running] {
+    num_running++;
+    while (num_running < 4) {
+      std::this_thread::yield();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 3; i++) {
+    threads.emplace_back([&tracer, &wait_for_all, i, origin] {
+      tracer.set_thread_name("Worker \"" + std::to_string(i) + "\"");
+      for (int j = 0; j < 100; j++) {
+        tracer.record("work", origin + std::chrono::microseconds(j),
+                      origin + std::chrono::microseconds(j + 1));
+      }
+      wait_for_all();
+    });
+  }
+
+  // A thread past its buffer keeps its latest spans
+  const size_t overflow = 10;
+  threads.emplace_back([&tracer, &wait_for_all, origin] {
+    for (size_t j = 0; j < Tracer::EVENTS_PER_THREAD + overflow; j++) {
+      tracer.record(j < overflow ? "dropped" : "kept", origin, origin);
+    }
+    wait_for_all();
+  });
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  tracer.write(fpath);
+  const std::string trace = read_file(fpath);
+
+  CHECK(trace.rfind("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", 0) == 0);
+  CHECK(trace.find("]}") != std::string::npos);
+  CHECK(count_occurrences(trace, "\"name\": \"work\"") == 300);
+  CHECK(count_occurrences(trace, "\"name\": \"kept\"") == Tracer::EVENTS_PER_THREAD);
+  CHECK(count_occurrences(trace, "\"name\": \"dropped\"") == 0);
+  CHECK(count_occurrences(trace, "\"ph\": \"M\"") == 3);
+  CHECK(trace.find("\"name\": \"Worker \\\"1\\\"\"") != std::string::npos);
+
+  // Threads that come and go one after another reuse one buffer, and their spans are kept
+  const size_t num_buffers = tracer.get_num_buffers();
+  for (int i = 0; i < 20; i++) {
+    std::thread([&tracer, origin] {
+      tracer.set_thread_name("Short-lived");
+      tracer.record("short", origin, origin);
+    }).join();
+  }
+  CHECK(tracer.get_num_buffers() <= num_buffers + 1);
+  tracer.write(fpath);
+  CHECK(count_occurrences(read_file(fpath), "\"name\": \"short\"") == 20);
+
+  // Each tracer has its own buffer for the thread
+  tracer.record("first", origin, origin);
+  Tracer other;
+  other.start();
+  other.record("second", origin, origin);
+  other.write(fpath);
+  const std::string other_trace = read_file(fpath);
+  CHECK(count_occurrences(other_trace, "\"ph\": \"X\"") == 1);
+  CHECK(other_trace.find("second") != std::string::npos);
+
+  std::filesystem::remove(fpath);
+}